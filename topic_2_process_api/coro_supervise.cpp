@@ -0,0 +1,246 @@
+/*
+ * PROGRAM: coro_supervise.cpp - Supervising children with co_await instead of wait()
+ *
+ * USAGE:
+ *     coro_supervise                              # a small demo
+ *     coro_supervise -b children [-s seconds]     # coroutines vs thread-per-child
+ *
+ * KEY CONCEPT: fork_wait.c has ONE child and blocks in wait() for it.
+ * With proc_coro.hpp each child gets a few lines of straight-line code,
+ * just like fork_wait.c, but the wait is a co_await: the coroutine is
+ * parked until its child exits and the thread goes on running the others.
+ *
+ * The demo runs three "jobs" at once on one thread. Each job runs its
+ * steps one after another - the next step starts when the previous child
+ * has exited - and the output shows them interleaving.
+ *
+ * -b starts 'children' children that each sleep 'seconds' (default 1),
+ * and waits for all of them, two ways:
+ *
+ *     coroutine   one thread: spawn, co_await exit, for every child
+ *     threads     one std::thread per child: spawn, then a blocking wait
+ *
+ * Each way runs in a fresh process of its own, which reports its wall
+ * time, CPU time, peak resident memory and thread count (the last two
+ * read from /proc/self/status once every child is running).
+ *
+ * EXAMPLE:
+ *     ./coro_supervise
+ *     ./coro_supervise -b 2000 -s 2
+ *
+ * BUILD:
+ *     g++ -std=c++20 -O2 -Wall -pthread -o coro_supervise coro_supervise.cpp
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h> /* getrusage(), setrlimit() */
+
+#include "proc_coro.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double since(Clock::time_point t0)
+{
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+/* ======================================================================
+ * DEMO
+ * ====================================================================== */
+
+static proc::Task job(proc::EventLoop &loop, const char *name, std::vector<std::string> steps,
+                      Clock::time_point t0)
+{
+    for (const std::string &step : steps)
+    {
+        proc::AsyncProcess child(loop, proc::Command("sh").arg("-c").arg(step).spawn());
+        printf("%6.3fs  %s: started '%s' (pid %ld)\n", since(t0), name, step.c_str(),
+               (long)child.pid());
+        proc::ExitStatus st = co_await child.exit();
+        printf("%6.3fs  %s: '%s' %s\n", since(t0), name, step.c_str(), st.describe().c_str());
+        if (!st.success())
+        {
+            printf("%6.3fs  %s: giving up\n", since(t0), name);
+            co_return;
+        }
+    }
+    printf("%6.3fs  %s: done\n", since(t0), name);
+}
+
+static void demo()
+{
+    proc::EventLoop loop;
+    Clock::time_point t0 = Clock::now();
+    /* Each call runs up to its first co_await and returns: all three start now */
+    job(loop, "build", {"sleep 0.3", "sleep 0.2", "true"}, t0);
+    job(loop, "test", {"sleep 0.1", "sleep 0.1", "exit 3", "true"}, t0);
+    job(loop, "fetch", {"sleep 0.4"}, t0);
+    loop.run();
+    printf("one thread, %ld wakeups\n", loop.wakeups());
+}
+
+/* ======================================================================
+ * BENCHMARK
+ * ====================================================================== */
+
+struct report
+{
+    double wall, cpu;      /* Seconds */
+    long rss_kb, threads;  /* When every child was running */
+    long failed;
+};
+
+/* VmRSS and Threads of this process */
+static void sample_status(report *r)
+{
+    FILE *fp = fopen("/proc/self/status", "r");
+    char line[256];
+    while (fp && fgets(line, sizeof(line), fp))
+    {
+        sscanf(line, "VmRSS: %ld", &r->rss_kb);
+        sscanf(line, "Threads: %ld", &r->threads);
+    }
+    if (fp)
+        fclose(fp);
+}
+
+static proc::Task supervise(proc::EventLoop &loop, const std::string &secs, long *failed)
+{
+    proc::AsyncProcess child(loop, proc::Command("sleep").arg(secs).spawn());
+    proc::ExitStatus st = co_await child.exit();
+    if (!st.success())
+        (*failed)++;
+}
+
+static void bench_coroutine(int n, const std::string &secs, report *r)
+{
+    proc::EventLoop loop;
+    for (int i = 0; i < n; i++)
+        supervise(loop, secs, &r->failed);
+    sample_status(r);
+    loop.run();
+}
+
+static void bench_threads(int n, const std::string &secs, report *r)
+{
+    std::atomic<long> started{0}, failed{0};
+    std::vector<std::thread> threads;
+    threads.reserve((size_t)n);
+    for (int i = 0; i < n; i++)
+    {
+        threads.emplace_back([&] {
+            proc::Process child = proc::Command("sleep").arg(secs).spawn();
+            started++;
+            if (!child.wait().success())
+                failed++;
+        });
+    }
+    while (started < n)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    sample_status(r);
+    for (std::thread &t : threads)
+        t.join();
+    r->failed = failed;
+}
+
+/* Run one way in a fresh process and get its report back through a pipe */
+static report measure(void (*how)(int, const std::string &, report *), int n,
+                      const std::string &secs)
+{
+    int fd[2];
+    report r{};
+    if (pipe(fd) < 0)
+        throw std::system_error(errno, std::generic_category(), "pipe");
+    pid_t pid = fork();
+    if (pid < 0)
+        throw std::system_error(errno, std::generic_category(), "fork");
+    if (pid == 0)
+    {
+        close(fd[0]);
+        Clock::time_point t0 = Clock::now();
+        how(n, secs, &r);
+        r.wall = since(t0);
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        r.cpu = (double)ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+                (double)ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+        ssize_t w = write(fd[1], &r, sizeof(r));
+        _exit(w == (ssize_t)sizeof(r) ? 0 : 1);
+    }
+    close(fd[1]);
+    if (read(fd[0], &r, sizeof(r)) != (ssize_t)sizeof(r))
+        r.failed = n;
+    close(fd[0]);
+    waitpid(pid, nullptr, 0);
+    return r;
+}
+
+static void bench(int n, const std::string &secs)
+{
+    /* A pidfd per child, plus whatever the threads need */
+    rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+
+    printf("%d children, each sleeping %s s\n\n", n, secs.c_str());
+    printf("%-10s %9s %9s %10s %8s %7s\n", "how", "wall (s)", "cpu (s)", "rss (MB)", "threads",
+           "failed");
+    const struct
+    {
+        const char *name;
+        void (*how)(int, const std::string &, report *);
+    } ways[] = {{"coroutine", bench_coroutine}, {"threads", bench_threads}};
+    for (const auto &w : ways)
+    {
+        report r = measure(w.how, n, secs);
+        printf("%-10s %9.3f %9.3f %10.1f %8ld %7ld\n", w.name, r.wall, r.cpu, r.rss_kb / 1024.0,
+               r.threads, r.failed);
+        fflush(stdout);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-b children [-s seconds]]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int n = 0;
+    std::string secs = "1";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': n = atoi(optarg); break;
+        case 's': secs = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || n < 0)
+        usage(argv[0]);
+
+    try
+    {
+        if (n > 0)
+            bench(n, secs);
+        else
+            demo();
+    }
+    catch (const std::system_error &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,318 @@
+/*
+ * event_log.h - A shared-memory event log many processes append to at once
+ *
+ * KEY CONCEPT: Run fork.c a few times and the "child" and "parent" lines
+ * come out in a different order: after fork() the scheduler decides who
+ * runs first, and printf() shows the order in which lines reached the
+ * terminal, not the order in which things happened. Worse, stdio keeps a
+ * BUFFER in each process's memory. Anything printed but not yet flushed
+ * when fork() runs is copied into the child, and then both processes
+ * print it ("hello" twice, when the output goes to a file or a pipe).
+ *
+ * An event log avoids both problems:
+ *
+ *   - Every event is a fixed-size RECORD with a CLOCK_MONOTONIC
+ *     timestamp, taken when the event happens. Sorting by timestamp
+ *     gives the true order, whatever order the records were written in.
+ *   - Records go straight into memory shared by all processes (a file
+ *     mapped MAP_SHARED, or an anonymous MAP_SHARED region created before
+ *     fork()). There is no per-process buffer to duplicate, no system
+ *     call, and no terminal lock that every process queues on.
+ *
+ * LOCK-FREE APPENDING:
+ * Writers claim a slot with one atomic fetch-and-add on a shared counter:
+ *
+ *     slot = next++;          (atomically: no two writers get the same slot)
+ *
+ * then fill the record in and, LAST, set its 'committed' word with a
+ * release store. A reader trusts a record only if it sees committed set -
+ * a writer killed half-way leaves a record that is simply skipped. Every
+ * record is one 64-byte cache line, so two processes writing neighbouring
+ * records do not fight over a line. When the log is full, events are
+ * counted as dropped rather than overwriting older ones.
+ *
+ * USAGE:
+ *     struct evlog *log = evlog_create("trace.evlog", 1 << 16);   before fork()
+ *     evlog_emit(log, "request done", bytes);                       any process
+ *     ... later: ./event_merge trace.evlog                          any time
+ *
+ * Ties between equal timestamps are broken by pid and then by each
+ * process's own sequence number, so the merged order is deterministic.
+ */
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <fcntl.h>    /* open() */
+#include <pthread.h>  /* pthread_atfork() */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>     /* clock_gettime() */
+#include <unistd.h>   /* getpid(), ftruncate() */
+#include <sys/mman.h> /* mmap() */
+#include <sys/stat.h> /* fstat() */
+
+#define EVLOG_MAGIC    "EVLOG01"
+#define EVLOG_TEXT     32
+#define EVLOG_COMMITTED 0x45564c47u /* "EVLG": anything else is not a record */
+
+/* One event: exactly one cache line */
+struct evlog_record
+{
+    uint64_t ts_ns;            /* CLOCK_MONOTONIC when the event happened */
+    uint32_t pid;
+    uint32_t seq;              /* Per-process counter: orders equal timestamps */
+    int64_t arg;               /* One number to go with the text */
+    uint32_t committed;        /* EVLOG_COMMITTED once the record is complete */
+    uint16_t len;              /* Bytes of text used */
+    uint16_t reserved;
+    char text[EVLOG_TEXT];     /* Not NUL-terminated when full */
+};
+
+struct evlog_header
+{
+    char magic[8];
+    uint32_t record_size;      /* sizeof(struct evlog_record), checked on open */
+    uint32_t reserved;
+    uint64_t capacity;         /* Records */
+    /* The only word every writer updates: keep it off the fields above */
+    _Alignas(64) uint64_t next;
+    uint64_t dropped;
+};
+
+struct evlog
+{
+    struct evlog_header *h;
+    struct evlog_record *records;
+    size_t map_size;
+    /*
+     * This process's record counter. It lives in the handle, not in a
+     * static, so that every .c file logging through this handle shares
+     * it. After fork() the child's copy carries on from the parent's.
+     */
+    uint32_t seq;
+};
+
+_Static_assert(sizeof(struct evlog_record) == 64, "one record per cache line");
+_Static_assert(sizeof(struct evlog_header) == 128, "records start on a cache line");
+
+static inline uint64_t evlog_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * getpid() is a real system call (over 100 ns), more than the rest of an
+ * append. Remember it, and forget it in every child fork() creates.
+ *
+ * Being static, evlog_pid exists once per .c file that includes this
+ * header. So each copy registers its own fork handler, the first time it
+ * is filled in: whichever file a child logs from, it logs its own pid.
+ */
+static pid_t evlog_pid;
+
+static inline void evlog_forget_pid(void)
+{
+    evlog_pid = 0;
+}
+
+static inline pid_t evlog_getpid(void)
+{
+    static int registered;
+    if (evlog_pid == 0)
+    {
+        if (!registered)
+            registered = pthread_atfork(NULL, NULL, evlog_forget_pid) == 0;
+        evlog_pid = getpid();
+    }
+    return evlog_pid;
+}
+
+static inline int evlog_map(struct evlog *log, int fd, size_t size, int prot, int flags)
+{
+    void *p = mmap(NULL, size, prot, (fd < 0 ? MAP_SHARED | MAP_ANONYMOUS : MAP_SHARED) | flags,
+                   fd, 0);
+    if (p == MAP_FAILED)
+    {
+        perror("mmap");
+        return -1;
+    }
+    log->h = p;
+    log->records = (struct evlog_record *)((char *)p + sizeof(struct evlog_header));
+    log->map_size = size;
+    return 0;
+}
+
+/*
+ * Create a log of 'capacity' records in file 'path' (truncated), or in
+ * anonymous shared memory if path is NULL. Call it before fork() so that
+ * every process shares the mapping. Returns NULL on failure.
+ */
+static inline struct evlog *evlog_create(const char *path, uint64_t capacity)
+{
+    size_t size = sizeof(struct evlog_header) + capacity * sizeof(struct evlog_record);
+    struct evlog *log = calloc(1, sizeof(*log));
+    int fd = -1;
+    if (log == NULL)
+        return NULL;
+    if (path != NULL)
+    {
+        /* ftruncate() makes a file of zeros: every record starts uncommitted */
+        if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0 ||
+            ftruncate(fd, (off_t)size) < 0)
+        {
+            perror(path);
+            free(log);
+            return NULL;
+        }
+    }
+    /*
+     * MAP_POPULATE faults every page in now, once, instead of one page
+     * fault per 64 records in the middle of whatever is being traced.
+     */
+    int rc = evlog_map(log, fd, size, PROT_READ | PROT_WRITE, MAP_POPULATE);
+    if (fd >= 0)
+        close(fd); /* The mapping keeps the file */
+    if (rc < 0)
+    {
+        free(log);
+        return NULL;
+    }
+    memcpy(log->h->magic, EVLOG_MAGIC, sizeof(log->h->magic));
+    log->h->record_size = sizeof(struct evlog_record);
+    log->h->capacity = capacity;
+    return log;
+}
+
+/* Map an existing log file read-only, for merging. Returns NULL on failure */
+static inline struct evlog *evlog_open(const char *path)
+{
+    struct evlog *log = calloc(1, sizeof(*log));
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (log == NULL || fd < 0 || fstat(fd, &st) < 0)
+    {
+        perror(path);
+        free(log);
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    int rc = -1;
+    if ((size_t)st.st_size >= sizeof(struct evlog_header))
+        rc = evlog_map(log, fd, (size_t)st.st_size, PROT_READ, 0);
+    close(fd);
+    if (rc < 0 || memcmp(log->h->magic, EVLOG_MAGIC, sizeof(log->h->magic)) != 0 ||
+        log->h->record_size != sizeof(struct evlog_record) ||
+        sizeof(struct evlog_header) + log->h->capacity * sizeof(struct evlog_record) >
+            (size_t)st.st_size)
+    {
+        fprintf(stderr, "%s: not an event log\n", path);
+        if (rc == 0)
+            munmap(log->h, log->map_size);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+static inline void evlog_close(struct evlog *log)
+{
+    munmap(log->h, log->map_size);
+    free(log);
+}
+
+/*
+ * Append one event: up to EVLOG_TEXT bytes of text and a number.
+ * Returns 0, or -1 if the log is full (the event is counted as dropped).
+ */
+static inline int evlog_emit(struct evlog *log, const char *text, int64_t arg)
+{
+    uint64_t ts = evlog_now();
+
+    uint64_t slot = __atomic_fetch_add(&log->h->next, 1, __ATOMIC_RELAXED);
+    if (slot >= log->h->capacity)
+    {
+        __atomic_fetch_add(&log->h->dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    struct evlog_record *r = &log->records[slot];
+    /* strlen(), not strnlen(): gcc warns the latter reads EVLOG_TEXT bytes of short literals */
+    size_t len = strlen(text);
+    if (len > EVLOG_TEXT)
+        len = EVLOG_TEXT;
+    r->ts_ns = ts;
+    r->pid = (uint32_t)evlog_getpid();
+    r->seq = log->seq++;
+    r->arg = arg;
+    r->len = (uint16_t)len;
+    memcpy(r->text, text, len);
+    /* Everything above becomes visible before the record counts as written */
+    __atomic_store_n(&r->committed, EVLOG_COMMITTED, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* printf-style text, cut to EVLOG_TEXT bytes */
+__attribute__((format(printf, 3, 4)))
+static inline int evlog_printf(struct evlog *log, int64_t arg, const char *fmt, ...)
+{
+    char text[EVLOG_TEXT + 1];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    return evlog_emit(log, text, arg);
+}
+
+/* Order of the merged timeline: time, then pid, then the process's own order */
+static inline int evlog_compare(const void *a, const void *b)
+{
+    const struct evlog_record *x = a, *y = b;
+    if (x->ts_ns != y->ts_ns)
+        return x->ts_ns < y->ts_ns ? -1 : 1;
+    if (x->pid != y->pid)
+        return x->pid < y->pid ? -1 : 1;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+/*
+ * Append the committed records of 'log' to the array *out (of *n records,
+ * room for *max), growing it as needed. Returns 0, or -1 if out of memory.
+ */
+static inline int evlog_collect(const struct evlog *log, struct evlog_record **out, size_t *n,
+                                size_t *max)
+{
+    uint64_t used = __atomic_load_n(&log->h->next, __ATOMIC_ACQUIRE);
+    if (used > log->h->capacity)
+        used = log->h->capacity;
+    for (uint64_t i = 0; i < used; i++)
+    {
+        const struct evlog_record *r = &log->records[i];
+        if (__atomic_load_n(&r->committed, __ATOMIC_ACQUIRE) != EVLOG_COMMITTED)
+            continue;
+        if (*n == *max)
+        {
+            *max = *max ? 2 * *max : 1024;
+            struct evlog_record *bigger = realloc(*out, *max * sizeof(**out));
+            if (bigger == NULL)
+                return -1;
+            *out = bigger;
+        }
+        (*out)[(*n)++] = *r;
+    }
+    return 0;
+}
+
+/* Print one record of a merged timeline; t0 is the first timestamp */
+static inline void evlog_print(FILE *fp, const struct evlog_record *r, uint64_t t0)
+{
+    fprintf(fp, "%12.6f ms  pid %-7u #%-5u %-*.*s %lld\n", (double)(r->ts_ns - t0) / 1e6,
+            r->pid, r->seq, EVLOG_TEXT, (int)r->len, r->text, (long long)r->arg);
+}
+
+#endif /* EVENT_LOG_H */
@@ -0,0 +1,306 @@
+/*
+ * CONCEPT: Where does the cost of creating a process go?
+ *
+ * USAGE:
+ *     fork_perf [-n runs] [-m parent_MB] [-o file] [program [args...]]
+ *
+ * fork_wait_exec.c runs a program in three steps: the parent calls
+ * fork(), the child calls exec(), the parent calls wait(). Timing the
+ * whole thing says how long it took, but not WHO paid for WHAT. This
+ * program counts, with the CPU's and the kernel's own event counters
+ * (perf_event_open(2)), what happens in each of four phases:
+ *
+ *     fork (parent)       the parent inside fork(): copying page tables,
+ *                         file table, signal handlers...
+ *     before exec (child) the child from its first instruction up to
+ *                         exec(), and exec() itself until the old memory
+ *                         is gone: the copy-on-write faults of a fresh
+ *                         child, the -o redirection, loading the program
+ *     program (child)     the new program, from exec() to exit()
+ *     wait (parent)       the parent in wait(): mostly asleep
+ *
+ * The counters, where the machine has them:
+ *
+ *     task-clock (ns)        CPU time, kernel included
+ *     cycles, instructions   CPU work
+ *     page-faults            every first touch of a page, and every write
+ *                            to a copy-on-write page after fork()
+ *     context-switches       times the process went to sleep or was
+ *                            preempted
+ *     cpu-migrations         times it moved to another CPU
+ *     dTLB-load-misses       loads whose address translation was not cached
+ *
+ * Virtual machines often have no CPU counters: those rows say "n/a".
+ *
+ * HOW THE CHILD'S SHARE IS SEPARATED:
+ * A counter opened with INHERIT set is copied into every child fork()
+ * creates, and when a child exits its count is ADDED to the parent's. So
+ * the parent opens its counters before fork() and reads them after
+ * wait(), and never needs to know the child's pid:
+ *
+ *     set F    parent only, switched on just around fork()
+ *     set P    parent only, on for the whole run
+ *     set A    INHERIT: parent + every child, on for the whole run
+ *     set E    INHERIT + ENABLE_ON_EXEC, switched off: it stays off in
+ *              the parent, and in each child the kernel switches it on
+ *              during exec()
+ *
+ * Then fork = F, wait = P - F, program = E, and everything the children
+ * did before exec() is A - P - E.
+ *
+ * Fork cost grows with the parent's memory, since all of it has to be
+ * mapped copy-on-write in the child: -m makes the parent touch that many
+ * megabytes first. -o makes each child redirect its output to a file
+ * before exec(), as fork_exec_wait_redirect.c does.
+ *
+ * EXAMPLE:
+ *     ./fork_perf
+ *     ./fork_perf -m 1024 -n 200 -o /dev/null /bin/echo hello
+ *
+ * Counting the kernel's share needs /proc/sys/kernel/perf_event_paranoid
+ * at 1 or lower, or root; otherwise only user-space events are counted.
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o fork_perf fork_perf.c
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>                /* open() for -o */
+#include <linux/perf_event.h>     /* struct perf_event_attr, PERF_* */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>               /* fork(), execvp(), getopt() */
+#include <sys/ioctl.h>            /* PERF_EVENT_IOC_ENABLE / DISABLE */
+#include <sys/syscall.h>          /* SYS_perf_event_open: glibc has no wrapper */
+#include <sys/wait.h>             /* waitpid() */
+
+struct counter
+{
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+};
+
+static const struct counter counters[] = {
+    {"task-clock (ns)", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+    {"dTLB-load-misses", PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+
+#define NCOUNTERS (int)(sizeof(counters) / sizeof(counters[0]))
+
+enum set
+{
+    SET_FORK,   /* F */
+    SET_PARENT, /* P */
+    SET_ALL,    /* A */
+    SET_EXEC,   /* E */
+    NSETS
+};
+
+/*
+ * One set of counters, opened as a GROUP: switching the first one (the
+ * leader) on or off switches them all at the same instant.
+ */
+struct group
+{
+    int fd[NCOUNTERS]; /* -1: not available here */
+    int leader;
+};
+
+/* What one counter read() returns with the read_format below */
+struct reading
+{
+    uint64_t value;
+    uint64_t enabled; /* ns the counter was on ... */
+    uint64_t running; /* ... and ns it really counted (less, if multiplexed) */
+};
+
+static int user_only; /* Kernel counting not allowed: fell back to user space only */
+static int scaled;    /* Some count was estimated from a multiplexed counter */
+
+static void die(const char *what)
+{
+    perror(what);
+    exit(1);
+}
+
+static int perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu, int group_fd)
+{
+    return (int)syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void group_open(struct group *g, int inherit, int enable_on_exec)
+{
+    g->leader = -1;
+    for (int c = 0; c < NCOUNTERS; c++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counters[c].type;
+        attr.config = counters[c].config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = inherit;
+        attr.exclude_hv = 1;
+        attr.exclude_kernel = user_only;
+        /* Only the leader starts off: the rest follow it */
+        attr.disabled = g->leader < 0;
+        attr.enable_on_exec = g->leader < 0 && enable_on_exec;
+
+        /* pid 0, cpu -1: this process (and, with inherit, its children) on any CPU */
+        int group_fd = g->leader < 0 ? -1 : g->fd[g->leader];
+        g->fd[c] = perf_event_open(&attr, 0, -1, group_fd);
+        if (g->fd[c] < 0 && (errno == EACCES || errno == EPERM) && !user_only)
+        {
+            /* perf_event_paranoid forbids counting in the kernel: count the rest */
+            user_only = 1;
+            attr.exclude_kernel = 1;
+            g->fd[c] = perf_event_open(&attr, 0, -1, group_fd);
+        }
+        if (g->fd[c] >= 0 && g->leader < 0)
+            g->leader = c;
+    }
+}
+
+static void group_switch(const struct group *g, unsigned long request)
+{
+    if (g->leader >= 0 && ioctl(g->fd[g->leader], request, 0) < 0)
+        die("ioctl");
+}
+
+/* The count, scaled up if the counter only ran part of the time */
+static double group_read(const struct group *g, int c)
+{
+    struct reading r;
+    if (read(g->fd[c], &r, sizeof(r)) != sizeof(r))
+        die("read");
+    if (r.running == 0)
+        return 0;
+    if (r.running < r.enabled)
+    {
+        scaled = 1;
+        return (double)r.value * (double)r.enabled / (double)r.running;
+    }
+    return (double)r.value;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n runs] [-m parent_MB] [-o file] [program [args...]]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 1000;
+    long parent_mb = 0;
+    const char *outfile = NULL;
+    char *default_argv[] = {"/bin/true", NULL};
+    char **child_argv = default_argv;
+    int opt;
+
+    /* '+': stop at the program name, its options are its own */
+    while ((opt = getopt(argc, argv, "+n:m:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': runs = atoi(optarg); break;
+        case 'm': parent_mb = atol(optarg); break;
+        case 'o': outfile = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (runs < 1 || parent_mb < 0)
+        usage(argv[0]);
+    if (optind < argc)
+        child_argv = &argv[optind];
+
+    /* Memory fork() will have to share copy-on-write with every child */
+    if (parent_mb > 0)
+    {
+        size_t size = (size_t)parent_mb << 20;
+        char *mem = malloc(size);
+        if (mem == NULL)
+            die("malloc");
+        memset(mem, 1, size);
+    }
+
+    struct group sets[NSETS];
+    group_open(&sets[SET_FORK], 0, 0);
+    group_open(&sets[SET_PARENT], 0, 0);
+    group_open(&sets[SET_ALL], 1, 0);
+    group_open(&sets[SET_EXEC], 1, 1);
+    if (sets[SET_ALL].leader < 0)
+        die("perf_event_open");
+
+    /* A's parent share must match P's: on in this order, off in reverse */
+    group_switch(&sets[SET_ALL], PERF_EVENT_IOC_ENABLE);
+    group_switch(&sets[SET_PARENT], PERF_EVENT_IOC_ENABLE);
+    for (int i = 0; i < runs; i++)
+    {
+        group_switch(&sets[SET_FORK], PERF_EVENT_IOC_ENABLE);
+        pid_t rc = fork();
+        if (rc == 0)
+        {
+            /* The child: inherited A counts from here, E from inside exec() */
+            if (outfile != NULL)
+            {
+                int fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0)
+                    _exit(127);
+                close(fd);
+            }
+            execvp(child_argv[0], child_argv);
+            _exit(127);
+        }
+        group_switch(&sets[SET_FORK], PERF_EVENT_IOC_DISABLE);
+        if (rc < 0)
+            die("fork");
+
+        int status;
+        if (waitpid(rc, &status, 0) < 0)
+            die("waitpid");
+        if (i == 0 && !(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+            fprintf(stderr, "warning: %s did not exit with status 0\n", child_argv[0]);
+    }
+    group_switch(&sets[SET_PARENT], PERF_EVENT_IOC_DISABLE);
+    group_switch(&sets[SET_ALL], PERF_EVENT_IOC_DISABLE);
+
+    printf("%d runs of %s, parent touched %ld MB%s; averages per run\n\n", runs, child_argv[0],
+           parent_mb, outfile ? ", child output redirected" : "");
+    printf("%-18s %14s %14s %14s %14s\n", "", "fork", "before exec", "program", "wait");
+    printf("%-18s %14s %14s %14s %14s\n", "", "(parent)", "(child)", "(child)", "(parent)");
+    for (int c = 0; c < NCOUNTERS; c++)
+    {
+        int available = 1;
+        for (int s = 0; s < NSETS; s++)
+            available &= sets[s].fd[c] >= 0;
+        if (!available)
+        {
+            printf("%-18s %14s %14s %14s %14s\n", counters[c].name, "n/a", "n/a", "n/a", "n/a");
+            continue;
+        }
+        double f = group_read(&sets[SET_FORK], c);
+        double p = group_read(&sets[SET_PARENT], c);
+        double a = group_read(&sets[SET_ALL], c);
+        double e = group_read(&sets[SET_EXEC], c);
+        printf("%-18s %14.1f %14.1f %14.1f %14.1f\n", counters[c].name, f / runs,
+               (a - p - e) / runs, e / runs, (p - f) / runs);
+    }
+
+    if (user_only)
+        printf("\nkernel counting not permitted (perf_event_paranoid): user space only\n");
+    if (scaled)
+        printf("\nsome counters were multiplexed: their counts are estimates\n");
+    return 0;
+}
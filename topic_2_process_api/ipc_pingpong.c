@@ -0,0 +1,444 @@
+/*
+ * CONCEPT: How fast can a parent and its forked child talk?
+ *
+ * USAGE:
+ *     ipc_pingpong [-n round_trips] [-w warmup] [-m methods] [-a cpu] [-b cpu] [-s spins]
+ *
+ * In fork_wait.c the only thing the parent ever hears from its child is
+ * the final wait(). Real workers talk to their parent all the time, and
+ * every message is a trip through the kernel: the sender makes a system
+ * call, the receiver - asleep in another system call - must be WOKEN UP
+ * and SCHEDULED before it can answer.
+ *
+ * This program measures that cost with a PING-PONG: the parent sends one
+ * tiny message, the child answers it, and the parent times the ROUND
+ * TRIP. It does so over five channels a forked pair can share:
+ *
+ *     pipe        two pipe()s, one per direction, 1 byte each way
+ *     socketpair  one AF_UNIX SOCK_STREAM socketpair(), both directions
+ *     eventfd     two eventfd()s: a write() adds to a counter, a read()
+ *                 takes it - no data at all, just "wake up"
+ *     mqueue      two POSIX message queues (mq_open), 1 byte each way
+ *     futex       one int on a MAP_SHARED anonymous page, created before
+ *                 fork() so both processes see it. A message is a store
+ *                 plus FUTEX_WAKE; waiting is FUTEX_WAIT, which sleeps
+ *                 only while the int still holds the value we saw
+ *
+ * The first four are FILE DESCRIPTORS, inherited across fork() like any
+ * other; the futex is plain shared memory, and the kernel is only asked
+ * for help when someone has to sleep or be woken.
+ *
+ * SAME CORE vs DIFFERENT CORES:
+ * Every method runs twice. First parent and child are pinned to the SAME
+ * CPU (-a): each message is a context switch, the receiver runs only once
+ * the sender sleeps. Then they are pinned to DIFFERENT CPUs (-a and -b):
+ * no context switch, but the waker must send an interrupt to the other
+ * CPU, which may have to come out of an idle state. On a 1-CPU machine
+ * the second run is skipped.
+ *
+ * With -s the futex receiver first SPINS that many times on the shared
+ * int before going to sleep: across cores, a message then costs about a
+ * cache-line transfer. On one core spinning only burns the time slice
+ * the sender needs.
+ *
+ * OUTPUT: round-trip latency percentiles in microseconds, round trips per
+ * second and messages per second (two per round trip).
+ *
+ * EXAMPLE:
+ *     ./ipc_pingpong -n 200000
+ *     ./ipc_pingpong -m futex,pipe -a 0 -b 2 -s 1000
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o ipc_pingpong ipc_pingpong.c -lrt
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>          /* O_* constants for mq_open() */
+#include <linux/futex.h>    /* FUTEX_WAIT, FUTEX_WAKE */
+#include <mqueue.h>         /* mq_open(), mq_send(), mq_receive() */
+#include <sched.h>          /* sched_setaffinity() */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>           /* clock_gettime() */
+#include <unistd.h>         /* fork(), pipe(), getopt() */
+#include <sys/eventfd.h>    /* eventfd() */
+#include <sys/mman.h>       /* mmap() for the futex page */
+#include <sys/socket.h>     /* socketpair() */
+#include <sys/syscall.h>    /* SYS_futex: glibc has no futex() wrapper */
+#include <sys/wait.h>       /* waitpid() */
+
+enum method
+{
+    M_PIPE,
+    M_SOCKETPAIR,
+    M_EVENTFD,
+    M_MQUEUE,
+    M_FUTEX,
+    M_COUNT
+};
+
+static const char *const method_names[M_COUNT] = {"pipe", "socketpair", "eventfd", "mqueue",
+                                                  "futex"};
+
+/* Directions: TO_CHILD is the ping, TO_PARENT the pong */
+enum
+{
+    TO_CHILD,
+    TO_PARENT
+};
+
+/*
+ * Everything both ends need, set up BEFORE fork() so the child inherits
+ * it: descriptors are copied into the child, the futex page is shared.
+ */
+struct channel
+{
+    enum method method;
+    int fd[2][2];            /* pipe: [direction][read end, write end] */
+    int sock[2];             /* socketpair: [parent end, child end] */
+    int efd[2];              /* eventfd per direction */
+    mqd_t mq[2];             /* message queue per direction */
+    int *word;               /* futex: 0 at rest, 1 = ping sent, 2 = pong sent */
+    int spins;
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long futex(int *addr, int op, int val)
+{
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+/* Sleep until *word == want. FUTEX_WAIT returns at once if *word changed */
+static void futex_wait_for(struct channel *ch, int want)
+{
+    for (int i = 0; i < ch->spins; i++)
+        if (__atomic_load_n(ch->word, __ATOMIC_ACQUIRE) == want)
+            return;
+    int v;
+    while ((v = __atomic_load_n(ch->word, __ATOMIC_ACQUIRE)) != want)
+        futex(ch->word, FUTEX_WAIT, v);
+}
+
+static void futex_post(struct channel *ch, int value)
+{
+    __atomic_store_n(ch->word, value, __ATOMIC_RELEASE);
+    futex(ch->word, FUTEX_WAKE, 1);
+}
+
+static void die(const char *what)
+{
+    perror(what);
+    exit(1);
+}
+
+static void channel_open(struct channel *ch, enum method m, int spins)
+{
+    memset(ch, 0, sizeof(*ch));
+    ch->method = m;
+    ch->spins = spins;
+    switch (m)
+    {
+    case M_PIPE:
+        if (pipe(ch->fd[TO_CHILD]) < 0 || pipe(ch->fd[TO_PARENT]) < 0)
+            die("pipe");
+        break;
+    case M_SOCKETPAIR:
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, ch->sock) < 0)
+            die("socketpair");
+        break;
+    case M_EVENTFD:
+        if ((ch->efd[TO_CHILD] = eventfd(0, 0)) < 0 || (ch->efd[TO_PARENT] = eventfd(0, 0)) < 0)
+            die("eventfd");
+        break;
+    case M_MQUEUE:
+        for (int d = 0; d < 2; d++)
+        {
+            char name[64];
+            struct mq_attr attr = {0};
+            attr.mq_maxmsg = 1;
+            attr.mq_msgsize = 1;
+            snprintf(name, sizeof(name), "/ipc_pingpong-%d-%d", (int)getpid(), d);
+            if ((ch->mq[d] = mq_open(name, O_RDWR | O_CREAT | O_EXCL, 0600, &attr)) == (mqd_t)-1)
+                die("mq_open");
+            /* Like an unlinked temp file: gone once both processes close it */
+            mq_unlink(name);
+        }
+        break;
+    case M_FUTEX:
+        ch->word = mmap(NULL, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                        -1, 0);
+        if (ch->word == MAP_FAILED)
+            die("mmap");
+        *ch->word = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+static void channel_close(struct channel *ch)
+{
+    switch (ch->method)
+    {
+    case M_PIPE:
+        for (int d = 0; d < 2; d++)
+        {
+            close(ch->fd[d][0]);
+            close(ch->fd[d][1]);
+        }
+        break;
+    case M_SOCKETPAIR:
+        close(ch->sock[0]);
+        close(ch->sock[1]);
+        break;
+    case M_EVENTFD:
+        close(ch->efd[0]);
+        close(ch->efd[1]);
+        break;
+    case M_MQUEUE:
+        mq_close(ch->mq[0]);
+        mq_close(ch->mq[1]);
+        break;
+    case M_FUTEX:
+        munmap(ch->word, sizeof(int));
+        break;
+    default:
+        break;
+    }
+}
+
+/* Send one message in direction 'dir' */
+static void channel_send(struct channel *ch, int dir)
+{
+    char byte = 'x';
+    uint64_t one = 1;
+    int ok = 1;
+    switch (ch->method)
+    {
+    case M_PIPE: ok = write(ch->fd[dir][1], &byte, 1) == 1; break;
+    case M_SOCKETPAIR: ok = write(ch->sock[dir == TO_CHILD ? 0 : 1], &byte, 1) == 1; break;
+    case M_EVENTFD: ok = write(ch->efd[dir], &one, sizeof(one)) == sizeof(one); break;
+    case M_MQUEUE: ok = mq_send(ch->mq[dir], &byte, 1, 0) == 0; break;
+    case M_FUTEX: futex_post(ch, dir == TO_CHILD ? 1 : 2); break;
+    default: break;
+    }
+    if (!ok)
+        die(method_names[ch->method]);
+}
+
+/* Wait for, and consume, one message travelling in direction 'dir' */
+static void channel_recv(struct channel *ch, int dir)
+{
+    char byte;
+    uint64_t count;
+    int ok = 1;
+    switch (ch->method)
+    {
+    case M_PIPE: ok = read(ch->fd[dir][0], &byte, 1) == 1; break;
+    case M_SOCKETPAIR: ok = read(ch->sock[dir == TO_CHILD ? 1 : 0], &byte, 1) == 1; break;
+    case M_EVENTFD: ok = read(ch->efd[dir], &count, sizeof(count)) == sizeof(count); break;
+    case M_MQUEUE: ok = mq_receive(ch->mq[dir], &byte, 1, NULL) == 1; break;
+    case M_FUTEX: futex_wait_for(ch, dir == TO_CHILD ? 1 : 2); break;
+    default: break;
+    }
+    if (!ok)
+        die(method_names[ch->method]);
+}
+
+static void pin(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+        die("sched_setaffinity");
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Value at fraction p of the sorted samples */
+static double percentile(const double *sorted, int n, double p)
+{
+    int k = (int)(p * (n - 1) + 0.5);
+    return sorted[k];
+}
+
+/*
+ * One ping-pong run: 'warmup' untimed round trips (page faults, first
+ * wakeups), then 'n' timed ones. Returns the total seconds of the timed
+ * part; rtt[] gets each round trip in microseconds.
+ */
+static double run(enum method m, int cpu_parent, int cpu_child, int n, int warmup, int spins,
+                  double *rtt)
+{
+    struct channel ch;
+    channel_open(&ch, m, spins);
+    pin(cpu_parent);
+
+    /*
+     * The child says "ready" once it is pinned. An eventfd, mqueue or futex
+     * never reports that the other side is gone, so a child that died before
+     * its first pong would leave the parent waiting forever; this pipe
+     * reports it as end-of-file instead.
+     */
+    int ready[2];
+    if (pipe(ready) < 0)
+        die("pipe");
+
+    /* Else a child that dies through exit() prints our buffered output again */
+    fflush(stdout);
+    pid_t rc = fork();
+    if (rc < 0)
+        die("fork");
+    if (rc == 0)
+    {
+        /* CHILD: answer every ping with a pong, then leave */
+        close(ready[0]);
+        pin(cpu_child);
+        if (write(ready[1], "r", 1) != 1)
+            die("write");
+        close(ready[1]);
+        for (int i = 0; i < warmup + n; i++)
+        {
+            channel_recv(&ch, TO_CHILD);
+            channel_send(&ch, TO_PARENT);
+        }
+        _exit(0);
+    }
+
+    char byte;
+    close(ready[1]);
+    if (read(ready[0], &byte, 1) != 1)
+    {
+        fprintf(stderr, "%s: child failed to start\n", method_names[m]);
+        exit(1);
+    }
+    close(ready[0]);
+
+    /* PARENT: ping, wait for the pong, repeat */
+    for (int i = 0; i < warmup; i++)
+    {
+        channel_send(&ch, TO_CHILD);
+        channel_recv(&ch, TO_PARENT);
+    }
+    double start = now_seconds();
+    for (int i = 0; i < n; i++)
+    {
+        double t = now_seconds();
+        channel_send(&ch, TO_CHILD);
+        channel_recv(&ch, TO_PARENT);
+        rtt[i] = (now_seconds() - t) * 1e6;
+    }
+    double elapsed = now_seconds() - start;
+
+    waitpid(rc, NULL, 0);
+    channel_close(&ch);
+    return elapsed;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n round_trips] [-w warmup] [-m pipe,socketpair,eventfd,mqueue,"
+                    "futex] [-a cpu] [-b cpu] [-s spins]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int n = 100000, warmup = 1000, spins = 0;
+    int cpu_a = 0, cpu_b = -1;
+    int use[M_COUNT] = {1, 1, 1, 1, 1};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:m:a:b:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': n = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'a': cpu_a = atoi(optarg); break;
+        case 'b': cpu_b = atoi(optarg); break;
+        case 's': spins = atoi(optarg); break;
+        case 'm':
+        {
+            memset(use, 0, sizeof(use));
+            for (char *name = strtok(optarg, ","); name; name = strtok(NULL, ","))
+            {
+                int m = 0;
+                while (m < M_COUNT && strcmp(name, method_names[m]) != 0)
+                    m++;
+                if (m == M_COUNT)
+                    usage(argv[0]);
+                use[m] = 1;
+            }
+            break;
+        }
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || n < 1 || warmup < 0 || spins < 0 || cpu_a < 0 || cpu_b < -1)
+        usage(argv[0]);
+
+    /* The "different cores" partner: -b, or the first allowed CPU that is not -a */
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int pinned[2] = {cpu_a, cpu_b}; /* -1: -b not given */
+    for (int i = 0; i < 2; i++)
+    {
+        int cpu = pinned[i];
+        if (cpu >= 0 && (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed)))
+        {
+            fprintf(stderr, "cpu %d is not available\n", cpu);
+            return 1;
+        }
+    }
+    for (int c = 0; cpu_b < 0 && c < CPU_SETSIZE; c++)
+        if (c != cpu_a && CPU_ISSET(c, &allowed))
+            cpu_b = c;
+
+    double *rtt = malloc(sizeof(*rtt) * (size_t)n);
+    if (rtt == NULL)
+        die("malloc");
+
+    printf("%d round trips per run, %d warmup, 1-byte messages\n\n", n, warmup);
+    printf("%-11s %-7s %8s %8s %8s %8s %8s %13s %12s\n", "method", "cpus", "p50", "p90", "p99",
+           "p99.9", "max", "round trips/s", "msgs/s");
+    printf("%-11s %-7s %8s %8s %8s %8s %8s\n", "", "", "(us)", "(us)", "(us)", "(us)", "(us)");
+    for (int m = 0; m < M_COUNT; m++)
+    {
+        if (!use[m])
+            continue;
+        for (int same = 1; same >= 0; same--)
+        {
+            int other = same ? cpu_a : cpu_b;
+            char cpus[16];
+            snprintf(cpus, sizeof(cpus), "%d,%d", cpu_a, other);
+            if (other < 0)
+            {
+                printf("%-11s %-7s skipped: only one CPU available\n", method_names[m], "x,y");
+                continue;
+            }
+            double elapsed = run((enum method)m, cpu_a, other, n, warmup, spins, rtt);
+            qsort(rtt, (size_t)n, sizeof(*rtt), cmp_double);
+            printf("%-11s %-7s %8.2f %8.2f %8.2f %8.2f %8.1f %13.0f %12.0f\n", method_names[m],
+                   cpus, percentile(rtt, n, 0.50), percentile(rtt, n, 0.90),
+                   percentile(rtt, n, 0.99), percentile(rtt, n, 0.999), rtt[n - 1], n / elapsed,
+                   2 * n / elapsed);
+            fflush(stdout);
+        }
+    }
+    free(rtt);
+    return 0;
+}
@@ -10,25 +10,343 @@
  *
  * KEY CONCEPT: The separation of fork() and exec() is what makes shells powerful.
  * Between fork() and exec(), the shell can set up redirections, pipes, etc.
+ *
+ * This shell understands a little more than a bare program name:
+ *     ls -l $HOME            words, and $VARIABLES expanded from the environment
+ *     cat ~/notes.txt        ~ at the start of a word means $HOME
+ *     echo 'a  b' "$USER"    quotes: '...' literal, "..." still expands $VARS
+ *     sort < in > out        redirections: < file, > file, >> file
+ *
+ * MEMORY: AN ARENA PER LINE
+ * =========================
+ * Every line needs memory: a copy of each word, the argv array, one small
+ * record per redirection. All of it lives exactly as long as the command -
+ * until wait() returns. So instead of a malloc() per piece and a free()
+ * per piece, the shell takes it all from an ARENA: one big block and a
+ * pointer to the first unused byte. Allocating moves the pointer forward;
+ * after wait(), ONE assignment frees everything at once.
+ *
+ * The arena only calls malloc() when a line needs more than the block
+ * holds; it then switches to a block twice as big and keeps it. Once the
+ * block is big enough for the longest line, the command loop runs with
+ * no malloc() and no free() at all. Run with -s to see the counters:
+ *
+ *     seq 100000 | sed 's/^/true /' | ./minimal_shell -s
  */
 
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>    /* open() and O_* flags, for redirections */
+#include <malloc.h>   /* mallinfo2(): how much heap is in use, for -s */
+#include <sys/wait.h> /* wait() */
+
+#define MAXLINE 1024 /* Maximum length of a command the user can type */
+
+/* ==========================================================================
+ * THE ARENA
+ * ========================================================================== */
+
+/*
+ * The first bytes of every block are kept for a pointer: when a line
+ * outgrows a block, the block is chained on the retired list through them.
+ */
+#define ARENA_LINK 16
+
+struct arena
+{
+    char *block;        /* Current block */
+    size_t used, size;  /* Bytes handed out / bytes in the block */
+    char *retired;      /* Blocks outgrown during this line, freed at reset */
+
+    /* Counters, printed by -s */
+    unsigned long allocs;     /* arena_alloc() calls */
+    unsigned long bytes;      /* ... and the bytes they asked for */
+    unsigned long mallocs;    /* Blocks obtained with malloc() */
+    unsigned long frees;      /* Blocks given back with free() */
+    size_t peak;              /* Most bytes one line ever needed */
+};
+
+/*
+ * Hand out 'n' bytes, aligned for any type. Runs out only if malloc()
+ * does: then the shell cannot go on anyway.
+ */
+static void *arena_alloc(struct arena *a, size_t n)
+{
+    size_t start = (a->used + 15) & ~(size_t)15; /* 16-byte alignment */
+    if (start + n > a->size)
+    {
+        /*
+         * Out of room. Earlier allocations of this line still point into
+         * the old block, so it cannot be realloc()ed: retire it (its first
+         * bytes chain the retired blocks together) and start a bigger one.
+         */
+        size_t size = a->size ? 2 * a->size : 4096;
+        while (size < n + 16)
+            size *= 2;
+        char *block = malloc(size);
+        if (block == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        a->mallocs++;
+        if (a->block != NULL)
+        {
+            *(char **)a->block = a->retired;
+            a->retired = a->block;
+        }
+        a->block = block;
+        a->size = size;
+        start = ARENA_LINK;
+    }
+    a->used = start + n;
+    a->allocs++;
+    a->bytes += n;
+    if (a->used > a->peak)
+        a->peak = a->used;
+    return a->block + start;
+}
+
+/* Free everything allocated since the last reset */
+static void arena_reset(struct arena *a)
+{
+    while (a->retired != NULL) /* Only after a line outgrew the block */
+    {
+        char *next = *(char **)a->retired;
+        free(a->retired);
+        a->frees++;
+        a->retired = next;
+    }
+    a->used = ARENA_LINK; /* THE reset: one assignment */
+}
+
+/* ==========================================================================
+ * PARSING A LINE
+ * ========================================================================== */
+
+/* One redirection: open 'path' with 'flags' as descriptor 'fd' */
+struct redir
+{
+    int fd;
+    int flags;
+    const char *path;
+    struct redir *next;
+};
+
+struct command
+{
+    char **argv;           /* NULL-terminated, ready for execvp() */
+    int argc;
+    struct redir *redirs;  /* In the order they were typed */
+};
+
+static int is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int is_special(char c)
+{
+    return c == '<' || c == '>';
+}
+
+/*
+ * Expand the word starting at *src, up to the next unquoted space or
+ * redirection: remove quotes, replace $NAME and a leading ~. If 'dst' is
+ * not NULL the result is written there. Returns its length either way,
+ * and leaves *src after the word - or BAD_WORD if a quote is never closed.
+ *
+ * The arena wants the size before the bytes, so a word is expanded twice:
+ * once to measure it, once to copy it.
+ */
+#define BAD_WORD ((size_t)-1)
+
+static size_t expand_word(const char **src, char *dst)
+{
+    const char *p = *src;
+    size_t len = 0;
+    char quote = 0;
+
+    if (*p == '~' && (p[1] == '/' || p[1] == '\0' || is_space(p[1])))
+    {
+        const char *home = getenv("HOME");
+        size_t n = home ? strlen(home) : 0;
+        if (dst && n)
+            memcpy(dst, home, n);
+        len += n;
+        p++;
+    }
+
+    while (*p && (quote || (!is_space(*p) && !is_special(*p))))
+    {
+        if (!quote && (*p == '\'' || *p == '"'))
+        {
+            quote = *p++;
+            continue;
+        }
+        if (quote && *p == quote)
+        {
+            quote = 0;
+            p++;
+            continue;
+        }
+        if (*p == '$' && quote != '\'' && (p[1] == '_' || (p[1] >= 'A' && p[1] <= 'Z') ||
+                                           (p[1] >= 'a' && p[1] <= 'z')))
+        {
+            /* $NAME: copy the name to the stack to look it up - no malloc */
+            char name[MAXLINE];
+            size_t n = 0;
+            p++;
+            while (*p == '_' || (*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z') ||
+                   (*p >= '0' && *p <= '9'))
+                name[n++] = *p++;
+            name[n] = '\0';
+            const char *value = getenv(name);
+            n = value ? strlen(value) : 0;
+            if (dst && n)
+                memcpy(dst + len, value, n);
+            len += n;
+            continue;
+        }
+        if (dst)
+            dst[len] = *p;
+        len++;
+        p++;
+    }
+    if (quote)
+        return BAD_WORD; /* 'abc<newline>: the quote ran into the end of the line */
+    *src = p;
+    return len;
+}
+
+/* A copy of the next word, expanded, in the arena; NULL after a message if it is bad */
+static char *next_word(struct arena *a, const char **p)
+{
+    const char *start = *p;
+    size_t len = expand_word(p, NULL);
+    if (len == BAD_WORD)
+    {
+        fprintf(stderr, "syntax error: unterminated quote\n");
+        return NULL;
+    }
+    char *word = arena_alloc(a, len + 1);
+    expand_word(&start, word);
+    word[len] = '\0';
+    return word;
+}
+
+/*
+ * Split 'line' into a command. Every byte of the result is in the arena.
+ * Returns 0, or -1 (after a message) if the line makes no sense.
+ */
+static int parse_line(struct arena *a, const char *line, struct command *cmd)
+{
+    /* A word takes at least two characters, counting the space after it */
+    size_t max_words = strlen(line) / 2 + 2;
+    struct redir **last = &cmd->redirs;
+
+    cmd->argv = arena_alloc(a, max_words * sizeof(char *));
+    cmd->argc = 0;
+    cmd->redirs = NULL;
+
+    const char *p = line;
+    for (;;)
+    {
+        while (is_space(*p))
+            p++;
+        if (*p == '\0')
+            break;
+
+        if (is_special(*p))
+        {
+            struct redir *r = arena_alloc(a, sizeof(*r));
+            if (*p == '<')
+            {
+                r->fd = STDIN_FILENO;
+                r->flags = O_RDONLY;
+                p++;
+            }
+            else if (p[1] == '>')
+            {
+                r->fd = STDOUT_FILENO;
+                r->flags = O_WRONLY | O_CREAT | O_APPEND;
+                p += 2;
+            }
+            else
+            {
+                r->fd = STDOUT_FILENO;
+                r->flags = O_WRONLY | O_CREAT | O_TRUNC;
+                p++;
+            }
+            while (is_space(*p))
+                p++;
+            if (*p == '\0' || is_special(*p))
+            {
+                fprintf(stderr, "syntax error: redirection without a file name\n");
+                return -1;
+            }
+            if ((r->path = next_word(a, &p)) == NULL)
+                return -1;
+            r->next = NULL;
+            *last = r;
+            last = &r->next;
+            continue;
+        }
+
+        if ((cmd->argv[cmd->argc++] = next_word(a, &p)) == NULL)
+            return -1;
+    }
+    cmd->argv[cmd->argc] = NULL;
+    return 0;
+}
 
-#define MAXLINE 100 /* Maximum length of a command the user can type */
+/* ==========================================================================
+ * THE SHELL
+ * ========================================================================== */
 
-int main()
+static void print_stats(const struct arena *a, size_t heap_start, unsigned long lines,
+                        unsigned long commands)
+{
+    size_t heap_end = mallinfo2().uordblks;
+    fprintf(stderr,
+            "\n%lu lines, %lu commands run\n"
+            "arena: %lu allocations (%lu bytes), peak %zu bytes per line\n"
+            "arena: %lu malloc() and %lu free() of blocks in total, block now %zu bytes\n"
+            "heap in use: %zu bytes after the first line, %zu at the end\n",
+            lines, commands, a->allocs, a->bytes, a->peak, a->mallocs, a->frees, a->size,
+            heap_start, heap_end);
+}
+
+int main(int argc, char *argv[])
 {
     char buf[MAXLINE]; /* Buffer to store the command typed by user */
     pid_t rc;          /* Will hold return value of fork() */
+    struct arena arena = {0};
+    struct command cmd;
+    unsigned long lines = 0, commands = 0;
+    int stats = argc > 1 && strcmp(argv[1], "-s") == 0;
+    int interactive = isatty(STDIN_FILENO);
+
+    /*
+     * Warm up: get the first arena block now rather than on the first
+     * line. (stdio allocates stdin's buffer on the first read: the -s heap
+     * figure is taken after that, once the first line is in.)
+     */
+    arena_alloc(&arena, 1);
+    arena_reset(&arena);
+    arena.allocs = arena.bytes = 0;
+    size_t heap_start = 0;
 
     /*
      * Print the shell prompt: "%"
-     * Real shells use "$" or ">" but we use "%" to distinguish our mini-shell
+     * Real shells use "$" or ">" but we use "%" to distinguish our mini-shell.
+     * Like them, we only prompt when a person is typing, not for a script.
      */
-    printf("%% ");
+    if (interactive)
+        printf("%% ");
+    fflush(stdout);
 
     /*
      * THE MAIN SHELL LOOP
@@ -38,15 +356,47 @@ int main()
      */
     while (fgets(buf, MAXLINE, stdin) != NULL)
     {
+        if (lines++ == 0)
+            heap_start = mallinfo2().uordblks;
+
+        /*
+         * No '\n' in buf: either the last line has none, or fgets() stopped
+         * at MAXLINE - 1 characters. Running the pieces as separate commands
+         * would be wrong, so refuse the whole line.
+         */
+        if (strchr(buf, '\n') == NULL)
+        {
+            int c = getchar();
+            if (c != EOF && c != '\n')
+            {
+                while (c != EOF && c != '\n')
+                    c = getchar();
+                fprintf(stderr, "line too long (max %d characters)\n", MAXLINE - 1);
+                if (interactive)
+                    printf("%% ");
+                fflush(stdout);
+                continue;
+            }
+        }
+
+        /*
+         * Turn "sort < in > out" into argv = {"sort", NULL} plus two
+         * redirections. Every piece comes from the arena.
+         */
+        if (parse_line(&arena, buf, &cmd) < 0 || cmd.argc == 0)
+        {
+            arena_reset(&arena);
+            if (interactive)
+                printf("%% ");
+            fflush(stdout);
+            continue;
+        }
 
         /*
-         * HOUSEKEEPING: Remove the newline character
-         * When user types "ls" and presses Enter, buf contains "ls\n"
-         * We need to replace '\n' with '\0' (null terminator) so it becomes "ls"
-         * Otherwise, execvp would try to run a program literally named "ls\n"
+         * Flush before fork(): anything still in stdout's buffer would be
+         * copied into the child and could come out twice.
          */
-        if (buf[strlen(buf) - 1] == '\n')
-            buf[strlen(buf) - 1] = '\0';
+        fflush(stdout);
 
         /*
          * STEP 1: CREATE A NEW PROCESS
@@ -57,7 +407,11 @@ int main()
          *   - Parent (the shell): rc = child's PID (positive number)
          *   - Child (will run the command): rc = 0
          *   - If fork failed: rc = -1 (negative)
+         *
+         * The child gets a COPY of the arena too, so cmd.argv and the
+         * redirections are still valid there.
          */
+        commands++;
         rc = fork();
 
         if (rc < 0)
@@ -71,22 +425,23 @@ int main()
             /*
              * CHILD PROCESS - This code runs in the newly created process
              * =============
-             * The child's job: transform itself into the program the user requested
-             */
-
-            /*
-             * Set up arguments for execvp()
-             * execvp() expects: execvp(program_name, argument_array)
-             *
-             * argv[0] = program name (convention: first arg is always the program name)
-             * argv[1] = NULL (signals end of argument list)
-             *
-             * NOTE: This simple shell doesn't handle command-line arguments!
-             * A real shell would parse "ls -l" into argv = {"ls", "-l", NULL}
+             * First the redirections, exactly as in fork_exec_wait_redirect.c:
+             * open the file, then make it the descriptor the program will use.
              */
-            char *argv[2];
-            argv[0] = buf;  /* The command to run, e.g., "ls" */
-            argv[1] = NULL; /* No additional arguments */
+            for (struct redir *r = cmd.redirs; r != NULL; r = r->next)
+            {
+                int fd = open(r->path, r->flags, 0644);
+                if (fd < 0)
+                {
+                    perror(r->path);
+                    exit(1);
+                }
+                if (fd != r->fd)
+                {
+                    dup2(fd, r->fd);
+                    close(fd);
+                }
+            }
 
             /*
              * STEP 2: REPLACE CHILD'S CODE WITH THE REQUESTED PROGRAM
@@ -103,7 +458,7 @@ int main()
              * CRITICAL: If execvp succeeds, it NEVER RETURNS!
              * The lines below only run if execvp FAILS.
              */
-            execvp(buf, argv);
+            execvp(cmd.argv[0], cmd.argv);
 
             /* If we reach here, exec failed (program not found, no permission, etc.) */
             fprintf(stderr, "exec error\n");
@@ -130,10 +485,22 @@ int main()
              */
             wait(NULL);
 
+            /*
+             * STEP 4: FORGET THE LINE
+             * =======================
+             * The child is gone, and with it the last user of this line's
+             * words. One pointer move frees them all.
+             */
+            arena_reset(&arena);
+
             /* Child finished, print prompt for next command */
-            printf("%% ");
+            if (interactive)
+                printf("%% ");
+            fflush(stdout);
         }
     }
 
+    if (stats)
+        print_stats(&arena, heap_start, lines, commands);
     exit(0); /* User typed Ctrl+D, exit the shell gracefully */
-}
\ No newline at end of file
+}
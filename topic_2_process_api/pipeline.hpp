@@ -0,0 +1,224 @@
+/*
+ * pipeline.hpp - Shell pipelines built by the compiler: cmd("ls") | cmd("wc")
+ *
+ * KEY CONCEPT: When a shell runs "ls -l | wc -l" it first has to PARSE the
+ * line: split it into words, find the '|', build an argv array for each
+ * side - all with malloc(), every time. Only then come the system calls
+ * that do the real work, as in fork_wait_exec.c: pipe(), fork() and
+ * exec() once per stage, wait() once per stage.
+ *
+ * For a pipeline that is fixed in the source code, all of that first half
+ * can happen at COMPILE TIME:
+ *
+ *     static constexpr auto count = proc::cmd("ls", "-l") | proc::cmd("wc", "-l");
+ *     int status = count.run();
+ *
+ * 'count' is a constant, like a table of numbers: the argv arrays of both
+ * stages, laid out by the compiler in read-only data. cmd() and '|' are
+ * constexpr functions that only run inside the compiler, and a mistake
+ * such as an empty program name is a compile error, not a run-time one.
+ *
+ * AT RUN TIME, run() and spawn() only do the system calls: one pipe()
+ * between each two stages, then for each stage vfork(), dup2() the pipe
+ * ends onto stdin/stdout, and execvp() the prebuilt argv. No parsing and
+ * no heap allocation; a pipeline of k stages lives in a few arrays on the
+ * stack.
+ *
+ * WHY vfork(): fork() copies the parent's page tables, vfork() lends the
+ * child the parent's memory until it calls exec() or _exit() - much
+ * cheaper for a big parent. The price is that the child may do almost
+ * nothing before exec(): here only dup2() and execvp(). Because the
+ * memory is shared, a child whose exec fails can even store its errno
+ * where the parent will find it.
+ *
+ * Use absolute paths ("/usr/bin/wc") to skip execvp()'s PATH search too.
+ */
+
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <fcntl.h>     /* O_CLOEXEC */
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <unistd.h>    /* vfork(), pipe2(), dup2(), execvp() */
+#include <sys/wait.h>  /* waitpid() */
+
+namespace proc
+{
+
+/* One stage: its argv, NULL-terminated. N counts the words, not the NULL */
+template <size_t N>
+struct Cmd
+{
+    std::array<const char *, N + 1> argv;
+};
+
+template <typename... Args>
+constexpr Cmd<1 + sizeof...(Args)> cmd(const char *program, Args... args)
+{
+    static_assert((std::is_convertible_v<Args, const char *> && ...),
+                  "cmd() takes the program and its arguments as strings");
+    /* In a constant expression this 'throw' is a compile error */
+    if (program == nullptr || program[0] == '\0')
+        throw std::invalid_argument("cmd(): empty program name");
+    return Cmd<1 + sizeof...(Args)>{{program, args..., nullptr}};
+}
+
+/* The children of a started pipeline, first stage first */
+template <size_t K>
+class Running
+{
+  public:
+    std::array<pid_t, K> pids{};
+
+    /*
+     * Wait for every stage. Returns the status of the LAST stage, as a
+     * shell reports it: the exit code, or 128 + the signal that killed it.
+     */
+    int wait()
+    {
+        int last = 0;
+        for (size_t i = 0; i < K; i++)
+        {
+            int status = 0;
+            while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR)
+                ;
+            statuses[i] = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            last = statuses[i];
+        }
+        return last;
+    }
+
+    std::array<int, K> statuses{}; /* Filled in by wait() */
+};
+
+/*
+ * K stages whose argv arrays are laid end to end in 'words' (S entries,
+ * NULLs included); stage i starts at words[start[i]].
+ */
+template <size_t K, size_t S>
+struct Pipeline
+{
+    std::array<const char *, S> words{};
+    std::array<size_t, K> start{};
+
+    /*
+     * Start every stage: the first reads 'in', the last writes 'out',
+     * each one in between reads its predecessor's output. Returns at once;
+     * wait() on the result.
+     */
+    Running<K> spawn(int in = STDIN_FILENO, int out = STDOUT_FILENO) const
+    {
+        Running<K> r;
+        int prev = in; /* What the next stage reads */
+        for (size_t i = 0; i < K; i++)
+        {
+            int p[2] = {-1, -1};
+            if (i + 1 < K && pipe2(p, O_CLOEXEC) < 0)
+                fail(r, i, prev, in, errno, "pipe2");
+            int stage_out = i + 1 < K ? p[1] : out;
+            char *const *argv = const_cast<char *const *>(&words[start[i]]);
+
+            int err;
+            pid_t pid = start_stage(argv, prev, stage_out, &err);
+            if (i + 1 < K)
+                close(p[1]); /* Only the child writes into it */
+            if (pid > 0)
+                r.pids[i] = pid;
+            if (err != 0)
+            {
+                if (i + 1 < K)
+                    close(p[0]);
+                fail(r, pid > 0 ? i + 1 : i, prev, in, err, argv[0]);
+            }
+            if (prev != in)
+                close(prev);
+            prev = p[0];
+        }
+        return r;
+    }
+
+    /* spawn() and wait(): the status of the last stage */
+    int run(int in = STDIN_FILENO, int out = STDOUT_FILENO) const { return spawn(in, out).wait(); }
+
+  private:
+    /*
+     * vfork() + exec of one stage, reading 'in' and writing 'out'. Kept
+     * apart so that nothing of the caller's is live across the vfork().
+     * Returns the pid (or -1); *err is 0, or the errno of whatever failed.
+     */
+    static pid_t start_stage(char *const *argv, int in, int out, int *err)
+    {
+        /* The child shares our memory until exec: this is how it reports failure */
+        volatile int exec_errno = 0;
+        pid_t pid = vfork();
+        if (pid == 0)
+        {
+            /* dup2() clears close-on-exec on the copy: exactly these survive */
+            if ((in != STDIN_FILENO && dup2(in, STDIN_FILENO) < 0) ||
+                (out != STDOUT_FILENO && dup2(out, STDOUT_FILENO) < 0))
+            {
+                exec_errno = errno;
+                _exit(127);
+            }
+            execvp(argv[0], argv);
+            exec_errno = errno;
+            _exit(127);
+        }
+        *err = pid < 0 ? errno : exec_errno;
+        return pid;
+    }
+
+    /* Clean up the first 'started' stages, then report 'err' */
+    [[noreturn]] static void fail(Running<K> &r, size_t started, int prev, int in, int err,
+                                  const char *what)
+    {
+        if (prev != in)
+            close(prev);
+        for (size_t i = 0; i < started; i++)
+            kill(r.pids[i], SIGKILL);
+        for (size_t i = 0; i < started; i++)
+            waitpid(r.pids[i], nullptr, 0);
+        throw std::system_error(err, std::generic_category(), what);
+    }
+};
+
+/* A single command is a pipeline of one */
+template <size_t N>
+constexpr Pipeline<1, N + 1> as_pipeline(const Cmd<N> &c)
+{
+    Pipeline<1, N + 1> p{};
+    for (size_t i = 0; i < N + 1; i++)
+        p.words[i] = c.argv[i];
+    p.start[0] = 0;
+    return p;
+}
+
+template <size_t K, size_t S, size_t N>
+constexpr Pipeline<K + 1, S + N + 1> operator|(const Pipeline<K, S> &left, const Cmd<N> &right)
+{
+    Pipeline<K + 1, S + N + 1> p{};
+    for (size_t i = 0; i < S; i++)
+        p.words[i] = left.words[i];
+    for (size_t i = 0; i < N + 1; i++)
+        p.words[S + i] = right.argv[i];
+    for (size_t i = 0; i < K; i++)
+        p.start[i] = left.start[i];
+    p.start[K] = S;
+    return p;
+}
+
+template <size_t A, size_t B>
+constexpr Pipeline<2, A + B + 2> operator|(const Cmd<A> &left, const Cmd<B> &right)
+{
+    return as_pipeline(left) | right;
+}
+
+} // namespace proc
+
+#endif /* PIPELINE_HPP */
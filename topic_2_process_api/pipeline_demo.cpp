@@ -0,0 +1,181 @@
+/*
+ * PROGRAM: pipeline_demo.cpp - Compile-time pipelines against the shell and process.hpp
+ *
+ * USAGE:
+ *     pipeline_demo                  # run a few pipelines
+ *     pipeline_demo -b count         # launch overhead, three ways
+ *
+ * KEY CONCEPT: pipeline.hpp turns "ls | wc -l" into constant data at
+ * compile time, so launching it is only pipe(), vfork(), dup2(), exec()
+ * and wait(). This program runs a few such pipelines, then (-b) measures
+ * what that saves. The same three-stage pipeline, /bin/true | /bin/true |
+ * /bin/true, is launched and waited for 'count' times:
+ *
+ *     constexpr   pipeline.hpp
+ *     builder     process.hpp: a proc::Command per stage, pipes by hand
+ *     system()    "/bin/true | /bin/true | /bin/true" handed to /bin/sh,
+ *                 which parses it and forks the stages itself
+ *
+ * For each, the time per launch and the number of operator new calls it
+ * made (this program counts them by replacing the global operator new).
+ *
+ * EXAMPLE:
+ *     ./pipeline_demo -b 2000
+ *
+ * BUILD:
+ *     g++ -std=c++17 -O2 -Wall -o pipeline_demo pipeline_demo.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "pipeline.hpp"
+#include "process.hpp"
+
+/* Count every C++ heap allocation in this program */
+static long allocations;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+/* Built by the compiler: in the binary's read-only data, nothing to do at run time */
+static constexpr auto count_sources = proc::cmd("ls", "-1") | proc::cmd("grep", "\\.c$") |
+                                      proc::cmd("wc", "-l");
+static constexpr auto biggest = proc::cmd("ls", "-S") | proc::cmd("head", "-n", "3");
+static constexpr auto three_trues =
+    proc::cmd("/bin/true") | proc::cmd("/bin/true") | proc::cmd("/bin/true");
+
+/* Uncomment for a compile error, not a run-time one:
+ * static constexpr auto broken = proc::cmd("") | proc::cmd("wc"); */
+
+static void demo()
+{
+    printf("ls -1 | grep '\\.c$' | wc -l:\n");
+    fflush(stdout); /* The children write to the same stdout */
+    int st = count_sources.run();
+    printf("exit status %d\n\n", st);
+
+    printf("ls -S | head -n 3:\n");
+    fflush(stdout);
+    proc::Running<2> r = biggest.spawn();
+    st = r.wait();
+    printf("exit status %d (ls: %d, head: %d)\n\n", st, r.statuses[0], r.statuses[1]);
+
+    try
+    {
+        (proc::cmd("ls") | proc::cmd("no-such-program")).run();
+    }
+    catch (const std::system_error &e)
+    {
+        printf("ls | no-such-program: %s\n", e.what());
+    }
+}
+
+/* The same pipeline with process.hpp: strings, vectors, a builder per stage */
+static int builder_pipeline()
+{
+    int p1[2], p2[2];
+    if (pipe2(p1, O_CLOEXEC) < 0 || pipe2(p2, O_CLOEXEC) < 0)
+        throw std::system_error(errno, std::generic_category(), "pipe2");
+    proc::Process a = proc::Command("/bin/true").dup_fd(p1[1], STDOUT_FILENO).spawn();
+    proc::Process b = proc::Command("/bin/true")
+                          .dup_fd(p1[0], STDIN_FILENO)
+                          .dup_fd(p2[1], STDOUT_FILENO)
+                          .spawn();
+    proc::Process c = proc::Command("/bin/true").dup_fd(p2[0], STDIN_FILENO).spawn();
+    close(p1[0]);
+    close(p1[1]);
+    close(p2[0]);
+    close(p2[1]);
+    a.wait();
+    b.wait();
+    return c.wait().exit_code();
+}
+
+static int system_pipeline()
+{
+    return WEXITSTATUS(system("/bin/true | /bin/true | /bin/true"));
+}
+
+static int constexpr_pipeline()
+{
+    return three_trues.run();
+}
+
+static void bench(int count)
+{
+    printf("/bin/true | /bin/true | /bin/true, %d launches each\n\n", count);
+    printf("%-10s %12s %16s\n", "how", "us/launch", "new per launch");
+    const struct
+    {
+        const char *name;
+        int (*launch)();
+    } ways[] = {{"constexpr", constexpr_pipeline},
+                {"builder", builder_pipeline},
+                {"system()", system_pipeline}};
+    for (const auto &w : ways)
+    {
+        long before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        int failed = 0;
+        for (int i = 0; i < count; i++)
+            failed += w.launch() != 0;
+        std::chrono::duration<double, std::micro> us = std::chrono::steady_clock::now() - start;
+        printf("%-10s %12.1f %16.1f%s\n", w.name, us.count() / count,
+               (double)(allocations - before) / count, failed ? "  (some failed)" : "");
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-b count]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': count = atoi(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || count < 0)
+        usage(argv[0]);
+
+    try
+    {
+        if (count > 0)
+            bench(count);
+        else
+            demo();
+    }
+    catch (const std::system_error &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
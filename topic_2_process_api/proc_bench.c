@@ -0,0 +1,600 @@
+/*
+ * CONCEPT: Process creation, measured the same way every time
+ *
+ * USAGE:
+ *     proc_bench [-s scenarios] [-n samples] [-w warmup] [-c cpu] [-k fence]
+ *                [-m parent_MB] [-S shell] [-o results.json]
+ *                [-b baseline.json] [-t percent] [-F] [-l]
+ *
+ * The examples in this directory each show one step of running a
+ * program. This harness times those steps as named SCENARIOS, so the
+ * numbers can be compared between machines, kernels and C libraries:
+ *
+ *     fork            fork() alone, as the parent sees it (the child
+ *                     exits at once and is reaped outside the timing)  fork.c
+ *     fork_wait       fork(), the child exits, the parent wait()s      fork_wait.c
+ *     fork_exec_wait  ... and the child exec()s /bin/true first        fork_wait_exec.c
+ *     redirect_exec   ... with stdout redirected to a file before      fork_exec_wait_redirect.c
+ *                     exec() (a mkstemp() file in $TMPDIR or /tmp)
+ *     shell_loop      minimal_shell running 100 "/bin/true" lines      minimal_shell.c
+ *                     from a pipe: the time per line
+ *
+ * Each scenario runs -w WARMUP samples that are thrown away (the first
+ * runs pay for page faults, cold caches, loading /bin/true into the page
+ * cache), then -n timed SAMPLES.
+ *
+ * CPU PINNING: the harness pins itself, and so every child, to one CPU
+ * (-c, default the first one it may use; -c -1 to let the scheduler
+ * choose). Otherwise a sample depends on which CPU the child happened to
+ * land on, and whether that CPU was asleep.
+ *
+ * OUTLIERS: an interrupt or another process can make one sample many
+ * times slower. Samples outside Tukey's fences,
+ *
+ *     [Q1 - k*(Q3 - Q1), Q3 + k*(Q3 - Q1)]     (Q1, Q3: the quartiles)
+ *
+ * are dropped before the mean and standard deviation are taken (-k,
+ * default 1.5; -k 0 keeps everything). The median and percentiles are
+ * robust anyway, and the number dropped is reported.
+ *
+ * RESULTS: a table on stdout and, with -o, a JSON file: a header line
+ * describing the machine, then one line per scenario, all times in
+ * microseconds:
+ *
+ *     {"format":"proc-bench","version":1,"kernel":"6.1.0","libc":"2.36",...,
+ *      "scenarios":[
+ *     {"name":"fork","samples":1000,"rejected":12,"mean_us":..,"median_us":..,...},
+ *     ...]}
+ *
+ * BASELINE: -b reads such a file from an earlier run (another kernel,
+ * another libc...) and compares MEDIANS, scenario by scenario. A median
+ * more than -t percent (default 10) slower is flagged as a REGRESSION and
+ * makes the exit status 2, so a script can stop on it.
+ *
+ * Medians are only comparable if they measured the same thing: a run
+ * with -m 1024 is slower than a -m 0 baseline without anything having
+ * regressed. So if the baseline's machine, pinned CPU, parent memory or
+ * outlier fence differ from this run's, proc_bench says which and stops
+ * before running anything; -F compares anyway.
+ *
+ * EXAMPLE:
+ *     ./proc_bench -o before.json
+ *     ... upgrade the kernel, reboot ...
+ *     ./proc_bench -b before.json -o after.json
+ *     ./proc_bench -s fork,fork_wait -m 1024 -n 200
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o proc_bench proc_bench.c -lm
+ *     gcc -O2 -Wall -o minimal_shell minimal_shell.c    (for shell_loop)
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>          /* open() for redirect_exec */
+#include <gnu/libc-version.h> /* gnu_get_libc_version() */
+#include <math.h>           /* sqrt() */
+#include <sched.h>          /* sched_setaffinity() */
+#include <signal.h>         /* signal() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>           /* clock_gettime(), time() */
+#include <unistd.h>         /* fork(), execv(), getopt() */
+#include <sys/utsname.h>    /* uname() */
+#include <sys/wait.h>       /* waitpid() */
+
+#define SHELL_LINES 100 /* Commands per shell_loop sample */
+
+struct config
+{
+    const char *program;   /* What the exec scenarios run */
+    const char *outfile;   /* Where redirect_exec sends it */
+    const char *shell;     /* The minimal_shell binary */
+};
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+/* Reap 'pid'. Returns 0 if it exited with status 0, -1 otherwise */
+static int reap(pid_t pid)
+{
+    int status;
+    if (waitpid(pid, &status, 0) < 0)
+        return -1;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/* ==========================================================================
+ * THE SCENARIOS
+ * Each one takes a single sample: its time in microseconds, or -1 if the
+ * scenario cannot run here (fork failed, the program could not be run).
+ * ========================================================================== */
+
+static double sample_fork(const struct config *cfg)
+{
+    (void)cfg;
+    double t = now_us();
+    pid_t rc = fork();
+    if (rc == 0)
+        _exit(0);
+    t = now_us() - t;
+    if (rc < 0 || reap(rc) < 0)
+        return -1;
+    return t;
+}
+
+static double sample_fork_wait(const struct config *cfg)
+{
+    (void)cfg;
+    double t = now_us();
+    pid_t rc = fork();
+    if (rc == 0)
+        _exit(0);
+    if (rc < 0 || reap(rc) < 0)
+        return -1;
+    return now_us() - t;
+}
+
+static double sample_fork_exec_wait(const struct config *cfg)
+{
+    char *argv[] = {(char *)cfg->program, NULL};
+    double t = now_us();
+    pid_t rc = fork();
+    if (rc == 0)
+    {
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    if (rc < 0 || reap(rc) < 0)
+        return -1;
+    return now_us() - t;
+}
+
+static double sample_redirect_exec(const struct config *cfg)
+{
+    char *argv[] = {(char *)cfg->program, NULL};
+    double t = now_us();
+    pid_t rc = fork();
+    if (rc == 0)
+    {
+        int fd = open(cfg->outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0)
+            _exit(127);
+        close(fd);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    if (rc < 0 || reap(rc) < 0)
+        return -1;
+    return now_us() - t;
+}
+
+static double sample_shell_loop(const struct config *cfg)
+{
+    /* The script, built once: SHELL_LINES times the program's path */
+    static char script[SHELL_LINES * 256];
+    static size_t script_len;
+    if (script_len == 0)
+    {
+        size_t len = strlen(cfg->program) + 1;
+        for (int i = 0; i < SHELL_LINES && script_len + len < sizeof(script); i++)
+            script_len += (size_t)sprintf(script + script_len, "%s\n", cfg->program);
+    }
+
+    int p[2];
+    if (pipe(p) < 0)
+        return -1;
+    double t = now_us();
+    pid_t rc = fork();
+    if (rc == 0)
+    {
+        char *argv[] = {(char *)cfg->shell, NULL};
+        int null = open("/dev/null", O_WRONLY);
+        signal(SIGPIPE, SIG_DFL); /* See main() */
+        dup2(p[0], STDIN_FILENO);
+        if (null >= 0)
+            dup2(null, STDOUT_FILENO);
+        close(p[0]);
+        close(p[1]);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    close(p[0]);
+    /* A pipe holds 64 KB: the whole script goes in without blocking */
+    ssize_t written = rc > 0 ? write(p[1], script, script_len) : -1;
+    close(p[1]);
+    if (rc < 0 || reap(rc) < 0 || written != (ssize_t)script_len)
+        return -1;
+    return (now_us() - t) / SHELL_LINES;
+}
+
+struct scenario
+{
+    const char *name;
+    double (*sample)(const struct config *);
+    const char *about;
+};
+
+static const struct scenario scenarios[] = {
+    {"fork", sample_fork, "fork() in the parent"},
+    {"fork_wait", sample_fork_wait, "fork(), child exits, wait()"},
+    {"fork_exec_wait", sample_fork_exec_wait, "fork(), exec(), wait()"},
+    {"redirect_exec", sample_redirect_exec, "fork(), open()+dup2(), exec(), wait()"},
+    {"shell_loop", sample_shell_loop, "minimal_shell, per command line"},
+};
+
+#define NSCENARIOS (int)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+/* ==========================================================================
+ * STATISTICS
+ * ========================================================================== */
+
+struct stats
+{
+    int samples;   /* Kept */
+    int rejected;  /* Outside the fences */
+    double mean, stddev, min, median, p90, p99, max;
+};
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Value at fraction p of the sorted samples */
+static double percentile(const double *sorted, int n, double p)
+{
+    int k = (int)(p * (n - 1) + 0.5);
+    return sorted[k];
+}
+
+/* Sorts 'x' (n samples) and summarises it; fence k = 0 keeps every sample */
+static struct stats summarise(double *x, int n, double k)
+{
+    struct stats s = {0};
+    qsort(x, (size_t)n, sizeof(*x), cmp_double);
+
+    /* Tukey's fences: the kept samples are a contiguous run of the sorted ones */
+    int lo = 0, hi = n;
+    if (k > 0)
+    {
+        double q1 = percentile(x, n, 0.25), q3 = percentile(x, n, 0.75);
+        while (lo < hi && x[lo] < q1 - k * (q3 - q1))
+            lo++;
+        while (hi > lo && x[hi - 1] > q3 + k * (q3 - q1))
+            hi--;
+    }
+    double *kept = x + lo;
+    s.samples = hi - lo;
+    s.rejected = n - s.samples;
+
+    double sum = 0, sq = 0;
+    for (int i = 0; i < s.samples; i++)
+        sum += kept[i];
+    s.mean = sum / s.samples;
+    for (int i = 0; i < s.samples; i++)
+        sq += (kept[i] - s.mean) * (kept[i] - s.mean);
+    s.stddev = s.samples > 1 ? sqrt(sq / (s.samples - 1)) : 0;
+    s.min = kept[0];
+    s.max = kept[s.samples - 1];
+    s.median = percentile(kept, s.samples, 0.50);
+    s.p90 = percentile(kept, s.samples, 0.90);
+    s.p99 = percentile(kept, s.samples, 0.99);
+    return s;
+}
+
+/* ==========================================================================
+ * BASELINE
+ * ========================================================================== */
+
+/*
+ * The median of scenario 'name' in a results file written by -o, or -1
+ * if it has none. The file has one scenario per line, so a line-by-line
+ * scan is all the JSON parsing it needs.
+ */
+static double baseline_median(FILE *fp, const char *name)
+{
+    char line[1024], key[64];
+    snprintf(key, sizeof(key), "\"name\":\"%s\"", name);
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        const char *m = strstr(line, "\"median_us\":");
+        if (strstr(line, key) != NULL && m != NULL)
+            return atof(m + strlen("\"median_us\":"));
+    }
+    return -1;
+}
+
+/*
+ * Copy the value of "key" in the baseline's header line (quotes removed)
+ * into buf. Returns 0, or -1 and "(missing)" in buf if the header has no
+ * such key.
+ */
+static int baseline_field(FILE *fp, const char *key, char *buf, size_t size)
+{
+    char line[1024], pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    rewind(fp);
+    const char *v = fgets(line, sizeof(line), fp) ? strstr(line, pattern) : NULL;
+    if (v == NULL)
+    {
+        snprintf(buf, size, "(missing)");
+        return -1;
+    }
+    v += strlen(pattern);
+    if (*v == '"')
+        v++;
+    size_t len = strcspn(v, "\",}");
+    snprintf(buf, size, "%.*s", (int)len, v);
+    return 0;
+}
+
+/*
+ * Say which of the settings that change the medians differ between the
+ * baseline and this run. Returns how many do.
+ */
+static int baseline_mismatches(FILE *fp, const char *machine, int cpu, long parent_mb,
+                               double fence)
+{
+    char was[128];
+    int differ = 0;
+
+    if (baseline_field(fp, "machine", was, sizeof(was)) < 0 || strcmp(was, machine) != 0)
+    {
+        printf("baseline machine %s, this run %s\n", was, machine);
+        differ++;
+    }
+    if (baseline_field(fp, "pinned_cpu", was, sizeof(was)) < 0 || atoi(was) != cpu)
+    {
+        printf("baseline pinned to cpu %s, this run to cpu %d\n", was, cpu);
+        differ++;
+    }
+    if (baseline_field(fp, "parent_mb", was, sizeof(was)) < 0 || atol(was) != parent_mb)
+    {
+        printf("baseline parent %s MB, this run %ld MB\n", was, parent_mb);
+        differ++;
+    }
+    if (baseline_field(fp, "fence", was, sizeof(was)) < 0 || atof(was) != fence)
+    {
+        printf("baseline outlier fence %s, this run %g\n", was, fence);
+        differ++;
+    }
+    return differ;
+}
+
+/* ==========================================================================
+ * MAIN
+ * ========================================================================== */
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-s scenarios] [-n samples] [-w warmup] [-c cpu] [-k fence]\n"
+            "       [-m parent_MB] [-S shell] [-o results.json] [-b baseline.json]\n"
+            "       [-t percent] [-F] [-l]\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct config cfg = {"/bin/true", NULL, "./minimal_shell"};
+    int n = 1000, warmup = 50, cpu = -2; /* -2: the first allowed CPU */
+    double fence = 1.5, threshold = 10;
+    long parent_mb = 0;
+    const char *out_path = NULL, *baseline_path = NULL;
+    int use[NSCENARIOS];
+    int force = 0;
+    int opt;
+
+    for (int i = 0; i < NSCENARIOS; i++)
+        use[i] = 1;
+    while ((opt = getopt(argc, argv, "s:n:w:c:k:m:S:o:b:t:Fl")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': n = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'c': cpu = atoi(optarg); break;
+        case 'k': fence = atof(optarg); break;
+        case 'm': parent_mb = atol(optarg); break;
+        case 'S': cfg.shell = optarg; break;
+        case 'o': out_path = optarg; break;
+        case 'b': baseline_path = optarg; break;
+        case 't': threshold = atof(optarg); break;
+        case 'F': force = 1; break;
+        case 'l':
+            for (int i = 0; i < NSCENARIOS; i++)
+                printf("%-16s %s\n", scenarios[i].name, scenarios[i].about);
+            return 0;
+        case 's':
+        {
+            memset(use, 0, sizeof(use));
+            for (char *name = strtok(optarg, ","); name; name = strtok(NULL, ","))
+            {
+                int s = 0;
+                while (s < NSCENARIOS && strcmp(name, scenarios[s].name) != 0)
+                    s++;
+                if (s == NSCENARIOS)
+                    usage(argv[0]);
+                use[s] = 1;
+            }
+            break;
+        }
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || n < 1 || warmup < 0 || fence < 0 || parent_mb < 0 || cpu < -2)
+        usage(argv[0]);
+
+    /* Pin before anything else: every child inherits the mask */
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    for (int c = 0; cpu == -2 && c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &allowed))
+            cpu = c;
+    if (cpu >= 0)
+    {
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        if (sched_setaffinity(0, sizeof(one), &one) < 0)
+        {
+            fprintf(stderr, "cannot pin to cpu %d\n", cpu);
+            return 1;
+        }
+    }
+
+    /*
+     * A shell that dies early would kill us with SIGPIPE when we write its
+     * script: get EPIPE instead, and report the scenario as failed.
+     */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Memory every fork() must share copy-on-write */
+    if (parent_mb > 0)
+    {
+        size_t size = (size_t)parent_mb << 20;
+        char *mem = malloc(size);
+        if (mem == NULL)
+        {
+            perror("malloc");
+            return 1;
+        }
+        memset(mem, 1, size);
+    }
+
+    struct utsname uts;
+    uname(&uts);
+
+    FILE *baseline = NULL;
+    if (baseline_path != NULL && (baseline = fopen(baseline_path, "r")) == NULL)
+    {
+        perror(baseline_path);
+        return 1;
+    }
+    if (baseline && baseline_mismatches(baseline, uts.machine, cpu, parent_mb, fence) > 0)
+    {
+        if (!force)
+        {
+            printf("not comparable with %s: rerun with the same settings, or -F\n",
+                   baseline_path);
+            return 1;
+        }
+        printf("comparing anyway (-F)\n\n");
+    }
+    FILE *out = NULL;
+    if (out_path != NULL && (out = fopen(out_path, "w")) == NULL)
+    {
+        perror(out_path);
+        return 1;
+    }
+
+    double *x = malloc(sizeof(*x) * (size_t)n);
+    if (x == NULL)
+    {
+        perror("malloc");
+        return 1;
+    }
+
+    /* redirect_exec's output file: a fresh name nobody else can have guessed */
+    const char *tmpdir = getenv("TMPDIR");
+    char outfile[4096];
+    snprintf(outfile, sizeof(outfile), "%s/proc_bench.XXXXXX",
+             tmpdir && *tmpdir ? tmpdir : "/tmp");
+    int tmp = mkstemp(outfile);
+    if (tmp < 0)
+    {
+        perror(outfile);
+        return 1;
+    }
+    close(tmp);
+    cfg.outfile = outfile;
+    char when[32];
+    time_t now = time(NULL);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    printf("kernel %s, glibc %s, cpu %d, parent %ld MB, %d samples after %d warmup\n\n",
+           uts.release, gnu_get_libc_version(), cpu, parent_mb, n, warmup);
+    printf("%-16s %9s %9s %9s %9s %9s %9s %8s", "scenario", "median", "mean", "stddev", "p90",
+           "p99", "min", "dropped");
+    printf(baseline ? " %10s %9s\n" : "\n", "baseline", "change");
+    printf("%-16s %9s %9s %9s %9s %9s %9s\n", "", "(us)", "(us)", "(us)", "(us)", "(us)", "(us)");
+
+    if (out)
+        fprintf(out,
+                "{\"format\":\"proc-bench\",\"version\":1,\"date\":\"%s\",\"kernel\":\"%s\","
+                "\"machine\":\"%s\",\"libc\":\"%s\",\"cpus\":%ld,\"pinned_cpu\":%d,"
+                "\"parent_mb\":%ld,\"warmup\":%d,\"fence\":%g,\"scenarios\":[",
+                when, uts.release, uts.machine, gnu_get_libc_version(),
+                sysconf(_SC_NPROCESSORS_ONLN), cpu, parent_mb, warmup, fence);
+
+    int regressions = 0, written = 0;
+    for (int s = 0; s < NSCENARIOS; s++)
+    {
+        if (!use[s])
+            continue;
+        const struct scenario *sc = &scenarios[s];
+
+        int ok = 1;
+        for (int i = 0; ok && i < warmup + n; i++)
+        {
+            double t = sc->sample(&cfg);
+            ok = t >= 0;
+            if (i >= warmup)
+                x[i - warmup] = t;
+        }
+        if (!ok)
+        {
+            printf("%-16s skipped: a sample failed%s\n", sc->name,
+                   sc->sample == sample_shell_loop ? " (build minimal_shell, or give -S)" : "");
+            continue;
+        }
+
+        struct stats st = summarise(x, n, fence);
+        printf("%-16s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8d", sc->name, st.median, st.mean,
+               st.stddev, st.p90, st.p99, st.min, st.rejected);
+        double base = baseline ? baseline_median(baseline, sc->name) : -1;
+        if (base > 0)
+        {
+            double change = 100 * (st.median - base) / base;
+            printf(" %10.1f %+8.1f%%%s", base, change, change > threshold ? "  REGRESSION" : "");
+            regressions += change > threshold;
+        }
+        else if (baseline)
+            printf(" %10s", "-");
+        printf("\n");
+        fflush(stdout);
+
+        if (out)
+            fprintf(out,
+                    "%s\n{\"name\":\"%s\",\"samples\":%d,\"rejected\":%d,\"mean_us\":%.3f,"
+                    "\"stddev_us\":%.3f,\"min_us\":%.3f,\"median_us\":%.3f,\"p90_us\":%.3f,"
+                    "\"p99_us\":%.3f,\"max_us\":%.3f}",
+                    written++ ? "," : "", sc->name, st.samples, st.rejected, st.mean, st.stddev,
+                    st.min, st.median, st.p90, st.p99, st.max);
+    }
+
+    if (out)
+    {
+        fprintf(out, "\n]}\n");
+        fclose(out);
+    }
+    if (baseline)
+        fclose(baseline);
+    unlink(cfg.outfile);
+    free(x);
+
+    if (regressions > 0)
+    {
+        printf("\n%d scenario(s) more than %.0f%% slower than the baseline\n", regressions,
+               threshold);
+        return 2;
+    }
+    return 0;
+}
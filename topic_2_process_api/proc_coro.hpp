@@ -0,0 +1,166 @@
+/*
+ * proc_coro.hpp - co_await a child's exit: one thread, thousands of children
+ *
+ * KEY CONCEPT: fork_wait.c waits for its child with wait(&status), which
+ * BLOCKS the whole thread until that child is done. To watch many
+ * children at once the classic answers are a thread per child (each one
+ * blocked in its own wait) or a hand-written state machine around
+ * SIGCHLD. C++20 coroutines give a third: code that reads like
+ * fork_wait.c but SUSPENDS at the wait instead of blocking,
+ *
+ *     proc::Task run_job(proc::EventLoop &loop)
+ *     {
+ *         proc::AsyncProcess child(loop, proc::Command("make").spawn());
+ *         proc::ExitStatus st = co_await child.exit();   <- suspends here
+ *         ...
+ *     }
+ *
+ * and one thread runs thousands of such functions, each resumed only when
+ * ITS child has exited.
+ *
+ * HOW IT WORKS:
+ * A pidfd (process.hpp) becomes READABLE when its child exits, so it can
+ * be watched like a socket. co_await child.exit() adds the pidfd to an
+ * EPOLL set, with the suspended coroutine as the event's user data, and
+ * returns to the loop. EventLoop::run() sits in epoll_wait(), and for
+ * each pidfd that fires it resumes that coroutine - which reaps the child
+ * (waitid(P_PIDFD) no longer blocks) and carries on. No signals, no
+ * SIGCHLD handler, no scan over every child to find the one that exited.
+ *
+ * A Task starts running as soon as it is called, up to its first
+ * co_await, and frees itself when it returns. run() returns once nothing
+ * is being waited for. Everything here is single-threaded: one loop, one
+ * thread.
+ *
+ * Needs C++20 and Linux 5.3+ (pidfds that work with epoll).
+ */
+
+#ifndef PROC_CORO_HPP
+#define PROC_CORO_HPP
+
+#include <coroutine>
+#include <cstdio>
+#include <exception>
+#include <sys/epoll.h> /* epoll_create1(), epoll_ctl(), epoll_wait() */
+
+#include "process.hpp"
+
+namespace proc
+{
+
+class EventLoop
+{
+  public:
+    EventLoop() : epfd_(epoll_create1(EPOLL_CLOEXEC))
+    {
+        if (epfd_ < 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_create1");
+    }
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    ~EventLoop() { close(epfd_); }
+
+    /* Resume 'h' once 'fd' is readable. One-shot: closing fd removes it */
+    void watch(int fd, std::coroutine_handle<> h)
+    {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.ptr = h.address();
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+        pending_++;
+    }
+
+    /* Until no coroutine is waiting any more */
+    void run()
+    {
+        epoll_event events[256];
+        while (pending_ > 0)
+        {
+            int n = epoll_wait(epfd_, events, 256, -1);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::generic_category(), "epoll_wait");
+            }
+            for (int i = 0; i < n; i++)
+            {
+                pending_--;
+                wakeups_++;
+                std::coroutine_handle<>::from_address(events[i].data.ptr).resume();
+            }
+        }
+    }
+
+    long pending() const { return pending_; }
+    long wakeups() const { return wakeups_; }
+
+  private:
+    int epfd_;
+    long pending_ = 0;
+    long wakeups_ = 0;
+};
+
+/*
+ * A coroutine nobody awaits: it starts at once, runs until its first
+ * co_await, and destroys itself when it finishes.
+ */
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+
+        /* Nobody is there to catch it: say what it was, then stop */
+        void unhandled_exception()
+        {
+            try
+            {
+                throw;
+            }
+            catch (const std::exception &e)
+            {
+                fprintf(stderr, "proc::Task: %s\n", e.what());
+            }
+            std::terminate();
+        }
+    };
+};
+
+/* A Process whose exit can be co_awaited on an EventLoop */
+class AsyncProcess
+{
+  public:
+    AsyncProcess(EventLoop &loop, Process &&p) : loop_(&loop), p_(std::move(p)) {}
+
+    struct ExitAwaiter
+    {
+        EventLoop *loop;
+        Process *p;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { loop->watch(p->pidfd(), h); }
+        /* The pidfd fired: the child has exited, so this wait returns at once */
+        ExitStatus await_resume() { return p->wait(); }
+    };
+
+    /* co_await child.exit() suspends until the child exits, then reaps it */
+    ExitAwaiter exit() { return ExitAwaiter{loop_, &p_}; }
+
+    Process &process() { return p_; }
+    pid_t pid() const { return p_.pid(); }
+
+  private:
+    EventLoop *loop_;
+    Process p_;
+};
+
+} // namespace proc
+
+#endif /* PROC_CORO_HPP */
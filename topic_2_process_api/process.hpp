@@ -0,0 +1,606 @@
+/*
+ * process.hpp - fork()/exec()/wait() as a C++ type that owns its child
+ *
+ * KEY CONCEPT: Every program in this directory keeps a child as a bare
+ * pid_t and has to remember, on every path, to wait() for it - or leave a
+ * ZOMBIE behind. C++ can make the compiler remember instead: a Process
+ * OWNS its child the way a std::unique_ptr owns memory.
+ *
+ *   - It is MOVE-ONLY: exactly one Process is responsible for a child.
+ *   - Its destructor REAPS the child (waits for it), unless detach() was
+ *     called to hand that job to someone else.
+ *   - It holds a PIDFD, a file descriptor that refers to this one child.
+ *     A plain pid can be reused by an unrelated process once the child is
+ *     reaped; a pidfd cannot. Signals (kill()) and waits (wait()) go
+ *     through the pidfd, so they can never hit the wrong process.
+ *
+ * SPAWNING: a Command is a builder for everything fork_exec_wait_redirect.c
+ * does by hand between fork() and exec():
+ *
+ *     proc::Process p = proc::Command("wc")
+ *                           .arg("-l")
+ *                           .stdin_from("/etc/passwd")
+ *                           .stdout_to("lines.txt")
+ *                           .cwd("/tmp")
+ *                           .env("LC_ALL", "C")
+ *                           .spawn();
+ *     proc::ExitStatus st = p.wait();
+ *
+ * The child changes to cwd() first, so relative paths in redirections
+ * are relative to THAT directory (lines.txt above is /tmp/lines.txt).
+ * Redirections are applied in the order they were added, exactly as the
+ * child would apply them after fork(); then the child execs.
+ *
+ * BACKENDS: the same Command can be started three ways.
+ *
+ *     PosixSpawn  posix_spawn() + pidfd_open(). glibc implements it with
+ *                 a vfork()-style clone: the child borrows the parent's
+ *                 memory until it execs, so nothing is copied - the
+ *                 fastest choice for a big parent.
+ *     Clone3      clone3(CLONE_PIDFD): a real fork() that returns the
+ *                 pidfd at the same moment as the pid.
+ *     Fork        fork() + pidfd_open(), the textbook way.
+ *
+ * Auto picks PosixSpawn - unless a pre_exec() hook is set: arbitrary code
+ * between fork() and exec() is exactly what posix_spawn cannot run, so
+ * then it is Clone3 (or Fork, on a kernel without clone3). The child side
+ * of Clone3 and Fork only makes async-signal-safe calls (chdir, open,
+ * dup2, close, exec), since a copy of a multi-threaded parent may find
+ * malloc's locks held by threads that no longer exist.
+ *
+ * ERRORS: spawn() throws std::system_error - including when the exec
+ * itself fails ("no such program"), which the child reports back through
+ * a close-on-exec pipe before it exits.
+ *
+ * Needs Linux 5.4+ (pidfd_open, waitid(P_PIDFD)) and C++17.
+ */
+
+#ifndef PROCESS_HPP
+#define PROCESS_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>         /* open(), O_* */
+#include <functional>
+#include <optional>
+#include <spawn.h>         /* posix_spawn() and its file actions */
+#include <string>
+#include <system_error>
+#include <unistd.h>        /* fork(), execvpe(), pipe2() */
+#include <utility>
+#include <vector>
+#include <linux/sched.h>   /* struct clone_args, CLONE_PIDFD */
+#include <sys/syscall.h>   /* SYS_clone3, SYS_pidfd_open, SYS_pidfd_send_signal */
+#include <sys/wait.h>      /* waitid() */
+
+extern char **environ;
+
+namespace proc
+{
+
+/*
+ * The pidfd calls, straight to the kernel: older glibc has no wrappers,
+ * and some versions declare them without C++ linkage.
+ */
+inline int pidfd_open(pid_t pid, unsigned flags)
+{
+    return (int)syscall(SYS_pidfd_open, pid, flags);
+}
+
+inline int pidfd_send_signal(int pidfd, int sig)
+{
+    return (int)syscall(SYS_pidfd_send_signal, pidfd, sig, nullptr, 0);
+}
+
+/* How a child ended, from waitid()'s siginfo */
+class ExitStatus
+{
+  public:
+    ExitStatus(int code, int status) : code_(code), status_(status) {}
+
+    bool exited() const { return code_ == CLD_EXITED; }
+    bool signaled() const { return code_ == CLD_KILLED || code_ == CLD_DUMPED; }
+    bool success() const { return exited() && status_ == 0; }
+    int exit_code() const { return exited() ? status_ : -1; }
+    int signal() const { return signaled() ? status_ : 0; }
+
+    std::string describe() const
+    {
+        if (exited())
+            return "exited with " + std::to_string(status_);
+        if (signaled())
+            return std::string("killed by ") + strsignal(status_) +
+                   (code_ == CLD_DUMPED ? " (core dumped)" : "");
+        return "unknown";
+    }
+
+  private:
+    int code_;   /* si_code: CLD_EXITED, CLD_KILLED, CLD_DUMPED */
+    int status_; /* si_status: exit code or signal number */
+};
+
+class Process
+{
+  public:
+    Process() = default;
+    Process(pid_t pid, int pidfd) : pid_(pid), pidfd_(pidfd) {}
+
+    Process(const Process &) = delete;
+    Process &operator=(const Process &) = delete;
+
+    Process(Process &&other) noexcept
+        : pid_(std::exchange(other.pid_, -1)), pidfd_(std::exchange(other.pidfd_, -1))
+    {
+    }
+
+    Process &operator=(Process &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reap_quietly();
+            pid_ = std::exchange(other.pid_, -1);
+            pidfd_ = std::exchange(other.pidfd_, -1);
+        }
+        return *this;
+    }
+
+    /* A child nobody waited for would stay a zombie: wait for it here */
+    ~Process() { reap_quietly(); }
+
+    pid_t pid() const { return pid_; }
+    int pidfd() const { return pidfd_; }
+
+    /* Still owns a child that has not been reaped */
+    bool joinable() const { return pidfd_ >= 0; }
+
+    /* Block until the child exits, and reap it */
+    ExitStatus wait()
+    {
+        std::optional<ExitStatus> st = wait_options(WEXITED);
+        return *st;
+    }
+
+    /* Reap the child if it has exited; std::nullopt if it is still running */
+    std::optional<ExitStatus> try_wait() { return wait_options(WEXITED | WNOHANG); }
+
+    /* Send a signal through the pidfd: never reaches a recycled pid */
+    void kill(int sig = SIGTERM)
+    {
+        if (pidfd_ < 0 || pidfd_send_signal(pidfd_, sig) < 0)
+            throw std::system_error(pidfd_ < 0 ? ECHILD : errno, std::generic_category(),
+                                    "pidfd_send_signal");
+    }
+
+    /*
+     * Give up ownership without waiting. The child is no longer reaped by
+     * us: someone else must wait() for it, or it stays a zombie until this
+     * process exits. Returns its pid.
+     */
+    pid_t detach()
+    {
+        if (pidfd_ >= 0)
+            close(pidfd_);
+        pidfd_ = -1;
+        return std::exchange(pid_, -1);
+    }
+
+  private:
+    std::optional<ExitStatus> wait_options(int options)
+    {
+        if (pidfd_ < 0)
+            throw std::system_error(ECHILD, std::generic_category(), "wait");
+        siginfo_t si;
+        std::memset(&si, 0, sizeof(si));
+        while (waitid(P_PIDFD, (id_t)pidfd_, &si, options) < 0)
+            if (errno != EINTR)
+                throw std::system_error(errno, std::generic_category(), "waitid");
+        if (si.si_pid == 0) /* WNOHANG and still running */
+            return std::nullopt;
+        close(pidfd_);
+        pidfd_ = -1;
+        return ExitStatus(si.si_code, si.si_status);
+    }
+
+    void reap_quietly() noexcept
+    {
+        if (pidfd_ < 0)
+            return;
+        siginfo_t si;
+        while (waitid(P_PIDFD, (id_t)pidfd_, &si, WEXITED) < 0 && errno == EINTR)
+            ;
+        close(pidfd_);
+        pidfd_ = -1;
+        pid_ = -1;
+    }
+
+    pid_t pid_ = -1;
+    int pidfd_ = -1;
+};
+
+enum class Backend
+{
+    Auto,
+    PosixSpawn,
+    Clone3,
+    Fork
+};
+
+inline const char *backend_name(Backend b)
+{
+    switch (b)
+    {
+    case Backend::PosixSpawn: return "posix_spawn";
+    case Backend::Clone3: return "clone3";
+    case Backend::Fork: return "fork";
+    default: return "auto";
+    }
+}
+
+class Command
+{
+  public:
+    explicit Command(std::string program) { args_.push_back(std::move(program)); }
+
+    Command &arg(std::string a)
+    {
+        args_.push_back(std::move(a));
+        return *this;
+    }
+
+    Command &args(const std::vector<std::string> &more)
+    {
+        args_.insert(args_.end(), more.begin(), more.end());
+        return *this;
+    }
+
+    /* Set (or override) one environment variable; the rest is inherited */
+    Command &env(const std::string &key, const std::string &value)
+    {
+        env_remove(key);
+        env_.push_back(key + "=" + value);
+        env_changed_ = true;
+        return *this;
+    }
+
+    Command &env_remove(const std::string &key)
+    {
+        std::string prefix = key + "=";
+        removed_.push_back(key);
+        env_.erase(std::remove_if(env_.begin(), env_.end(),
+                                  [&](const std::string &e) { return e.compare(0, prefix.size(), prefix) == 0; }),
+                   env_.end());
+        env_changed_ = true;
+        return *this;
+    }
+
+    /* Start from an empty environment */
+    Command &env_clear()
+    {
+        inherit_env_ = false;
+        env_.clear();
+        env_changed_ = true;
+        return *this;
+    }
+
+    /* In the child, before any redirection: chdir(dir) */
+    Command &cwd(std::string dir)
+    {
+        cwd_ = std::move(dir);
+        return *this;
+    }
+
+    /* In the child: dup2(from, to) */
+    Command &dup_fd(int from, int to)
+    {
+        fd_ops_.push_back({FdOp::Dup2, to, from, {}, 0, 0});
+        return *this;
+    }
+
+    /* In the child: open 'path' as descriptor 'fd' */
+    Command &open_fd(int fd, std::string path, int flags, mode_t mode = 0644)
+    {
+        fd_ops_.push_back({FdOp::Open, fd, -1, std::move(path), flags, mode});
+        return *this;
+    }
+
+    /* In the child: close(fd) */
+    Command &close_fd(int fd)
+    {
+        fd_ops_.push_back({FdOp::Close, fd, -1, {}, 0, 0});
+        return *this;
+    }
+
+    Command &stdin_from(std::string path)
+    {
+        return open_fd(STDIN_FILENO, std::move(path), O_RDONLY);
+    }
+
+    /* Like the shell's '>': create or truncate */
+    Command &stdout_to(std::string path)
+    {
+        return open_fd(STDOUT_FILENO, std::move(path), O_WRONLY | O_CREAT | O_TRUNC);
+    }
+
+    Command &stderr_to(std::string path)
+    {
+        return open_fd(STDERR_FILENO, std::move(path), O_WRONLY | O_CREAT | O_TRUNC);
+    }
+
+    /* Put the child in a process group of its own (setpgid(0, 0)) */
+    Command &new_process_group()
+    {
+        new_pgroup_ = true;
+        return *this;
+    }
+
+    /*
+     * Run 'hook' in the child after fork(), before the redirections and
+     * exec(). Only async-signal-safe calls belong here. A hook rules out
+     * posix_spawn.
+     */
+    Command &pre_exec(std::function<void()> hook)
+    {
+        pre_exec_ = std::move(hook);
+        return *this;
+    }
+
+    Command &backend(Backend b)
+    {
+        backend_ = b;
+        return *this;
+    }
+
+    /* Which backend spawn() will really use */
+    Backend resolved_backend() const
+    {
+        if (backend_ != Backend::Auto)
+            return backend_;
+        return pre_exec_ ? Backend::Clone3 : Backend::PosixSpawn;
+    }
+
+    Process spawn() const
+    {
+        /* Everything the child needs is built here, before it exists */
+        std::vector<char *> argv = pointers(args_);
+        std::vector<std::string> env_strings;
+        std::vector<char *> envp;
+        char **envp_ptr = environ;
+        if (env_changed_)
+        {
+            env_strings = merged_env();
+            envp = pointers(env_strings);
+            envp_ptr = envp.data();
+        }
+
+        Backend b = resolved_backend();
+        if (b == Backend::PosixSpawn)
+        {
+            if (pre_exec_)
+                throw std::system_error(EINVAL, std::generic_category(),
+                                        "posix_spawn cannot run a pre_exec hook");
+            return spawn_posix(argv.data(), envp_ptr);
+        }
+        return spawn_fork(b, argv.data(), envp_ptr);
+    }
+
+  private:
+    struct FdOp
+    {
+        enum Kind
+        {
+            Dup2,
+            Open,
+            Close
+        } kind;
+        int fd;           /* Target descriptor */
+        int src;          /* Dup2: source descriptor */
+        std::string path; /* Open */
+        int flags;
+        mode_t mode;
+    };
+
+    static std::vector<char *> pointers(const std::vector<std::string> &strings)
+    {
+        std::vector<char *> v;
+        v.reserve(strings.size() + 1);
+        for (const std::string &s : strings)
+            v.push_back(const_cast<char *>(s.c_str()));
+        v.push_back(nullptr);
+        return v;
+    }
+
+    std::vector<std::string> merged_env() const
+    {
+        std::vector<std::string> out;
+        if (inherit_env_)
+        {
+            for (char **e = environ; *e; e++)
+            {
+                std::string entry(*e);
+                bool drop = false;
+                for (const std::string &key : removed_)
+                    drop = drop || entry.compare(0, key.size() + 1, key + "=") == 0;
+                if (!drop)
+                    out.push_back(std::move(entry));
+            }
+        }
+        out.insert(out.end(), env_.begin(), env_.end());
+        return out;
+    }
+
+    Process spawn_posix(char **argv, char **envp) const
+    {
+        posix_spawn_file_actions_t fa;
+        posix_spawnattr_t attr;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawnattr_init(&attr);
+
+        /* Same clean slate as the fork() path: no inherited blocked signals */
+        sigset_t none;
+        sigemptyset(&none);
+        posix_spawnattr_setsigmask(&attr, &none);
+        short flags = POSIX_SPAWN_SETSIGMASK;
+        if (new_pgroup_)
+        {
+            flags |= POSIX_SPAWN_SETPGROUP;
+            posix_spawnattr_setpgroup(&attr, 0);
+        }
+        posix_spawnattr_setflags(&attr, flags);
+
+        if (!cwd_.empty())
+            posix_spawn_file_actions_addchdir_np(&fa, cwd_.c_str());
+        for (const FdOp &op : fd_ops_)
+        {
+            if (op.kind == FdOp::Dup2)
+                posix_spawn_file_actions_adddup2(&fa, op.src, op.fd);
+            else if (op.kind == FdOp::Open)
+                posix_spawn_file_actions_addopen(&fa, op.fd, op.path.c_str(), op.flags, op.mode);
+            else
+                posix_spawn_file_actions_addclose(&fa, op.fd);
+        }
+
+        pid_t pid;
+        int err = posix_spawnp(&pid, argv[0], &fa, &attr, argv, envp);
+        posix_spawn_file_actions_destroy(&fa);
+        posix_spawnattr_destroy(&attr);
+        if (err != 0)
+            throw std::system_error(err, std::generic_category(), std::string("spawn ") + argv[0]);
+        return adopt(pid);
+    }
+
+    /* Wrap a child we just created; it cannot be reaped yet, so its pid is still its own */
+    static Process adopt(pid_t pid)
+    {
+        int pidfd = pidfd_open(pid, 0);
+        if (pidfd < 0)
+        {
+            int err = errno;
+            waitpid(pid, nullptr, 0);
+            throw std::system_error(err, std::generic_category(), "pidfd_open");
+        }
+        return Process(pid, pidfd);
+    }
+
+    /* The child half of the Fork and Clone3 backends. Never returns */
+    [[noreturn]] void child(char **argv, char **envp, int err_pipe) const
+    {
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        if (new_pgroup_)
+            setpgid(0, 0);
+        if (pre_exec_)
+            pre_exec_();
+        if (!cwd_.empty() && chdir(cwd_.c_str()) < 0)
+            child_fail(err_pipe);
+        for (const FdOp &op : fd_ops_)
+        {
+            if (op.kind == FdOp::Dup2)
+            {
+                if (dup2(op.src, op.fd) < 0)
+                    child_fail(err_pipe);
+            }
+            else if (op.kind == FdOp::Open)
+            {
+                int fd = open(op.path.c_str(), op.flags, op.mode);
+                if (fd < 0)
+                    child_fail(err_pipe);
+                if (fd != op.fd)
+                {
+                    if (dup2(fd, op.fd) < 0)
+                        child_fail(err_pipe);
+                    close(fd);
+                }
+            }
+            else
+            {
+                close(op.fd);
+            }
+        }
+        execvpe(argv[0], argv, envp);
+        child_fail(err_pipe);
+    }
+
+    /* Tell the parent what went wrong: errno down the close-on-exec pipe */
+    [[noreturn]] static void child_fail(int err_pipe)
+    {
+        int err = errno;
+        ssize_t n = write(err_pipe, &err, sizeof(err));
+        (void)n;
+        _exit(127);
+    }
+
+    Process spawn_fork(Backend b, char **argv, char **envp) const
+    {
+        /*
+         * The pipe closes itself when the child execs. So the parent reads
+         * either EOF (exec worked) or an errno (it did not).
+         */
+        int err_pipe[2];
+        if (pipe2(err_pipe, O_CLOEXEC) < 0)
+            throw std::system_error(errno, std::generic_category(), "pipe2");
+
+        pid_t pid = -1;
+        int pidfd = -1;
+        if (b == Backend::Clone3)
+        {
+            struct clone_args args;
+            std::memset(&args, 0, sizeof(args));
+            args.flags = CLONE_PIDFD;
+            args.pidfd = (uint64_t)(uintptr_t)&pidfd;
+            args.exit_signal = SIGCHLD;
+            pid = (pid_t)syscall(SYS_clone3, &args, sizeof(args));
+            if (pid < 0 && errno == ENOSYS)
+                b = Backend::Fork; /* Kernel older than 5.3 */
+        }
+        if (b == Backend::Fork)
+            pid = fork();
+
+        if (pid < 0)
+        {
+            int err = errno;
+            close(err_pipe[0]);
+            close(err_pipe[1]);
+            throw std::system_error(err, std::generic_category(), backend_name(b));
+        }
+        if (pid == 0)
+        {
+            close(err_pipe[0]);
+            child(argv, envp, err_pipe[1]);
+        }
+
+        close(err_pipe[1]);
+        int child_errno = 0;
+        ssize_t n;
+        while ((n = read(err_pipe[0], &child_errno, sizeof(child_errno))) < 0 && errno == EINTR)
+            ;
+        close(err_pipe[0]);
+        if (n == (ssize_t)sizeof(child_errno))
+        {
+            if (pidfd >= 0)
+                close(pidfd);
+            waitpid(pid, nullptr, 0);
+            throw std::system_error(child_errno, std::generic_category(),
+                                    std::string("exec ") + argv[0]);
+        }
+        return pidfd >= 0 ? Process(pid, pidfd) : adopt(pid);
+    }
+
+    std::vector<std::string> args_;
+    std::vector<std::string> env_;     /* Added or overridden "KEY=value" */
+    std::vector<std::string> removed_; /* Keys not to inherit */
+    bool inherit_env_ = true;
+    bool env_changed_ = false;
+    std::string cwd_;
+    std::vector<FdOp> fd_ops_;
+    bool new_pgroup_ = false;
+    std::function<void()> pre_exec_;
+    Backend backend_ = Backend::Auto;
+};
+
+} // namespace proc
+
+#endif /* PROCESS_HPP */
@@ -0,0 +1,292 @@
+/*
+ * PROGRAM: ring_bench.c - A child streams results to its parent: shared ring vs pipe
+ *
+ * USAGE:
+ *     ring_bench [-s sizes] [-t total_mb] [-m max_msgs] [-r ring_kb] [-B batch] [-c cpu]
+ *
+ * KEY CONCEPT: A pipe costs a system call per write() and per read(), and
+ * copies every byte twice (into the kernel, then out again). The ring of
+ * spsc_ring.h lives in memory that parent and child share after fork():
+ * the child writes a message where the parent will read it, and the only
+ * system calls are the futex sleeps and wakeups when one side has to
+ * wait for the other.
+ *
+ * For every message size (default 8 B to 64 KB) the CHILD produces
+ * messages - each starting with its sequence number - and the PARENT
+ * consumes and checks them, once through the ring and once through a
+ * pipe. Reported per run:
+ *
+ *     msgs/s, MB/s          throughput, fork() to last message read
+ *     syscalls/msg          pipe: the parent's read()s plus the child's
+ *                           write()s; ring: every FUTEX_WAIT and
+ *                           FUTEX_WAKE on both sides
+ *
+ * Each size sends 'total_mb' megabytes (default 256) or 'max_msgs'
+ * messages (default 1M), whichever is fewer. -c pins both processes to
+ * one CPU; without it they may run in parallel.
+ *
+ * EXAMPLE:
+ *     ./ring_bench
+ *     ./ring_bench -s 64,4096 -B 1 -c 0    # publish every message, one CPU
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o ring_bench ring_bench.c
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>    /* sched_setaffinity() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>     /* clock_gettime() */
+#include <unistd.h>   /* fork(), pipe(), getopt() */
+#include <sys/wait.h> /* waitpid() */
+
+#include "spsc_ring.h"
+
+#define MAX_SIZES 32
+
+struct result
+{
+    double seconds;
+    double syscalls;
+    int ok;             /* Every message arrived, in order */
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The payload of message 'seq': its number, then filler */
+static void fill(unsigned char *buf, size_t size, uint64_t seq)
+{
+    if (size >= sizeof(seq))
+        memcpy(buf, &seq, sizeof(seq));
+}
+
+static int check(const unsigned char *buf, size_t size, uint64_t seq)
+{
+    uint64_t got = seq;
+    if (size >= sizeof(got))
+        memcpy(&got, buf, sizeof(got));
+    return got == seq;
+}
+
+static struct result run_ring(size_t size, long count, uint64_t ring_bytes, unsigned batch)
+{
+    struct result res = {0, 0, 1};
+    struct spsc_ring *r = spsc_ring_create(ring_bytes);
+    if (r == NULL)
+        exit(1);
+
+    double start = now_seconds();
+    pid_t rc = fork();
+    if (rc < 0)
+    {
+        perror("fork");
+        exit(1);
+    }
+    if (rc == 0)
+    {
+        /* CHILD: the producer. Writes straight into the shared ring */
+        struct spsc_producer p;
+        spsc_producer_init(&p, r, batch);
+        for (long i = 0; i < count; i++)
+        {
+            unsigned char *dst = spsc_reserve(&p, (uint32_t)size);
+            fill(dst, size, (uint64_t)i);
+            spsc_commit(&p);
+        }
+        spsc_close(&p);
+        _exit(0);
+    }
+
+    /* PARENT: the consumer. Reads the messages where they lie */
+    struct spsc_consumer c;
+    spsc_consumer_init(&c, r);
+    const unsigned char *msg;
+    uint32_t len;
+    long seen = 0;
+    while ((msg = spsc_peek(&c, &len)) != NULL)
+    {
+        if (len != size || !check(msg, size, (uint64_t)seen))
+            res.ok = 0;
+        seen++;
+        spsc_release(&c);
+    }
+    waitpid(rc, NULL, 0);
+    res.seconds = now_seconds() - start;
+    if (seen != count)
+        res.ok = 0;
+    res.syscalls = (double)(r->prod_sleeps + r->prod_wakes + r->cons_sleeps + r->cons_wakes);
+    spsc_ring_destroy(r);
+    return res;
+}
+
+/* read() exactly 'size' bytes; returns the number of read() calls, or -1 at EOF */
+static long read_full(int fd, unsigned char *buf, size_t size)
+{
+    long calls = 0;
+    size_t got = 0;
+    while (got < size)
+    {
+        ssize_t n = read(fd, buf + got, size - got);
+        calls++;
+        if (n <= 0)
+            return -1;
+        got += (size_t)n;
+    }
+    return calls;
+}
+
+static struct result run_pipe(size_t size, long count)
+{
+    struct result res = {0, 0, 1};
+    int fd[2];
+    /* The child's write() count comes back through this ring-less shared word */
+    long *child_calls = mmap(NULL, sizeof(long), PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    unsigned char *buf = malloc(size);
+    if (pipe(fd) < 0 || child_calls == MAP_FAILED || buf == NULL)
+    {
+        perror("pipe");
+        exit(1);
+    }
+
+    double start = now_seconds();
+    pid_t rc = fork();
+    if (rc < 0)
+    {
+        perror("fork");
+        exit(1);
+    }
+    if (rc == 0)
+    {
+        /* CHILD: one write() per message (more if the pipe takes less) */
+        close(fd[0]);
+        long calls = 0;
+        for (long i = 0; i < count; i++)
+        {
+            fill(buf, size, (uint64_t)i);
+            size_t put = 0;
+            while (put < size)
+            {
+                ssize_t n = write(fd[1], buf + put, size - put);
+                calls++;
+                if (n <= 0)
+                    _exit(1);
+                put += (size_t)n;
+            }
+        }
+        *child_calls = calls;
+        _exit(0);
+    }
+
+    close(fd[1]);
+    long calls = 0, seen = 0, n;
+    while ((n = read_full(fd[0], buf, size)) > 0)
+    {
+        if (!check(buf, size, (uint64_t)seen))
+            res.ok = 0;
+        calls += n;
+        seen++;
+    }
+    close(fd[0]);
+    waitpid(rc, NULL, 0);
+    res.seconds = now_seconds() - start;
+    if (seen != count)
+        res.ok = 0;
+    res.syscalls = (double)(calls + 1 + *child_calls); /* +1: the read() that saw EOF */
+    munmap(child_calls, sizeof(long));
+    free(buf);
+    return res;
+}
+
+static void report(const char *how, size_t size, long count, struct result res)
+{
+    printf("%-5s %8zu %9ld %12.0f %10.1f %14.3f%s\n", how, size, count, count / res.seconds,
+           (double)size * (double)count / res.seconds / 1e6, res.syscalls / (double)count,
+           res.ok ? "" : "  CORRUPT");
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-s sizes] [-t total_mb] [-m max_msgs] [-r ring_kb] [-B batch]"
+                    " [-c cpu]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t sizes[MAX_SIZES] = {8, 64, 512, 4096, 65536};
+    int nsizes = 5;
+    double total_mb = 256;
+    long max_msgs = 1000000;
+    long ring_kb = 1024;
+    unsigned batch = 32;
+    int cpu = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:t:m:r:B:c:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            nsizes = 0;
+            for (char *tok = strtok(optarg, ","); tok && nsizes < MAX_SIZES; tok = strtok(NULL, ","))
+                sizes[nsizes++] = (size_t)atol(tok);
+            break;
+        case 't': total_mb = atof(optarg); break;
+        case 'm': max_msgs = atol(optarg); break;
+        case 'r': ring_kb = atol(optarg); break;
+        case 'B': batch = (unsigned)atoi(optarg); break;
+        case 'c': cpu = atoi(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || nsizes == 0 || total_mb <= 0 || max_msgs < 1 || ring_kb < 4)
+        usage(argv[0]);
+    for (int i = 0; i < nsizes; i++)
+    {
+        if (sizes[i] == 0 || sizes[i] * 2 + 16 > (size_t)ring_kb * 1024)
+        {
+            fprintf(stderr, "size %zu does not fit a %ld KB ring (max: half of it)\n", sizes[i],
+                    ring_kb);
+            return 1;
+        }
+    }
+
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0)
+        {
+            perror("sched_setaffinity");
+            return 1;
+        }
+    }
+
+    printf("ring %ld KB, publish every %u messages%s\n\n", ring_kb, batch,
+           cpu >= 0 ? ", both processes on one CPU" : "");
+    printf("%-5s %8s %9s %12s %10s %14s\n", "how", "size", "msgs", "msgs/s", "MB/s",
+           "syscalls/msg");
+    for (int i = 0; i < nsizes; i++)
+    {
+        long count = (long)(total_mb * 1e6 / (double)sizes[i]);
+        if (count > max_msgs)
+            count = max_msgs;
+        if (count < 1)
+            count = 1;
+        report("ring", sizes[i], count,
+               run_ring(sizes[i], count, (uint64_t)ring_kb * 1024, batch));
+        fflush(stdout);
+        report("pipe", sizes[i], count, run_pipe(sizes[i], count));
+        fflush(stdout);
+    }
+    return 0;
+}
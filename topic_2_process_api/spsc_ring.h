@@ -0,0 +1,369 @@
+/*
+ * spsc_ring.h - A shared-memory message ring from one process to another
+ *
+ * KEY CONCEPT: fork() gives the child a COPY of the parent's memory - a
+ * variable the child changes stays changed only in the child (fork.c).
+ * Memory mapped with MAP_SHARED | MAP_ANONYMOUS before fork() is the
+ * exception: after fork() both processes see the SAME physical pages, so
+ * a store by one is a load away for the other - no system call.
+ *
+ * This header builds a SINGLE-PRODUCER / SINGLE-CONSUMER ring on such a
+ * region: one process appends variable-size messages, one other process
+ * reads them in order.
+ *
+ *     struct spsc_ring *r = spsc_ring_create(1 << 20);   before fork()
+ *
+ *     child (producer)                     parent (consumer)
+ *     struct spsc_producer p;              struct spsc_consumer c;
+ *     spsc_producer_init(&p, r, 32);       spsc_consumer_init(&c, r);
+ *     spsc_push(&p, msg, len);             while ((m = spsc_peek(&c, &len)))
+ *     ...                                  {
+ *     spsc_close(&p);                          use(m, len);
+ *                                              spsc_release(&c);
+ *                                          }
+ *
+ * HOW IT WORKS:
+ * Two counters that only ever grow: HEAD, the bytes written so far, and
+ * TAIL, the bytes read so far. head - tail bytes are waiting in the ring;
+ * a counter modulo the capacity is a position in it. Only the producer
+ * writes head and only the consumer writes tail, so no locks are needed,
+ * just the right memory ordering: the producer copies the message BEFORE
+ * it publishes the new head (release), and the consumer reads head
+ * (acquire) BEFORE it reads the message.
+ *
+ * The two counters sit on different 64-byte CACHE LINES. If they shared
+ * one, every write by one side would steal the line from the other
+ * ("false sharing"), even though neither touches the other's counter.
+ *
+ * BATCHING: each side keeps its own position in process-private memory
+ * and publishes it only now and then - the producer every 'batch'
+ * messages (or when it must wait, or on spsc_flush()), the consumer
+ * every eighth of the ring. Each side also caches the last value it saw
+ * of the other's counter and rereads it only when the cache says "full"
+ * or "empty". Most messages touch no shared cache line at all besides
+ * the data.
+ *
+ * SLEEPING: a consumer that finds the ring empty does not spin forever.
+ * It raises a flag and sleeps with FUTEX_WAIT; a producer that publishes
+ * and sees the flag wakes it with FUTEX_WAKE. A full ring makes the
+ * producer sleep the same way. While data flows, neither side makes a
+ * system call.
+ *
+ * Each message is stored as an 8-byte header (its length) plus the data,
+ * padded to 8 bytes. A message never wraps around the end of the ring: if
+ * it does not fit in what is left, a PADDING record fills the rest and
+ * the message starts over at position 0. A message may be at most half
+ * the ring.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <linux/futex.h>  /* FUTEX_WAIT, FUTEX_WAKE */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>     /* mmap() */
+#include <sys/syscall.h>  /* SYS_futex */
+
+#define SPSC_CACHE_LINE 64
+#define SPSC_PAD        UINT32_MAX /* Length of a padding record */
+
+struct spsc_ring
+{
+    /* Read-only after creation */
+    _Alignas(SPSC_CACHE_LINE) uint64_t capacity; /* Bytes of data[], a power of two */
+
+    /* Written by the producer only */
+    _Alignas(SPSC_CACHE_LINE) uint64_t head;
+    uint32_t head_seq;          /* Futex the consumer sleeps on */
+    uint32_t prod_waiting;      /* Producer is (about to be) asleep: ring full */
+    uint32_t closed;            /* No more messages will come */
+    uint64_t prod_sleeps;       /* Statistics: FUTEX_WAITs ... */
+    uint64_t prod_wakes;        /* ... and FUTEX_WAKEs by the producer */
+
+    /* Written by the consumer only */
+    _Alignas(SPSC_CACHE_LINE) uint64_t tail;
+    uint32_t tail_seq;          /* Futex the producer sleeps on */
+    uint32_t cons_waiting;      /* Consumer is (about to be) asleep: ring empty */
+    uint64_t cons_sleeps;
+    uint64_t cons_wakes;
+
+    _Alignas(SPSC_CACHE_LINE) unsigned char data[];
+};
+
+/* Each side's private state: lives in its own process, never shared */
+struct spsc_producer
+{
+    struct spsc_ring *r;
+    uint64_t head;              /* Next byte to write */
+    uint64_t tail_cache;        /* Last tail we read from the ring */
+    unsigned batch, pending;    /* Publish every 'batch' messages */
+    uint64_t need;              /* Size of the record being written */
+};
+
+struct spsc_consumer
+{
+    struct spsc_ring *r;
+    uint64_t tail;              /* Next byte to read */
+    uint64_t head_cache;        /* Last head we read from the ring */
+    uint64_t published;         /* Tail as the producer last saw it */
+    uint64_t need;              /* Size of the record being read */
+};
+
+/* How long to spin before sleeping: a wakeup costs microseconds */
+#define SPSC_SPINS 100
+
+static inline long spsc_futex(uint32_t *addr, int op, uint32_t val)
+{
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+static inline uint64_t spsc_record_size(uint32_t len)
+{
+    return 8 + (((uint64_t)len + 7) & ~(uint64_t)7);
+}
+
+/*
+ * Map a ring with 'capacity' data bytes (rounded up to a power of two).
+ * Call it BEFORE fork(): the mapping is inherited and stays shared.
+ * Returns NULL on failure.
+ */
+static inline struct spsc_ring *spsc_ring_create(uint64_t capacity)
+{
+    uint64_t cap = 4096;
+    while (cap < capacity)
+        cap *= 2;
+    struct spsc_ring *r = mmap(NULL, sizeof(*r) + cap, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (r == MAP_FAILED)
+    {
+        perror("mmap");
+        return NULL;
+    }
+    /* Fresh anonymous pages are zero: only the capacity to set */
+    r->capacity = cap;
+    return r;
+}
+
+static inline void spsc_ring_destroy(struct spsc_ring *r)
+{
+    munmap(r, sizeof(*r) + r->capacity);
+}
+
+/*
+ * Wait until *counter differs from 'old'. The flag + recheck + futex
+ * dance closes the race with a wakeup that happens just as we fall
+ * asleep: the other side either sees our flag (and wakes us) or we see
+ * its new value (and do not sleep). FUTEX_WAIT itself refuses to sleep if
+ * *seq has changed since we read it.
+ */
+static inline void spsc_wait(uint64_t *counter, uint64_t old, uint32_t *seq, uint32_t *waiting,
+                             const uint32_t *closed, uint64_t *sleeps)
+{
+    for (int i = 0; i < SPSC_SPINS; i++)
+        if (__atomic_load_n(counter, __ATOMIC_ACQUIRE) != old ||
+            (closed && __atomic_load_n(closed, __ATOMIC_ACQUIRE)))
+            return;
+
+    for (;;)
+    {
+        uint32_t s = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(counter, __ATOMIC_SEQ_CST) != old ||
+            (closed && __atomic_load_n(closed, __ATOMIC_SEQ_CST)))
+            break;
+        (*sleeps)++;
+        spsc_futex(seq, FUTEX_WAIT, s);
+    }
+    __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+}
+
+/* Publish a new value of our counter and wake the other side if it sleeps */
+static inline void spsc_post(uint64_t *counter, uint64_t value, uint32_t *seq,
+                             uint32_t *waiting, uint64_t *wakes)
+{
+    __atomic_store_n(counter, value, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+    {
+        __atomic_fetch_add(seq, 1, __ATOMIC_SEQ_CST);
+        spsc_futex(seq, FUTEX_WAKE, 1);
+        (*wakes)++;
+    }
+}
+
+/* ---------------------------------------------------------------- producer */
+
+static inline void spsc_producer_init(struct spsc_producer *p, struct spsc_ring *r,
+                                      unsigned batch)
+{
+    memset(p, 0, sizeof(*p));
+    p->r = r;
+    p->head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    p->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    p->batch = batch ? batch : 1;
+}
+
+/* Make every message written so far visible to the consumer */
+static inline void spsc_flush(struct spsc_producer *p)
+{
+    struct spsc_ring *r = p->r;
+    p->pending = 0;
+    spsc_post(&r->head, p->head, &r->head_seq, &r->cons_waiting, &r->prod_wakes);
+}
+
+/* Wait until 'bytes' are free after head */
+static inline void spsc_wait_space(struct spsc_producer *p, uint64_t bytes)
+{
+    struct spsc_ring *r = p->r;
+    while (r->capacity - (p->head - p->tail_cache) < bytes)
+    {
+        uint64_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (tail == p->tail_cache)
+        {
+            /* Full. The consumer may be waiting for what we have not published */
+            spsc_flush(p);
+            spsc_wait(&r->tail, tail, &r->tail_seq, &r->prod_waiting, NULL, &r->prod_sleeps);
+            tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        }
+        p->tail_cache = tail;
+    }
+}
+
+/*
+ * Reserve room for a 'len'-byte message and return where to write it.
+ * Finish with spsc_commit(). Returns NULL if len is more than half the
+ * ring.
+ */
+static inline void *spsc_reserve(struct spsc_producer *p, uint32_t len)
+{
+    struct spsc_ring *r = p->r;
+    uint64_t need = spsc_record_size(len);
+    if (len == SPSC_PAD || need > r->capacity / 2)
+        return NULL;
+
+    uint64_t off = p->head & (r->capacity - 1);
+    uint64_t room = r->capacity - off; /* Before the end of the ring */
+    spsc_wait_space(p, need > room ? room + need : need);
+    if (need > room)
+    {
+        *(uint32_t *)(r->data + off) = SPSC_PAD;
+        p->head += room;
+        off = 0;
+    }
+    *(uint32_t *)(r->data + off) = len;
+    p->need = need;
+    return r->data + off + 8;
+}
+
+static inline void spsc_commit(struct spsc_producer *p)
+{
+    p->head += p->need;
+    if (++p->pending >= p->batch)
+        spsc_flush(p);
+}
+
+/* Copy one message in. Returns 0, or -1 if it is too big for the ring */
+static inline int spsc_push(struct spsc_producer *p, const void *msg, uint32_t len)
+{
+    void *dst = spsc_reserve(p, len);
+    if (dst == NULL)
+        return -1;
+    memcpy(dst, msg, len);
+    spsc_commit(p);
+    return 0;
+}
+
+/* Publish what is left and tell the consumer nothing more will come */
+static inline void spsc_close(struct spsc_producer *p)
+{
+    struct spsc_ring *r = p->r;
+    spsc_flush(p);
+    __atomic_store_n(&r->closed, 1, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&r->head_seq, 1, __ATOMIC_SEQ_CST);
+    spsc_futex(&r->head_seq, FUTEX_WAKE, 1);
+}
+
+/* ---------------------------------------------------------------- consumer */
+
+static inline void spsc_consumer_init(struct spsc_consumer *c, struct spsc_ring *r)
+{
+    memset(c, 0, sizeof(*c));
+    c->r = r;
+    c->tail = c->published = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    c->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+}
+
+/* Hand the space we have read back to the producer */
+static inline void spsc_consumer_flush(struct spsc_consumer *c)
+{
+    struct spsc_ring *r = c->r;
+    c->published = c->tail;
+    spsc_post(&r->tail, c->tail, &r->tail_seq, &r->prod_waiting, &r->cons_wakes);
+}
+
+/*
+ * Wait for the next message and return a pointer to it, its length in
+ * *len. The message stays valid until spsc_release(). Returns NULL once
+ * the producer has closed the ring and everything has been read.
+ */
+static inline const void *spsc_peek(struct spsc_consumer *c, uint32_t *len)
+{
+    struct spsc_ring *r = c->r;
+    for (;;)
+    {
+        if (c->tail == c->head_cache)
+        {
+            c->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+            if (c->tail == c->head_cache)
+            {
+                if (c->published != c->tail)
+                    spsc_consumer_flush(c);
+                if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE))
+                {
+                    /* closed is set after the last head: one final look */
+                    c->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+                    if (c->tail == c->head_cache)
+                        return NULL;
+                    continue;
+                }
+                spsc_wait(&r->head, c->tail, &r->head_seq, &r->cons_waiting, &r->closed,
+                          &r->cons_sleeps);
+                continue;
+            }
+        }
+
+        uint64_t off = c->tail & (r->capacity - 1);
+        uint32_t n = *(const uint32_t *)(r->data + off);
+        if (n == SPSC_PAD)
+        {
+            c->tail += r->capacity - off;
+            continue;
+        }
+        *len = n;
+        c->need = spsc_record_size(n);
+        return r->data + off + 8;
+    }
+}
+
+static inline void spsc_release(struct spsc_consumer *c)
+{
+    c->tail += c->need;
+    if (c->tail - c->published >= c->r->capacity / 8)
+        spsc_consumer_flush(c);
+}
+
+/* Copy the next message into buf (up to size bytes). Returns its length, or -1 at the end */
+static inline long spsc_pop(struct spsc_consumer *c, void *buf, uint32_t size)
+{
+    uint32_t len;
+    const void *msg = spsc_peek(c, &len);
+    if (msg == NULL)
+        return -1;
+    memcpy(buf, msg, len < size ? len : size);
+    spsc_release(c);
+    return len;
+}
+
+#endif /* SPSC_RING_H */
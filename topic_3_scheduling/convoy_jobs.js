@@ -0,0 +1,9 @@
+// The workload from fifo-convoy-effect.html, ready for trace_convert:
+//     ./trace_convert jobs convoy_jobs.js convoy.bin
+const JOBS = [
+  { name: 'A', burst: 80, color: '#D95534' },
+  { name: 'B', burst: 15, color: '#2E7DB3' },
+  { name: 'C', burst:  5, color: '#3A9E3F' },
+  { name: 'D', burst: 25, color: '#8B5CF6' },
+  { name: 'E', burst: 10, color: '#D97706' }
+];
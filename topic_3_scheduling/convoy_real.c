@@ -0,0 +1,362 @@
+/*
+ * PROGRAM: convoy_real.c - The convoy effect with real processes
+ *
+ * USAGE:
+ *     convoy_real [-s ms_per_unit] [-c cpu] [-m modes] [-r repeats] [burst ...]
+ *
+ * fifo-convoy-effect.html computes, by hand, that SJF turns the convoy
+ * (bursts 80, 15, 5, 25, 10) around 2.2x faster than FIFO. This program
+ * checks that claim against the real kernel. It forks one CPU-burning
+ * child per job - the fork()/wait() pattern from fork_wait.c - and runs
+ * the batch several ways:
+ *
+ *     fifo   one child at a time, in arrival order (A, B, C, D, E)
+ *     sjf    one child at a time, shortest burst first (C, E, B, D, A)
+ *     cfs    all children at once under SCHED_OTHER: the kernel decides
+ *     batch  all at once under SCHED_BATCH (no wakeup preemption)
+ *     idle   all at once under SCHED_IDLE (lowest possible weight)
+ *
+ * Everything is pinned to ONE CPU, like the single CPU of the demo;
+ * otherwise the children would simply run in parallel and there would be
+ * no queue at all. A burst of 1 unit is 'ms_per_unit' milliseconds of CPU
+ * time (default 10), measured with CLOCK_PROCESS_CPUTIME_ID so that time
+ * spent waiting for the CPU does not count as work.
+ *
+ * WHAT IS MEASURED:
+ * Every job "arrives" at t = 0, the moment the batch is released. Each
+ * child writes the time it starts running and the time it finishes into a
+ * shared page (mmap MAP_SHARED, set up before fork()), so we get
+ *     response   = first time on the CPU - 0
+ *     turnaround = completion time - 0
+ * per child, in units, next to the model's numbers. For the three
+ * concurrent modes the model is PROCESSOR SHARING: n runnable jobs each
+ * get 1/n of the CPU, which is what CFS approximates. The kernel's
+ * results are repeated 'repeats' times and averaged.
+ *
+ * EXAMPLE:
+ *     ./convoy_real                   # the demo's convoy, 10 ms per unit
+ *     ./convoy_real -m fifo,sjf 300 5 5 5
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o convoy_real convoy_real.c
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>    /* sched_setaffinity(), sched_setscheduler(), SCHED_BATCH */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>     /* clock_gettime() */
+#include <unistd.h>   /* fork(), pipe(), getopt() */
+#include <sys/mman.h> /* mmap() for the shared result page */
+#include <sys/wait.h> /* waitpid() */
+
+#define MAX_JOBS 26 /* Named 'A' .. 'Z' */
+
+static const double convoy_bursts[] = {80, 15, 5, 25, 10};
+
+enum mode
+{
+    MODE_FIFO,
+    MODE_SJF,
+    MODE_CFS,
+    MODE_BATCH,
+    MODE_IDLE,
+    MODE_COUNT
+};
+
+static const char *const mode_names[MODE_COUNT] = {"fifo", "sjf", "cfs", "batch", "idle"};
+
+/* Written by each child, read by the parent after the batch */
+struct job_times
+{
+    double start; /* Seconds since the batch was released */
+    double end;
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Child: spin until we have used 'seconds' of CPU time */
+static void burn(double seconds)
+{
+    double until = cpu_seconds() + seconds;
+    volatile unsigned long sink = 0;
+    while (cpu_seconds() < until)
+    {
+        for (int i = 0; i < 1000; i++)
+            sink += (unsigned long)i;
+    }
+}
+
+/* Arrival order, or shortest burst first (insertion sort; ties keep arrival order) */
+static void job_order(int *order, const double *bursts, int n, int shortest_first)
+{
+    for (int i = 0; i < n; i++)
+    {
+        int j = i;
+        for (; shortest_first && j > 0 && bursts[order[j - 1]] > bursts[i]; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+}
+
+/*
+ * Fork one CPU-burning child. If 'gate' is a pipe, the child waits for the
+ * write end to be closed before starting, so a whole batch can be released
+ * at the same instant. 'policy' is applied in the child before it runs.
+ */
+static pid_t spawn_job(double burst_s, int policy, const int *gate, double t0_hint,
+                       struct job_times *out)
+{
+    pid_t rc = fork();
+    if (rc < 0)
+    {
+        perror("fork");
+        exit(1);
+    }
+    if (rc == 0)
+    {
+        if (policy != SCHED_OTHER)
+        {
+            struct sched_param sp = {0};
+            if (sched_setscheduler(0, policy, &sp) < 0)
+            {
+                perror("sched_setscheduler");
+                _exit(1);
+            }
+        }
+        if (gate)
+        {
+            /*
+             * Our copy of the write end must go first: read() only sees
+             * end-of-file once EVERY copy of the write end is closed.
+             */
+            char c;
+            close(gate[1]);
+            while (read(gate[0], &c, 1) > 0)
+                ;
+        }
+        out->start = now_seconds() - t0_hint;
+        burn(burst_s);
+        out->end = now_seconds() - t0_hint;
+        _exit(0);
+    }
+    return rc;
+}
+
+/*
+ * Run the batch once. The children copy 't0' from the parent at fork()
+ * time, so it must be set before the first fork: for the one-at-a-time
+ * modes it is the start of the run, and for the concurrent modes the
+ * children are held at the gate until just after it.
+ */
+static void run_batch(enum mode m, const double *bursts, int n, double scale_s,
+                      struct job_times *times)
+{
+    if (m == MODE_FIFO || m == MODE_SJF)
+    {
+        int order[MAX_JOBS];
+        job_order(order, bursts, n, m == MODE_SJF);
+        double t0 = now_seconds();
+        for (int i = 0; i < n; i++)
+        {
+            int k = order[i];
+            pid_t pid = spawn_job(bursts[k] * scale_s, SCHED_OTHER, NULL, t0, &times[k]);
+            waitpid(pid, NULL, 0);
+        }
+        return;
+    }
+
+    int policy = m == MODE_BATCH ? SCHED_BATCH : m == MODE_IDLE ? SCHED_IDLE : SCHED_OTHER;
+    int gate[2];
+    pid_t pids[MAX_JOBS];
+    if (pipe(gate) < 0)
+    {
+        perror("pipe");
+        exit(1);
+    }
+
+    /*
+     * Pick t0 a little in the future so every child has been forked by
+     * then, and release them all together by closing the write end.
+     */
+    double t0 = now_seconds() + 0.002 * n;
+    for (int i = 0; i < n; i++)
+        pids[i] = spawn_job(bursts[i] * scale_s, policy, gate, t0, &times[i]);
+    close(gate[0]);
+    while (now_seconds() < t0)
+        ;
+    close(gate[1]);
+    for (int i = 0; i < n; i++)
+        waitpid(pids[i], NULL, 0);
+}
+
+/*
+ * The model: what the demo page would predict for this mode.
+ * FIFO and SJF are simple running sums. For the concurrent modes we use
+ * processor sharing: with the bursts sorted, the i-th shortest job
+ * finishes once every job still running has had its share.
+ */
+static void model(enum mode m, const double *bursts, int n, double *resp, double *turn)
+{
+    int order[MAX_JOBS];
+    job_order(order, bursts, n, m != MODE_FIFO);
+
+    double t = 0, prev = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int k = order[i];
+        if (m == MODE_FIFO || m == MODE_SJF)
+        {
+            resp[k] = t;
+            t += bursts[k];
+        }
+        else
+        {
+            resp[k] = 0; /* Everyone gets the CPU almost immediately */
+            t += (bursts[k] - prev) * (n - i);
+            prev = bursts[k];
+        }
+        turn[k] = t;
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-s ms_per_unit] [-c cpu] [-m fifo,sjf,cfs,batch,idle]"
+                    " [-r repeats] [burst ...]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    double bursts[MAX_JOBS];
+    int n = 0;
+    double scale_ms = 10;
+    int cpu = -1, repeats = 1;
+    int want[MODE_COUNT] = {1, 1, 1, 1, 1};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:c:m:r:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': scale_ms = atof(optarg); break;
+        case 'c': cpu = atoi(optarg); break;
+        case 'r': repeats = atoi(optarg); break;
+        case 'm':
+            memset(want, 0, sizeof(want));
+            for (char *tok = strtok(optarg, ","); tok; tok = strtok(NULL, ","))
+            {
+                int k = 0;
+                while (k < MODE_COUNT && strcmp(tok, mode_names[k]) != 0)
+                    k++;
+                if (k == MODE_COUNT)
+                    usage(argv[0]);
+                want[k] = 1;
+            }
+            break;
+        default: usage(argv[0]);
+        }
+    }
+    for (; optind < argc && n < MAX_JOBS; optind++)
+        bursts[n++] = atof(argv[optind]);
+    if (optind != argc || scale_ms <= 0 || repeats < 1)
+        usage(argv[0]);
+    if (n == 0)
+    {
+        n = (int)(sizeof(convoy_bursts) / sizeof(convoy_bursts[0]));
+        memcpy(bursts, convoy_bursts, sizeof(convoy_bursts));
+    }
+
+    /*
+     * One CPU for everybody. The affinity mask is inherited across fork(),
+     * so setting it here pins every child as well.
+     */
+    if (cpu < 0)
+        cpu = sched_getcpu();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+    {
+        perror("sched_setaffinity");
+        return 1;
+    }
+
+    /* Shared with the children: they fill in their own start/end times */
+    struct job_times *times = mmap(NULL, sizeof(struct job_times) * MAX_JOBS,
+                                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (times == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    double scale_s = scale_ms / 1000.0;
+    double avg_turn[MODE_COUNT] = {0};
+    printf("%d jobs on cpu %d, 1 unit = %g ms, %d repeat(s); times in units\n\n",
+           n, cpu, scale_ms, repeats);
+
+    for (int m = 0; m < MODE_COUNT; m++)
+    {
+        if (!want[m])
+            continue;
+
+        double resp[MAX_JOBS] = {0}, turn[MAX_JOBS] = {0};
+        double mresp[MAX_JOBS], mturn[MAX_JOBS];
+        for (int r = 0; r < repeats; r++)
+        {
+            memset(times, 0, sizeof(struct job_times) * MAX_JOBS);
+            run_batch((enum mode)m, bursts, n, scale_s, times);
+            for (int i = 0; i < n; i++)
+            {
+                resp[i] += times[i].start / scale_s / repeats;
+                turn[i] += times[i].end / scale_s / repeats;
+            }
+        }
+        model((enum mode)m, bursts, n, mresp, mturn);
+
+        printf("%s\n", mode_names[m]);
+        printf("  %-4s %7s %10s %10s %12s %12s\n", "job", "burst", "response", "(model)",
+               "turnaround", "(model)");
+        double sum = 0, msum = 0;
+        for (int i = 0; i < n; i++)
+        {
+            printf("  %-4c %7g %10.1f %10.1f %12.1f %12.1f\n", 'A' + i, bursts[i],
+                   resp[i], mresp[i], turn[i], mturn[i]);
+            sum += turn[i];
+            msum += mturn[i];
+        }
+        avg_turn[m] = sum / n;
+        printf("  average turnaround %.1f (model %.1f)\n\n", sum / n, msum / n);
+    }
+
+    if (want[MODE_FIFO] && want[MODE_SJF])
+    {
+        double mresp[MAX_JOBS], fifo[MAX_JOBS], sjf[MAX_JOBS];
+        double fsum = 0, ssum = 0;
+        model(MODE_FIFO, bursts, n, mresp, fifo);
+        model(MODE_SJF, bursts, n, mresp, sjf);
+        for (int i = 0; i < n; i++)
+        {
+            fsum += fifo[i];
+            ssum += sjf[i];
+        }
+        printf("fifo / sjf average turnaround: %.2fx measured, %.2fx model\n",
+               avg_turn[MODE_FIFO] / avg_turn[MODE_SJF], fsum / ssum);
+    }
+    return 0;
+}
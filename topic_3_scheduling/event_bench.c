@@ -0,0 +1,193 @@
+/*
+ * PROGRAM: event_bench.c - Binary heap vs timing wheel as the event queue
+ *
+ * USAGE:
+ *     event_bench [-n rounds] [-c cpus] [-q quantum] [-H max_pending]
+ *
+ * PART 1 - "HOLD" TEST:
+ * The classic event-queue benchmark. Fill the queue with N pending events,
+ * then repeatedly pop the earliest and push a new one a random distance
+ * into the future, so the queue size stays at N. This is what a simulator
+ * with N jobs in flight does all day. We report nanoseconds per pop+push
+ * for N = 1000, 10000, ... up to max_pending (default 10 million).
+ *
+ * PART 2 - ROUND ROBIN WITH A TINY QUANTUM:
+ * The convoy from fifo-convoy-effect.html (bursts 80, 15, 5, 25, 10, all
+ * arriving together) repeated 'rounds' times under RR with quantum 1
+ * (default). A batch needs 135 units of CPU and one arrives every
+ * 150 / cpus units, so every CPU stays 90% busy - and every busy CPU
+ * produces an event EVERY time unit, the worst case for the event queue.
+ * We run the same simulation on both queues, report events per second,
+ * and check that the results are identical.
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o event_bench event_bench.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h> /* getopt() */
+#include <time.h>   /* clock_gettime() */
+
+#include "sched_sim.h"
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* xorshift64: a cheap random number generator, good enough for a benchmark */
+static uint64_t rng_next(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/* ======================================================================
+ * PART 1: HOLD TEST
+ * ====================================================================== */
+
+/* Seconds per pop+push with n events pending */
+static double hold(enum sim_evq_kind kind, size_t n, size_t ops, uint64_t *checksum)
+{
+    struct sim_evq q = {0};
+    struct sim_event ev;
+    uint64_t rng = 88172645463325252ull;
+    uint64_t spread = 2 * (uint64_t)n; /* Average gap to the next event ~ n */
+
+    if (kind == EVQ_WHEEL)
+    {
+        q.wheel = malloc(sizeof(*q.wheel));
+        tw_init(q.wheel);
+    }
+    for (size_t i = 0; i < n; i++)
+        sim_evq_push(&q, rng_next(&rng) % spread, EV_CPU, 0, 0);
+
+    double start = now_seconds();
+    for (size_t i = 0; i < ops; i++)
+    {
+        sim_evq_pop(&q, &ev);
+        *checksum += ev.time;
+        sim_evq_push(&q, ev.time + 1 + rng_next(&rng) % spread, EV_CPU, 0, 0);
+    }
+    double elapsed = now_seconds() - start;
+
+    free(q.heap);
+    if (q.wheel)
+    {
+        tw_free(q.wheel);
+        free(q.wheel);
+    }
+    return elapsed / (double)ops;
+}
+
+/* ======================================================================
+ * PART 2: RR ON THE CONVOY
+ * ====================================================================== */
+
+static const uint64_t convoy_bursts[] = {80, 15, 5, 25, 10};
+#define CONVOY_JOBS   5
+#define CONVOY_PERIOD 150 /* The batch needs 135 units of CPU: load 0.9 */
+
+struct convoy_source
+{
+    uint64_t rounds;
+    int ncpus;
+    uint64_t next; /* Jobs handed out so far */
+};
+
+static int convoy_next(void *ctx, struct job_record *out)
+{
+    struct convoy_source *c = ctx;
+    if (c->next == c->rounds * CONVOY_JOBS)
+        return 0;
+    *out = (struct job_record){0};
+    out->arrival = c->next / CONVOY_JOBS * CONVOY_PERIOD / (uint64_t)c->ncpus;
+    out->burst = convoy_bursts[c->next % CONVOY_JOBS];
+    out->id = (uint32_t)c->next;
+    c->next++;
+    return 1;
+}
+
+/* Run the convoy once; returns the elapsed seconds and fills in *st */
+static double run_convoy(const struct sim_config *cfg, uint64_t rounds, uint64_t *events,
+                         struct sim_stats *st)
+{
+    struct convoy_source src = {rounds, cfg->ncpus, 0};
+    struct sim s;
+
+    sim_init(&s, cfg, (struct job_source){convoy_next, &src});
+    double start = now_seconds();
+    *events = 0;
+    while (sim_step(&s))
+        (*events)++;
+    double elapsed = now_seconds() - start;
+    *st = s.stats;
+    sim_free(&s);
+    return elapsed;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n rounds] [-c cpus] [-q quantum] [-H max_pending]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct sim_config cfg = {POLICY_RR, 1, 1, EVQ_HEAP};
+    uint64_t rounds = 100000;
+    size_t max_pending = 10000000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:c:q:H:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': rounds = strtoull(optarg, NULL, 10); break;
+        case 'c': cfg.ncpus = atoi(optarg); break;
+        case 'q': cfg.quantum = strtoull(optarg, NULL, 10); break;
+        case 'H': max_pending = strtoull(optarg, NULL, 10); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || cfg.ncpus < 1 || cfg.ncpus > SIM_MAX_CPUS || cfg.quantum == 0)
+        usage(argv[0]);
+
+    printf("hold test: ns per pop+push with N events pending\n");
+    printf("%12s %10s %10s\n", "N", "heap", "wheel");
+    for (size_t n = 1000; n <= max_pending; n *= 10)
+    {
+        size_t ops = n < 2000000 ? 2000000 : n;
+        uint64_t sum_heap = 0, sum_wheel = 0;
+        double heap = hold(EVQ_HEAP, n, ops, &sum_heap);
+        double wheel = hold(EVQ_WHEEL, n, ops, &sum_wheel);
+        printf("%12zu %10.1f %10.1f%s\n", n, heap * 1e9, wheel * 1e9,
+               sum_heap == sum_wheel ? "" : "   MISMATCH");
+    }
+
+    printf("\nconvoy x %llu under rr (quantum %llu) on %d cpu(s)\n",
+           (unsigned long long)rounds, (unsigned long long)cfg.quantum, cfg.ncpus);
+    struct sim_stats st[2];
+    for (int k = 0; k < 2; k++)
+    {
+        uint64_t events;
+        cfg.events = (enum sim_evq_kind)k;
+        double t = run_convoy(&cfg, rounds, &events, &st[k]);
+        printf("  %-5s %llu events in %.3f s: %.1f M events/s, average turnaround %.2f\n",
+               sim_evq_names[k], (unsigned long long)events, t, events / t / 1e6,
+               st[k].jobs ? (double)st[k].sum_turnaround / (double)st[k].jobs : 0.0);
+    }
+    if (st[0].jobs != st[1].jobs || st[0].sum_turnaround != st[1].sum_turnaround ||
+        st[0].sum_response != st[1].sum_response || st[0].makespan != st[1].makespan)
+    {
+        printf("MISMATCH: the two event queues disagree\n");
+        exit(1);
+    }
+    exit(0);
+}
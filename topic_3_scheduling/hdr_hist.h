@@ -0,0 +1,136 @@
+/*
+ * hdr_hist.h - Fixed-size histograms for latency percentiles
+ *
+ * fifo-convoy-effect.html reports one number: "Average turnaround = 107".
+ * An average hides exactly what the convoy effect is about - a few jobs
+ * waiting a very long time. Percentiles show it: "half the jobs finish
+ * within X (p50), but one in a thousand waits longer than Y (p99.9)".
+ *
+ * Computing an exact percentile needs every value sorted, which is
+ * impossible for billions of jobs. Instead we count values in BUCKETS
+ * whose width grows with the value (the "HDR histogram" idea):
+ *
+ *     values 0..127      one bucket per value        (exact)
+ *     values 128..255    one bucket per 2 values
+ *     values 256..511    one bucket per 4 values
+ *     ...                and so on, up to 2^64
+ *
+ * Every power of two is split into 64 equal buckets, so a reported value
+ * is never off by more than 1/64 (about 1.6%) of the true one, for small
+ * and huge values alike. The whole histogram is a fixed array of
+ * HDR_BUCKETS counters (about 30 KB) no matter how many values go in.
+ *
+ * MERGING:
+ * Two histograms with the same layout are merged by adding their counters.
+ * So parallel simulations (one per thread, one per machine) can each keep
+ * their own histogram and combine them at the end - with exactly the same
+ * result as if one simulation had seen every job.
+ */
+
+#ifndef HDR_HIST_H
+#define HDR_HIST_H
+
+#include <stdint.h>
+#include <string.h> /* memset() */
+
+#define HDR_SUB_BITS 7                         /* 2^7 = 128 exact values at the bottom */
+#define HDR_HALF     (1u << (HDR_SUB_BITS - 1)) /* 64 buckets per power of two */
+#define HDR_BUCKETS  ((64 - HDR_SUB_BITS + 1) * HDR_HALF + HDR_HALF)
+
+struct hdr_hist
+{
+    uint64_t count;
+    uint64_t min, max;
+    double sum; /* For the mean; a double cannot overflow */
+    uint64_t counts[HDR_BUCKETS];
+};
+
+static inline void hdr_init(struct hdr_hist *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+/* Which bucket does value v fall into? */
+static inline unsigned hdr_bucket(uint64_t v)
+{
+    if (v < 2 * HDR_HALF)
+        return (unsigned)v;
+
+    /* Keep the top HDR_SUB_BITS bits of v; 'shift' is how many we drop */
+    unsigned msb = 63u - (unsigned)__builtin_clzll(v);
+    unsigned shift = msb - (HDR_SUB_BITS - 1);
+    return shift * HDR_HALF + (unsigned)(v >> shift);
+}
+
+/* Smallest value that lands in bucket b */
+static inline uint64_t hdr_bucket_low(unsigned b)
+{
+    if (b < 2 * HDR_HALF)
+        return b;
+    unsigned shift = b / HDR_HALF - 1;
+    return (uint64_t)(b - shift * HDR_HALF) << shift;
+}
+
+static inline void hdr_record(struct hdr_hist *h, uint64_t v)
+{
+    h->counts[hdr_bucket(v)]++;
+    h->count++;
+    h->sum += (double)v;
+    if (v < h->min)
+        h->min = v;
+    if (v > h->max)
+        h->max = v;
+}
+
+/* dst += src */
+static inline void hdr_merge(struct hdr_hist *dst, const struct hdr_hist *src)
+{
+    for (unsigned b = 0; b < HDR_BUCKETS; b++)
+        dst->counts[b] += src->counts[b];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+static inline double hdr_mean(const struct hdr_hist *h)
+{
+    return h->count ? h->sum / (double)h->count : 0.0;
+}
+
+/*
+ * The value below which 'pct' percent of recorded values fall.
+ * We walk the buckets until we have passed that many values, then report
+ * the HIGHEST value the bucket can hold (clamped to the true min and max),
+ * so a tail percentile is never reported as better than it really was.
+ */
+static inline uint64_t hdr_percentile(const struct hdr_hist *h, double pct)
+{
+    if (h->count == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)h->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < HDR_BUCKETS; b++)
+    {
+        seen += h->counts[b];
+        if (seen >= rank)
+        {
+            uint64_t v = b + 1 < HDR_BUCKETS ? hdr_bucket_low(b + 1) - 1 : UINT64_MAX;
+            if (v < h->min)
+                v = h->min;
+            if (v > h->max)
+                v = h->max;
+            return v;
+        }
+    }
+    return h->max;
+}
+
+#endif /* HDR_HIST_H */
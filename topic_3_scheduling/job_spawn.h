@@ -0,0 +1,230 @@
+/*
+ * job_spawn.h - Launch shell commands as real jobs, for the userspace schedulers
+ *
+ * The simulators in this directory schedule made-up jobs. The tools that
+ * schedule REAL processes (rr_dispatch.c, ...) all need the same few
+ * pieces, built on the fork()/exec()/wait() pattern of fork_wait_exec.c:
+ *
+ *   - read a list of commands, one per line
+ *   - start one with fork() + exec("/bin/sh", "-c", command)
+ *   - stop, resume or renice the WHOLE job, not just the shell
+ *   - reap it and learn how much CPU it used
+ *
+ * KEY IDEA - ONE PROCESS GROUP PER JOB:
+ * "make -j4" or "sort big | uniq" is several processes. If we sent
+ * SIGSTOP to the shell's PID alone, its children would keep running.
+ * So every job gets its own process group (setpgid(0, 0) in the child),
+ * whose id is the child's PID, and signals go to the group:
+ *
+ *     kill(-pgid, SIGSTOP);   negative pid = every process in the group
+ *
+ * Job stdin is /dev/null: a process group that is not the terminal's
+ * foreground group is stopped with SIGTTIN if it tries to read the tty,
+ * which would look exactly like one of OUR stops.
+ */
+
+#ifndef JOB_SPAWN_H
+#define JOB_SPAWN_H
+
+#include <fcntl.h>        /* open() for /dev/null */
+#include <signal.h>       /* kill(), sigprocmask() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>         /* clock_gettime() */
+#include <unistd.h>       /* fork(), execl(), setpgid(), dup2() */
+#include <sys/resource.h> /* struct rusage */
+#include <sys/wait.h>     /* wait4() */
+
+static inline double job_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Read commands, one per line, skipping blank lines and '#' comments.
+ * Returns the number of commands and sets *out to a malloc'd array of
+ * malloc'd strings, or returns -1 if out of memory.
+ */
+static inline int job_list_read(FILE *fp, char ***out)
+{
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    char **cmds = NULL;
+    int n = 0, max = 0;
+
+    while ((len = getline(&line, &cap, fp)) >= 0)
+    {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+        const char *p = line + strspn(line, " \t");
+        if (*p == '\0' || *p == '#')
+            continue;
+        if (n == max)
+        {
+            max = max ? 2 * max : 64;
+            char **bigger = realloc(cmds, sizeof(*cmds) * (size_t)max);
+            if (bigger == NULL)
+                return -1;
+            cmds = bigger;
+        }
+        if ((cmds[n++] = strdup(p)) == NULL)
+            return -1;
+    }
+    free(line);
+    *out = cmds;
+    return n;
+}
+
+/*
+ * Start 'cmd' in a new process group. With 'quiet', its stdout and stderr
+ * go to /dev/null. Returns the child's PID (= its process group id), or -1.
+ */
+static inline pid_t job_spawn(const char *cmd, int quiet)
+{
+    pid_t rc = fork();
+    if (rc < 0)
+    {
+        perror("fork");
+        return -1;
+    }
+    if (rc == 0)
+    {
+        /*
+         * The schedulers block SIGCHLD to read it from a signalfd. The
+         * signal mask survives exec(), so clear it or the job would never
+         * hear about ITS children exiting.
+         */
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        setpgid(0, 0);
+
+        int devnull = open("/dev/null", O_RDWR);
+        if (devnull >= 0)
+        {
+            dup2(devnull, STDIN_FILENO);
+            if (quiet)
+            {
+                dup2(devnull, STDOUT_FILENO);
+                dup2(devnull, STDERR_FILENO);
+            }
+            if (devnull > STDERR_FILENO)
+                close(devnull);
+        }
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        perror("exec /bin/sh");
+        _exit(127);
+    }
+
+    /*
+     * Set the group from the parent too. Whichever of us runs first wins,
+     * and either way the group exists before we might signal it.
+     */
+    setpgid(rc, rc);
+    return rc;
+}
+
+/*
+ * Reap one finished child. Returns its PID, or -1 if there are no children
+ * (or, with WNOHANG in 'options', 0 if none has finished yet). *cpu gets
+ * the user + system CPU seconds the child used, from the rusage that
+ * wait4() fills in.
+ */
+static inline pid_t job_wait(int options, int *status, double *cpu)
+{
+    struct rusage ru;
+    pid_t pid = wait4(-1, status, options, &ru);
+    if (pid > 0)
+        *cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+               ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+    return pid;
+}
+
+/* Reap without blocking: 0 if nobody has finished */
+static inline pid_t job_reap(int *status, double *cpu)
+{
+    return job_wait(WNOHANG, status, cpu);
+}
+
+/*
+ * The kernel's scheduler statistics for one task, from /proc/<pid>/schedstat:
+ *
+ *     run_ns    time spent running on a CPU
+ *     wait_ns   time spent RUNNABLE but waiting in a run queue
+ *     slices    number of times it was put on a CPU
+ *
+ * Returns 0, or -1 if the task is gone (or schedstats are unavailable).
+ * A zombie still has its statistics: they vanish when it is reaped.
+ */
+static inline int job_schedstat_fd(int fd, unsigned long long *run_ns,
+                                   unsigned long long *wait_ns, unsigned long long *slices)
+{
+    char buf[128];
+    /* pread() at offset 0 re-reads the file without reopening it */
+    ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return -1;
+    buf[len] = '\0';
+    return sscanf(buf, "%llu %llu %llu", run_ns, wait_ns, slices) == 3 ? 0 : -1;
+}
+
+/* Open /proc/<pid>/schedstat, to sample it repeatedly with job_schedstat_fd() */
+static inline int job_schedstat_open(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/schedstat", (int)pid);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+static inline int job_schedstat(pid_t pid, unsigned long long *run_ns,
+                                unsigned long long *wait_ns, unsigned long long *slices)
+{
+    int fd = job_schedstat_open(pid);
+    if (fd < 0)
+        return -1;
+    int rc = job_schedstat_fd(fd, run_ns, wait_ns, slices);
+    close(fd);
+    return rc;
+}
+
+/*
+ * CPU time of a task and all its living descendants, ns. The children of
+ * each task are listed in /proc/<pid>/task/<pid>/children. Time used by a
+ * descendant that has already exited is not included.
+ */
+static inline unsigned long long job_tree_cpu_depth(pid_t pid, int depth)
+{
+    unsigned long long run = 0, wait, slices;
+    if (job_schedstat(pid, &run, &wait, &slices) < 0)
+        return 0;
+    if (depth > 16)
+        return run;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/children", (int)pid, (int)pid);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return run;
+    int child;
+    while (fscanf(fp, "%d", &child) == 1)
+        run += job_tree_cpu_depth(child, depth + 1);
+    fclose(fp);
+    return run;
+}
+
+static inline unsigned long long job_tree_cpu(pid_t pid)
+{
+    return job_tree_cpu_depth(pid, 0);
+}
+
+/* Signal every process of a job */
+static inline int job_signal(pid_t pgid, int sig)
+{
+    return kill(-pgid, sig);
+}
+
+#endif /* JOB_SPAWN_H */
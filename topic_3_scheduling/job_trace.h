@@ -0,0 +1,266 @@
+/*
+ * job_trace.h - A compact binary format for scheduling job traces
+ *
+ * The demo pages describe their workloads as inline JavaScript literals:
+ *
+ *     const JOBS = [ { name: 'A', burst: 80 }, { name: 'B', burst: 15 }, ... ];
+ *
+ * That is fine for five jobs, but a real cluster produces millions of jobs
+ * per day. This header defines a binary trace format that the simulator
+ * can replay in CONSTANT memory, no matter how large the file is.
+ *
+ * FILE LAYOUT (all integers little-endian):
+ *
+ *     +---------------------------+
+ *     | header   (32 bytes)       |   magic "JOBTRACE", version, count
+ *     +---------------------------+
+ *     | record 0 (32 bytes)       |   arrival, burst, id, priority,
+ *     | record 1 (32 bytes)       |   io_every, io_time
+ *     | ...                       |
+ *     +---------------------------+
+ *
+ * KEY IDEA: Every record has the SAME size, so record i lives at byte
+ * offset 32 + 32*i. No parsing is needed - the reader just points into the
+ * file. Records must be sorted by arrival time, which is the order the
+ * simulator consumes them in.
+ *
+ * READING WITH mmap():
+ * Instead of read()-ing the file into a buffer, we map it into our address
+ * space. The kernel pages it in on demand as we touch it. Two hints keep
+ * memory use flat:
+ *   - madvise(MADV_SEQUENTIAL) tells the kernel we read front-to-back, so
+ *     it reads ahead aggressively and may drop pages behind us.
+ *   - Every JOB_TRACE_WINDOW bytes we madvise(MADV_DONTNEED) the part we
+ *     have already consumed, so those pages leave our resident set.
+ * The whole trace is never materialized in memory at once.
+ */
+
+#ifndef JOB_TRACE_H
+#define JOB_TRACE_H
+
+#include <stdint.h>   /* Fixed-width integer types: uint32_t, uint64_t */
+#include <stddef.h>   /* offsetof() */
+#include <stdio.h>    /* FILE, fopen(), fwrite() for the writer side */
+#include <string.h>   /* memcpy(), memcmp() */
+#include <fcntl.h>    /* open() */
+#include <unistd.h>   /* close() */
+#include <sys/mman.h> /* mmap(), madvise(), munmap() */
+#include <sys/stat.h> /* fstat() to learn the file size */
+
+#define JOB_TRACE_MAGIC   "JOBTRACE"
+#define JOB_TRACE_VERSION 1
+
+/* Consumed bytes are released from our resident set in chunks of this size */
+#define JOB_TRACE_WINDOW (8u << 20) /* 8 MB */
+
+/*
+ * The file header. Written once at the start of the file.
+ * 'count' is patched in when the writer is closed.
+ */
+struct job_trace_header
+{
+    char magic[8];        /* "JOBTRACE" - lets us reject random files */
+    uint32_t version;     /* JOB_TRACE_VERSION */
+    uint32_t record_size; /* sizeof(struct job_record), for sanity checks */
+    uint64_t count;       /* Number of records that follow */
+    uint64_t reserved;    /* Pads the header to 32 bytes */
+};
+
+/*
+ * One job. Exactly 32 bytes, so two records share a 64-byte cache line.
+ *
+ * The I/O pattern is described by two numbers: after every 'io_every' units
+ * of CPU the job issues an I/O request that keeps the device busy for
+ * 'io_time' units. io_every == 0 means a pure CPU job, like the ones in
+ * fifo-simple.html and fifo-convoy-effect.html.
+ */
+struct job_record
+{
+    uint64_t arrival;  /* Time the job enters the system */
+    uint64_t burst;    /* Total CPU time the job needs */
+    uint32_t id;       /* Job identifier (0 = 'A', 1 = 'B', ... in the demos) */
+    uint32_t priority; /* Smaller number = more important */
+    uint32_t io_every; /* CPU units between I/O requests (0 = never) */
+    uint32_t io_time;  /* Device service time for each I/O request */
+};
+
+_Static_assert(sizeof(struct job_trace_header) == 32, "header must be 32 bytes");
+_Static_assert(sizeof(struct job_record) == 32, "record must be 32 bytes");
+
+/* ======================================================================
+ * READER
+ * ====================================================================== */
+
+struct job_trace
+{
+    int fd;                     /* Open file descriptor for the trace */
+    const unsigned char *base;  /* Start of the mapping */
+    size_t size;                /* Length of the mapping in bytes */
+    uint64_t count;             /* Records in the file */
+    uint64_t next;              /* Index of the next record to return */
+    size_t released;            /* Bytes already handed back with DONTNEED */
+};
+
+/*
+ * Open and map a trace file. Returns 0 on success, -1 on error
+ * (with a message already printed to stderr).
+ */
+static inline int job_trace_open(struct job_trace *t, const char *path)
+{
+    struct stat st;
+    struct job_trace_header h;
+
+    memset(t, 0, sizeof(*t));
+    t->fd = open(path, O_RDONLY);
+    if (t->fd < 0)
+    {
+        perror(path);
+        return -1;
+    }
+
+    if (fstat(t->fd, &st) < 0 || (size_t)st.st_size < sizeof(h))
+    {
+        fprintf(stderr, "%s: not a job trace (too short)\n", path);
+        close(t->fd);
+        return -1;
+    }
+    t->size = (size_t)st.st_size;
+
+    /*
+     * PROT_READ + MAP_PRIVATE: a read-only view of the file. Nothing is
+     * actually read from disk yet - pages are faulted in as we touch them.
+     */
+    void *p = mmap(NULL, t->size, PROT_READ, MAP_PRIVATE, t->fd, 0);
+    if (p == MAP_FAILED)
+    {
+        perror("mmap");
+        close(t->fd);
+        return -1;
+    }
+    t->base = p;
+
+    /* Tell the kernel we will stream through the file front to back */
+    madvise(p, t->size, MADV_SEQUENTIAL);
+
+    memcpy(&h, t->base, sizeof(h));
+    if (memcmp(h.magic, JOB_TRACE_MAGIC, 8) != 0 ||
+        h.version != JOB_TRACE_VERSION ||
+        h.record_size != sizeof(struct job_record) ||
+        h.count > (t->size - sizeof(h)) / sizeof(struct job_record))
+    {
+        fprintf(stderr, "%s: bad or truncated job trace header\n", path);
+        munmap(p, t->size);
+        close(t->fd);
+        return -1;
+    }
+    t->count = h.count;
+    return 0;
+}
+
+/*
+ * Copy the next record into *out. Returns 1 if a record was produced,
+ * 0 at the end of the trace.
+ */
+static inline int job_trace_next(struct job_trace *t, struct job_record *out)
+{
+    if (t->next == t->count)
+        return 0;
+
+    size_t off = sizeof(struct job_trace_header) +
+                 (size_t)t->next * sizeof(struct job_record);
+    memcpy(out, t->base + off, sizeof(*out));
+    t->next++;
+
+    /*
+     * Once a whole window lies behind us, drop it from the resident set.
+     * The pages are still backed by the file, so nothing is lost - if we
+     * ever touched them again they would simply be read back in.
+     */
+    if (off - t->released >= 2 * (size_t)JOB_TRACE_WINDOW)
+    {
+        madvise((void *)(t->base + t->released), JOB_TRACE_WINDOW, MADV_DONTNEED);
+        t->released += JOB_TRACE_WINDOW;
+    }
+    return 1;
+}
+
+/*
+ * Random access: copy record i into *out. For tools that jump around in
+ * the trace (sched_whatif.c); do not mix with job_trace_next(), which
+ * releases pages behind it.
+ */
+static inline void job_trace_get(const struct job_trace *t, uint64_t i, struct job_record *out)
+{
+    memcpy(out, t->base + sizeof(struct job_trace_header) + (size_t)i * sizeof(struct job_record),
+           sizeof(*out));
+}
+
+static inline void job_trace_close(struct job_trace *t)
+{
+    munmap((void *)t->base, t->size);
+    close(t->fd);
+}
+
+/* ======================================================================
+ * WRITER
+ * ====================================================================== */
+
+struct job_trace_writer
+{
+    FILE *fp;
+    uint64_t count;
+    uint64_t last_arrival;
+};
+
+static inline int job_trace_create(struct job_trace_writer *w, const char *path)
+{
+    struct job_trace_header h;
+
+    memset(w, 0, sizeof(*w));
+    w->fp = fopen(path, "wb");
+    if (w->fp == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    /* Write a placeholder header; the count is filled in by close() */
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, JOB_TRACE_MAGIC, 8);
+    h.version = JOB_TRACE_VERSION;
+    h.record_size = sizeof(struct job_record);
+    fwrite(&h, sizeof(h), 1, w->fp);
+    return 0;
+}
+
+/*
+ * Append one record. Returns -1 if arrivals go backwards, because the
+ * simulator relies on the trace being sorted by arrival time.
+ */
+static inline int job_trace_append(struct job_trace_writer *w, const struct job_record *r)
+{
+    if (w->count > 0 && r->arrival < w->last_arrival)
+    {
+        fprintf(stderr, "job %u: arrival %llu is earlier than the previous job's %llu"
+                        " (traces must be sorted by arrival)\n",
+                r->id, (unsigned long long)r->arrival,
+                (unsigned long long)w->last_arrival);
+        return -1;
+    }
+    w->last_arrival = r->arrival;
+    w->count++;
+    return fwrite(r, sizeof(*r), 1, w->fp) == 1 ? 0 : -1;
+}
+
+static inline int job_trace_finish(struct job_trace_writer *w)
+{
+    /* Go back to the header and record how many jobs we wrote */
+    long count_off = (long)offsetof(struct job_trace_header, count);
+    int ok = fseek(w->fp, count_off, SEEK_SET) == 0 &&
+             fwrite(&w->count, sizeof(w->count), 1, w->fp) == 1;
+    if (fclose(w->fp) != 0)
+        ok = 0;
+    return ok ? 0 : -1;
+}
+
+#endif /* JOB_TRACE_H */
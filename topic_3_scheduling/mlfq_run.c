@@ -0,0 +1,302 @@
+/*
+ * PROGRAM: mlfq_run.c - A Multi-Level Feedback Queue for real commands, using nice
+ *
+ * USAGE:
+ *     mlfq_run [-L levels] [-a allotment_ms] [-b boost_ms] [-t tick_ms] [-j slots] [-n]
+ *              [commands_file]
+ *
+ * MLFQ learns which jobs are interactive by watching them. Its rules:
+ *
+ *   1. Higher priority runs first; equal priorities share the CPU.
+ *   2. A new job starts at the TOP level.
+ *   3. Once a job has used up its ALLOTMENT of CPU at a level - no matter
+ *      how many times it gave the CPU up in between - it moves down one.
+ *   4. Every BOOST period, every job goes back to the top, so nothing
+ *      starves and a job that became interactive is noticed again.
+ *
+ * We cannot replace the kernel's scheduler, but we can steer it: level i
+ * becomes a NICE value, from 0 at the top to 19 at the bottom. Under CFS a
+ * nice-19 task gets about 1/70 of the CPU a nice-0 task gets, so demoted
+ * CPU hogs soak up what is left while jobs that mostly sleep - editors,
+ * shells, short commands - stay at nice 0 and keep their response time.
+ *
+ * HOW IT WORKS:
+ * All commands are started at once (or 'slots' at a time), each in its own
+ * process group (job_spawn.h). Every tick a timerfd wakes us up and we
+ * read each job's CPU time from /proc/<pid>/schedstat - for the job's
+ * leader and every descendant, found through /proc/<pid>/task/<pid>/children.
+ * Demotion and boosting are one setpriority(PRIO_PGRP, ...) call each,
+ * which renices the whole job. SIGCHLD arrives on a signalfd.
+ *
+ * The allotment doubles at every level (-a gives the top level's). Time a
+ * descendant used before it exited is not seen: for pipelines the
+ * accounting is a lower bound.
+ *
+ * PRIVILEGES: anyone may RAISE their nice value, but lowering it again -
+ * the boost - needs CAP_SYS_NICE or a RLIMIT_NICE that allows it
+ * (ulimit -e). Without either, we warn once and jobs stay where they sank.
+ *
+ * EXAMPLE:
+ *     printf '%s\n' 'awk "BEGIN{for(;;);}"' 'for i in $(seq 100); do sleep 0.01; done' \
+ *         | timeout 10 ./mlfq_run
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o mlfq_run mlfq_run.c
+ */
+
+#include <errno.h>
+#include <poll.h>         /* poll() */
+#include <stdint.h>
+#include <sys/signalfd.h> /* signalfd() */
+#include <sys/timerfd.h>  /* timerfd_create() */
+
+#include "job_spawn.h"
+
+#define MAX_LEVELS 20 /* Nice 0 .. 19 */
+
+struct job
+{
+    const char *cmd;
+    pid_t pid;                /* Also the process group id; 0 = not started */
+    int done;
+    int level;
+    unsigned long long seen;  /* Last CPU sample of the job, ns */
+    unsigned long long used;  /* CPU used at the current level, ns */
+    unsigned long long total; /* CPU used overall, ns */
+    unsigned long long at_level[MAX_LEVELS]; /* CPU per level, ns */
+    unsigned demotions;
+    double start, end;        /* Seconds after t0 */
+    int status;
+};
+
+struct mlfq
+{
+    struct job *jobs;
+    int njobs, started, running, done;
+    int slots;               /* 0 = start everything at once */
+    int levels;
+    int nice[MAX_LEVELS];    /* Nice value for each level */
+    unsigned long long allot[MAX_LEVELS]; /* CPU ns before demotion */
+    int quiet;
+    int boost_denied;
+    double t0;
+};
+
+static void set_level(struct mlfq *q, struct job *j, int level)
+{
+    j->level = level;
+    j->used = 0;
+    if (setpriority(PRIO_PGRP, (id_t)j->pid, q->nice[level]) < 0)
+    {
+        if (errno == EACCES || errno == EPERM)
+        {
+            if (!q->boost_denied)
+                fprintf(stderr, "mlfq_run: not allowed to lower nice values: boosts are"
+                                " ignored (needs CAP_SYS_NICE or ulimit -e)\n");
+            q->boost_denied = 1;
+        }
+    }
+}
+
+static void start_jobs(struct mlfq *q)
+{
+    while (q->started < q->njobs && (q->slots == 0 || q->running < q->slots))
+    {
+        struct job *j = &q->jobs[q->started++];
+        j->start = job_now() - q->t0;
+        if ((j->pid = job_spawn(j->cmd, q->quiet)) < 0)
+            exit(1);
+        j->level = 0; /* Rule 2: new jobs start at the top, nice 0 */
+        q->running++;
+    }
+}
+
+/* Rule 3: charge every job the CPU it used since the last tick */
+static void account(struct mlfq *q)
+{
+    for (int k = 0; k < q->started; k++)
+    {
+        struct job *j = &q->jobs[k];
+        if (j->done)
+            continue;
+        unsigned long long now = job_tree_cpu(j->pid);
+        /* A descendant that exited takes its time with it: never go backwards */
+        unsigned long long delta = now > j->seen ? now - j->seen : 0;
+        j->seen = now;
+        j->used += delta;
+        j->total += delta;
+        j->at_level[j->level] += delta;
+        if (j->level < q->levels - 1 && j->used >= q->allot[j->level])
+        {
+            set_level(q, j, j->level + 1);
+            j->demotions++;
+        }
+    }
+}
+
+/* Rule 4: everybody back to the top */
+static void boost(struct mlfq *q)
+{
+    for (int k = 0; k < q->started; k++)
+    {
+        struct job *j = &q->jobs[k];
+        if (!j->done && (j->level > 0 || j->used > 0))
+            set_level(q, j, 0);
+    }
+}
+
+static void reap(struct mlfq *q, int sfd)
+{
+    struct signalfd_siginfo si;
+    while (read(sfd, &si, sizeof(si)) == sizeof(si))
+        ;
+
+    pid_t pid;
+    int status;
+    double cpu;
+    while ((pid = job_reap(&status, &cpu)) > 0)
+    {
+        for (int k = 0; k < q->started; k++)
+        {
+            struct job *j = &q->jobs[k];
+            if (j->pid != pid || j->done)
+                continue;
+            j->done = 1;
+            j->end = job_now() - q->t0;
+            j->status = status;
+            /* wait4() knows the exact total, including reaped descendants */
+            unsigned long long exact = (unsigned long long)(cpu * 1e9);
+            if (exact > j->total)
+            {
+                j->at_level[j->level] += exact - j->total;
+                j->total = exact;
+            }
+            q->running--;
+            q->done++;
+            break;
+        }
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-L levels] [-a allotment_ms] [-b boost_ms] [-t tick_ms]"
+                    " [-j slots] [-n] [commands_file]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct mlfq q = {0};
+    double allot_ms = 50, boost_ms = 1000, tick_ms = 10;
+    int opt;
+
+    q.levels = 4;
+    while ((opt = getopt(argc, argv, "L:a:b:t:j:n")) != -1)
+    {
+        switch (opt)
+        {
+        case 'L': q.levels = atoi(optarg); break;
+        case 'a': allot_ms = atof(optarg); break;
+        case 'b': boost_ms = atof(optarg); break;
+        case 't': tick_ms = atof(optarg); break;
+        case 'j': q.slots = atoi(optarg); break;
+        case 'n': q.quiet = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (argc - optind > 1 || q.levels < 1 || q.levels > MAX_LEVELS || allot_ms <= 0 ||
+        tick_ms <= 0 || boost_ms < 0 || q.slots < 0)
+        usage(argv[0]);
+
+    for (int i = 0; i < q.levels; i++)
+    {
+        q.nice[i] = q.levels == 1 ? 0 : (i * 19 + (q.levels - 1) / 2) / (q.levels - 1);
+        q.allot[i] = (unsigned long long)(allot_ms * 1e6) << i;
+    }
+
+    FILE *fp = stdin;
+    if (optind < argc && (fp = fopen(argv[optind], "r")) == NULL)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    char **cmds;
+    q.njobs = job_list_read(fp, &cmds);
+    if (q.njobs <= 0)
+    {
+        fprintf(stderr, "no commands to run\n");
+        return 1;
+    }
+    q.jobs = calloc((size_t)q.njobs, sizeof(*q.jobs));
+    for (int k = 0; k < q.njobs; k++)
+        q.jobs[k].cmd = cmds[k];
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    int sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (sfd < 0 || tfd < 0)
+    {
+        perror("signalfd/timerfd");
+        return 1;
+    }
+    struct itimerspec tick = {0};
+    tick.it_interval.tv_sec = (time_t)(tick_ms / 1000);
+    tick.it_interval.tv_nsec = (long)((tick_ms - 1000.0 * (double)tick.it_interval.tv_sec) * 1e6);
+    tick.it_value = tick.it_interval;
+    timerfd_settime(tfd, 0, &tick, NULL);
+
+    printf("levels:");
+    for (int i = 0; i < q.levels; i++)
+        printf(" [nice %d, %g ms]", q.nice[i], (double)q.allot[i] / 1e6);
+    printf(" boost every %g ms\n", boost_ms);
+    fflush(stdout);
+
+    q.t0 = job_now();
+    double next_boost = q.t0 + boost_ms / 1000.0;
+    start_jobs(&q);
+    while (q.done < q.njobs)
+    {
+        struct pollfd fds[2] = {{tfd, POLLIN, 0}, {sfd, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            return 1;
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            uint64_t expirations;
+            if (read(tfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                perror("read timerfd");
+            account(&q);
+            if (boost_ms > 0 && job_now() >= next_boost)
+            {
+                boost(&q);
+                next_boost += boost_ms / 1000.0;
+            }
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            reap(&q, sfd);
+            start_jobs(&q);
+        }
+    }
+
+    printf("\n%4s %10s %10s %9s %6s %6s  %-*s %s\n", "job", "start", "turnaround", "cpu",
+           "level", "demot", 8 * q.levels, "cpu per level (ms)", "command");
+    for (int k = 0; k < q.njobs; k++)
+    {
+        struct job *j = &q.jobs[k];
+        printf("%4d %9.3fs %9.3fs %8.3fs %6d %6u  ", k, j->start, j->end, (double)j->total / 1e9,
+               j->level, j->demotions);
+        for (int i = 0; i < q.levels; i++)
+            printf("%7.0f ", (double)j->at_level[i] / 1e6);
+        printf(" %s\n", j->cmd);
+    }
+    return 0;
+}
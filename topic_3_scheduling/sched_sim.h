@@ -0,0 +1,709 @@
+/*
+ * sched_sim.h - A discrete-event CPU scheduling simulator
+ *
+ * This is the engine behind the pictures in fifo-simple.html and
+ * fifo-convoy-effect.html. Instead of hand-computing the timeline, we let
+ * the program play it out:
+ *
+ *     jobs arrive  -->  READY QUEUE  -->  CPU 0..n-1  -->  done
+ *                          ^                     |
+ *                          +---------------------+   (preempted / quantum expired)
+ *
+ * All CPUs share one ready queue. Whenever a CPU is idle and the queue is
+ * not empty, the policy picks the next job for it.
+ *
+ * CPU AND I/O BURSTS:
+ * Real jobs do not compute non-stop - they read files, wait for the disk,
+ * the network, the user. A job whose record has io_every > 0 runs for
+ * io_every units of CPU, then BLOCKS on an I/O request of io_time units:
+ *
+ *     READY --> RUNNING --(I/O request)--> BLOCKED --(I/O done)--> READY
+ *
+ * Blocked jobs queue up for a single device, which serves them one at a
+ * time in FIFO order. While a job is blocked, the CPU is free to run
+ * someone else - this OVERLAP is what keeps both the CPU and the device
+ * busy. SJF and STCF treat each CPU burst as its own "job", so a short
+ * interactive burst that comes back from I/O gets the CPU right away.
+ *
+ * POLICIES:
+ *   FIFO - run jobs in arrival order, each to completion
+ *   SJF  - when the CPU frees up, pick the job with the smallest burst
+ *   STCF - like SJF, but a newly arrived shorter job PREEMPTS the running one
+ *   RR   - run each job for at most one quantum, then send it to the back
+ *
+ * DISCRETE-EVENT SIMULATION:
+ * We do not tick the clock one unit at a time. Instead we keep a queue of
+ * future EVENTS ("next job arrives at t=95", "CPU slice ends at t=80") and
+ * jump straight from one event to the next. Nothing interesting happens in
+ * between, so the result is identical and much faster.
+ *
+ * The event queue is a binary heap by default. With cfg.events = EVQ_WHEEL
+ * it is a hierarchical timing wheel instead (see timing_wheel.h), which
+ * stays O(1) per event when millions of events are pending. Both produce
+ * exactly the same simulation.
+ *
+ * CONSTANT MEMORY:
+ * Jobs are pulled from a 'struct job_source' one at a time, only when the
+ * clock reaches their arrival. The simulator holds just the jobs that are
+ * currently in the system, never the whole workload.
+ *
+ * Everything is 'static inline' so a program only needs to #include this
+ * header - there is no library to build or link.
+ */
+
+#ifndef SCHED_SIM_H
+#define SCHED_SIM_H
+
+#include <stdint.h>
+#include <stdlib.h>   /* realloc(), free() */
+#include <string.h>   /* memset(), strcmp() */
+
+#include "job_trace.h" /* struct job_record */
+#include "hdr_hist.h"  /* percentile histograms */
+#include "timing_wheel.h" /* the alternative event queue */
+
+#define SIM_NONE  UINT32_MAX /* "no job" marker for job indices */
+#define SIM_NEVER UINT64_MAX /* "has not happened yet" marker for times */
+
+#define SIM_MAX_CPUS 64
+
+enum sim_policy
+{
+    POLICY_FIFO,
+    POLICY_SJF,
+    POLICY_STCF,
+    POLICY_RR,
+};
+
+static const char *const sim_policy_names[] = {"fifo", "sjf", "stcf", "rr"};
+
+/* Parse "fifo", "sjf", ... Returns -1 if the name is unknown. */
+static inline int sim_policy_from_name(const char *name)
+{
+    for (int i = 0; i < (int)(sizeof(sim_policy_names) / sizeof(sim_policy_names[0])); i++)
+        if (strcmp(name, sim_policy_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+enum sim_evq_kind
+{
+    EVQ_HEAP,  /* Binary heap: O(log n) per event, tiny and simple */
+    EVQ_WHEEL, /* Hierarchical timing wheel: O(1) per event */
+};
+
+static const char *const sim_evq_names[] = {"heap", "wheel"};
+
+struct sim_config
+{
+    enum sim_policy policy;
+    uint64_t quantum;         /* Time slice length; only used by POLICY_RR */
+    int ncpus;                /* Number of CPUs, 1..SIM_MAX_CPUS */
+    enum sim_evq_kind events; /* Which event queue to use (default: heap) */
+};
+
+/*
+ * Where jobs come from. next() fills in *out and returns 1, or returns 0
+ * when there are no more jobs. Jobs must come out sorted by arrival time.
+ */
+struct job_source
+{
+    int (*next)(void *ctx, struct job_record *out);
+    void *ctx;
+};
+
+/* A job that is currently in the system (arrived but not yet finished) */
+struct sim_job
+{
+    struct job_record rec; /* What the trace said about this job */
+    uint64_t remaining;    /* CPU time still needed */
+    uint64_t first_run;    /* When it first got the CPU (SIM_NEVER if not yet) */
+    uint64_t cpu_since_io; /* CPU used since the last I/O request */
+    uint64_t blocked;      /* Total time spent waiting for or doing I/O */
+    uint64_t blocked_at;   /* When the current I/O request was issued */
+    uint32_t next_free;    /* Free-list link while the slot is unused */
+};
+
+/*
+ * Summary numbers: the averages the demo pages compute by hand, plus
+ * histograms so we can ask for percentiles. Everything here has a fixed
+ * size, so the stats cost the same whether we simulate 5 jobs or 5 billion,
+ * and two sim_stats can be merged with sim_stats_merge().
+ */
+struct sim_stats
+{
+    uint64_t jobs;           /* Jobs completed */
+    uint64_t sum_turnaround; /* completion - arrival */
+    uint64_t sum_response;   /* first run - arrival */
+    uint64_t sum_wait;       /* time spent in the ready queue */
+    uint64_t sum_blocked;    /* time spent in the device queue or doing I/O */
+    uint64_t cpu_busy;       /* Time the CPUs spent running jobs (summed over CPUs) */
+    uint64_t io_busy;        /* Time the device spent serving I/O requests */
+    uint64_t io_requests;    /* I/O requests served */
+    uint64_t makespan;       /* Completion time of the last job */
+
+    struct hdr_hist turnaround; /* Distribution of completion - arrival */
+    struct hdr_hist response;   /* Distribution of first run - arrival */
+    struct hdr_hist wait;       /* Distribution of time spent in the ready queue */
+};
+
+static inline void sim_stats_init(struct sim_stats *st)
+{
+    memset(st, 0, sizeof(*st));
+    hdr_init(&st->turnaround);
+    hdr_init(&st->response);
+    hdr_init(&st->wait);
+}
+
+/* dst += src, e.g. to combine simulations of different shards of a workload */
+static inline void sim_stats_merge(struct sim_stats *dst, const struct sim_stats *src)
+{
+    dst->jobs += src->jobs;
+    dst->sum_turnaround += src->sum_turnaround;
+    dst->sum_response += src->sum_response;
+    dst->sum_wait += src->sum_wait;
+    dst->sum_blocked += src->sum_blocked;
+    dst->cpu_busy += src->cpu_busy;
+    dst->io_busy += src->io_busy;
+    dst->io_requests += src->io_requests;
+    if (src->makespan > dst->makespan)
+        dst->makespan = src->makespan;
+    hdr_merge(&dst->turnaround, &src->turnaround);
+    hdr_merge(&dst->response, &src->response);
+    hdr_merge(&dst->wait, &src->wait);
+}
+
+/* ======================================================================
+ * EVENT QUEUE - a binary min-heap ordered by time, or a timing wheel
+ * ====================================================================== */
+
+enum sim_event_type
+{
+    EV_ARRIVAL, /* The next job from the source arrives */
+    EV_IO,      /* The device finishes the current I/O request */
+    EV_CPU,     /* The running job's slice ends (done, preempted, expired or I/O) */
+};
+
+struct sim_event
+{
+    uint64_t time;
+    uint64_t seq;  /* Insertion order - breaks ties so runs are reproducible */
+    uint32_t type; /* enum sim_event_type */
+    uint32_t cpu;  /* For EV_CPU: which CPU's slice ended */
+    uint32_t gen;  /* For EV_CPU: which dispatch this slice belongs to */
+};
+
+struct sim_evq
+{
+    struct sim_event *heap;
+    size_t len, cap;
+    uint64_t seq;
+    struct timing_wheel *wheel; /* Used instead of the heap when not NULL */
+};
+
+/*
+ * Event ordering: earlier time first. At the same time, arrivals and I/O
+ * completions go before slice ends, so a job that just used up its quantum
+ * queues up BEHIND jobs that arrived or became ready at that same instant.
+ */
+static inline int sim_event_before(const struct sim_event *a, const struct sim_event *b)
+{
+    if (a->time != b->time)
+        return a->time < b->time;
+    if (a->type != b->type)
+        return a->type < b->type;
+    return a->seq < b->seq;
+}
+
+static inline void sim_evq_push(struct sim_evq *q, uint64_t time, uint32_t type,
+                                uint32_t cpu, uint32_t gen)
+{
+    /* The wheel keeps equal-time events in push order per type, just like seq */
+    if (q->wheel)
+    {
+        tw_push(q->wheel, time, type, (uint64_t)cpu << 32 | gen);
+        return;
+    }
+
+    if (q->len == q->cap)
+    {
+        q->cap = q->cap ? 2 * q->cap : 16;
+        q->heap = realloc(q->heap, q->cap * sizeof(*q->heap));
+    }
+
+    struct sim_event ev = {time, q->seq++, type, cpu, gen};
+    size_t i = q->len++;
+
+    /* Sift up: move the hole towards the root until the parent is earlier */
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!sim_event_before(&ev, &q->heap[parent]))
+            break;
+        q->heap[i] = q->heap[parent];
+        i = parent;
+    }
+    q->heap[i] = ev;
+}
+
+static inline int sim_evq_pop(struct sim_evq *q, struct sim_event *out)
+{
+    if (q->wheel)
+    {
+        uint64_t data;
+        if (!tw_pop(q->wheel, &out->time, &out->type, &data))
+            return 0;
+        out->seq = 0;
+        out->cpu = (uint32_t)(data >> 32);
+        out->gen = (uint32_t)data;
+        return 1;
+    }
+
+    if (q->len == 0)
+        return 0;
+
+    *out = q->heap[0];
+    struct sim_event last = q->heap[--q->len];
+    size_t i = 0;
+
+    /* Sift down: move the hole towards the leaves, pulling up the earlier child */
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= q->len)
+            break;
+        if (child + 1 < q->len && sim_event_before(&q->heap[child + 1], &q->heap[child]))
+            child++;
+        if (!sim_event_before(&q->heap[child], &last))
+            break;
+        q->heap[i] = q->heap[child];
+        i = child;
+    }
+    q->heap[i] = last;
+    return 1;
+}
+
+/* Time of the next event, or SIM_NEVER if there is none */
+static inline uint64_t sim_evq_next_time(const struct sim_evq *q)
+{
+    if (q->wheel)
+        return tw_next_time(q->wheel);
+    return q->len ? q->heap[0].time : SIM_NEVER;
+}
+
+/* ======================================================================
+ * READY QUEUE
+ *
+ * FIFO and RR need a plain first-in-first-out queue (a ring buffer).
+ * SJF and STCF need "give me the shortest job" (a min-heap on remaining
+ * time). Both store job indices, never pointers, because the job array
+ * may move when it grows.
+ * ====================================================================== */
+
+struct sim_ready
+{
+    uint32_t *slot;
+    size_t head, len, cap; /* 'head' is only used in ring mode */
+    int by_remaining;      /* 1 = min-heap (SJF/STCF), 0 = ring (FIFO/RR) */
+};
+
+/* Length of the job's next CPU burst: up to its next I/O, or to the end */
+static inline uint64_t sim_next_burst(const struct sim_job *j)
+{
+    if (j->rec.io_every > 0 && j->rec.io_every - j->cpu_since_io < j->remaining)
+        return j->rec.io_every - j->cpu_since_io;
+    return j->remaining;
+}
+
+/* Heap order for SJF/STCF: shortest next CPU burst, then earliest arrival */
+static inline int sim_job_shorter(const struct sim_job *a, const struct sim_job *b)
+{
+    uint64_t la = sim_next_burst(a), lb = sim_next_burst(b);
+    if (la != lb)
+        return la < lb;
+    if (a->rec.arrival != b->rec.arrival)
+        return a->rec.arrival < b->rec.arrival;
+    return a->rec.id < b->rec.id;
+}
+
+static inline void sim_ready_push(struct sim_ready *r, const struct sim_job *jobs, uint32_t j)
+{
+    if (r->len == r->cap)
+    {
+        size_t old = r->cap;
+        r->cap = r->cap ? 2 * r->cap : 16;
+        r->slot = realloc(r->slot, r->cap * sizeof(*r->slot));
+
+        /* A wrapped-around ring must be unwrapped into the bigger buffer */
+        if (!r->by_remaining && r->head + r->len > old)
+        {
+            size_t tail_part = r->head + r->len - old;
+            memcpy(r->slot + old, r->slot, tail_part * sizeof(*r->slot));
+        }
+    }
+
+    if (!r->by_remaining)
+    {
+        r->slot[(r->head + r->len) % r->cap] = j;
+        r->len++;
+        return;
+    }
+
+    size_t i = r->len++;
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!sim_job_shorter(&jobs[j], &jobs[r->slot[parent]]))
+            break;
+        r->slot[i] = r->slot[parent];
+        i = parent;
+    }
+    r->slot[i] = j;
+}
+
+/* Index of the job that would run next, or SIM_NONE if the queue is empty */
+static inline uint32_t sim_ready_peek(const struct sim_ready *r)
+{
+    if (r->len == 0)
+        return SIM_NONE;
+    return r->by_remaining ? r->slot[0] : r->slot[r->head];
+}
+
+static inline uint32_t sim_ready_pop(struct sim_ready *r, const struct sim_job *jobs)
+{
+    uint32_t top = sim_ready_peek(r);
+    if (top == SIM_NONE)
+        return top;
+
+    if (!r->by_remaining)
+    {
+        r->head = (r->head + 1) % r->cap;
+        r->len--;
+        return top;
+    }
+
+    uint32_t last = r->slot[--r->len];
+    size_t i = 0;
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= r->len)
+            break;
+        if (child + 1 < r->len &&
+            sim_job_shorter(&jobs[r->slot[child + 1]], &jobs[r->slot[child]]))
+            child++;
+        if (!sim_job_shorter(&jobs[r->slot[child]], &jobs[last]))
+            break;
+        r->slot[i] = r->slot[child];
+        i = child;
+    }
+    r->slot[i] = last;
+    return top;
+}
+
+/* ======================================================================
+ * THE SIMULATOR
+ * ====================================================================== */
+
+/* What just happened to a job - for tools that draw the schedule */
+enum sim_change
+{
+    CHANGE_READY, /* Joined the ready queue: arrived, preempted, expired or back from I/O */
+    CHANGE_RUN,   /* Left the ready queue for a CPU */
+    CHANGE_SLICE, /* Was charged for running on a CPU from 'since' until now */
+    CHANGE_BLOCK, /* Asked for I/O and now waits for the device */
+};
+
+struct sim_cpu
+{
+    uint32_t running;     /* Job index on this CPU, or SIM_NONE when idle */
+    uint64_t slice_start; /* When the current slice began */
+    uint32_t gen;         /* Bumped on every dispatch; stale EV_CPU events are ignored */
+};
+
+struct sim
+{
+    struct sim_config cfg;
+    struct job_source src;
+
+    /* One job of lookahead: the next arrival we have read but not admitted */
+    struct job_record pending;
+    int have_pending;
+
+    /* Pool of in-flight jobs, recycled through a free list */
+    struct sim_job *jobs;
+    uint32_t njobs, free_head;
+
+    struct sim_ready ready;
+    struct sim_evq events;
+
+    struct sim_cpu cpu[SIM_MAX_CPUS];
+
+    /* The I/O device: one request in service, the rest wait in FIFO order */
+    struct sim_ready blocked;
+    uint32_t io_job;      /* Job being served, or SIM_NONE when idle */
+    uint64_t io_start;    /* When the current request started service */
+
+    uint64_t now;
+    const char *error;    /* Set if the run had to stop early */
+    struct sim_stats stats;
+
+    /* Optional hook, called once for every job that completes */
+    void (*on_complete)(void *arg, const struct sim_job *job, uint64_t finish);
+    /* Optional hook, called on every state change ('cpu' is -1 if none) */
+    void (*on_change)(void *arg, enum sim_change what, int cpu, const struct sim_job *job,
+                      uint64_t since);
+    void *hook_arg;
+};
+
+/* Pull the next job from the source and schedule its arrival */
+static inline void sim_fetch(struct sim *s)
+{
+    s->have_pending = s->src.next(s->src.ctx, &s->pending);
+    if (!s->have_pending)
+        return;
+    if (s->pending.arrival < s->now)
+    {
+        s->error = "jobs are not sorted by arrival time";
+        s->have_pending = 0;
+        return;
+    }
+    sim_evq_push(&s->events, s->pending.arrival, EV_ARRIVAL, 0, 0);
+}
+
+static inline void sim_init(struct sim *s, const struct sim_config *cfg, struct job_source src)
+{
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    s->src = src;
+    s->free_head = SIM_NONE;
+    for (int c = 0; c < SIM_MAX_CPUS; c++)
+        s->cpu[c].running = SIM_NONE;
+    s->io_job = SIM_NONE;
+    sim_stats_init(&s->stats);
+    if (s->cfg.ncpus < 1 || s->cfg.ncpus > SIM_MAX_CPUS)
+        s->error = "CPU count out of range";
+    s->ready.by_remaining = cfg->policy == POLICY_SJF || cfg->policy == POLICY_STCF;
+    if (cfg->events == EVQ_WHEEL)
+    {
+        s->events.wheel = malloc(sizeof(*s->events.wheel));
+        tw_init(s->events.wheel);
+    }
+    sim_fetch(s);
+}
+
+static inline void sim_free(struct sim *s)
+{
+    free(s->jobs);
+    free(s->ready.slot);
+    free(s->blocked.slot);
+    free(s->events.heap);
+    if (s->events.wheel)
+    {
+        tw_free(s->events.wheel);
+        free(s->events.wheel);
+    }
+}
+
+/* Take a slot from the free list (or grow the pool) for a newly arrived job */
+static inline uint32_t sim_alloc_job(struct sim *s)
+{
+    if (s->free_head == SIM_NONE)
+    {
+        uint32_t old = s->njobs;
+        s->njobs = old ? 2 * old : 64;
+        s->jobs = realloc(s->jobs, s->njobs * sizeof(*s->jobs));
+        for (uint32_t i = old; i < s->njobs; i++)
+            s->jobs[i].next_free = i + 1 < s->njobs ? i + 1 : SIM_NONE;
+        s->free_head = old;
+    }
+    uint32_t j = s->free_head;
+    s->free_head = s->jobs[j].next_free;
+    return j;
+}
+
+/* Account for CPU time used by the job on CPU c since its slice began */
+static inline void sim_charge(struct sim *s, int c)
+{
+    uint64_t ran = s->now - s->cpu[c].slice_start;
+    if (s->on_change && ran > 0)
+        s->on_change(s->hook_arg, CHANGE_SLICE, c, &s->jobs[s->cpu[c].running],
+                     s->cpu[c].slice_start);
+    s->jobs[s->cpu[c].running].remaining -= ran;
+    s->jobs[s->cpu[c].running].cpu_since_io += ran;
+    s->stats.cpu_busy += ran;
+    s->cpu[c].slice_start = s->now;
+}
+
+/* Job j joins the ready queue */
+static inline void sim_make_ready(struct sim *s, uint32_t j)
+{
+    sim_ready_push(&s->ready, s->jobs, j);
+    if (s->on_change)
+        s->on_change(s->hook_arg, CHANGE_READY, -1, &s->jobs[j], s->now);
+}
+
+static inline void sim_complete(struct sim *s, uint32_t j)
+{
+    struct sim_job *job = &s->jobs[j];
+    uint64_t turnaround = s->now - job->rec.arrival;
+    uint64_t response = job->first_run - job->rec.arrival;
+    uint64_t wait = turnaround - job->rec.burst - job->blocked;
+
+    s->stats.jobs++;
+    s->stats.sum_turnaround += turnaround;
+    s->stats.sum_response += response;
+    s->stats.sum_wait += wait;
+    hdr_record(&s->stats.turnaround, turnaround);
+    hdr_record(&s->stats.response, response);
+    hdr_record(&s->stats.wait, wait);
+    s->stats.sum_blocked += job->blocked;
+    s->stats.makespan = s->now;
+
+    if (s->on_complete)
+        s->on_complete(s->hook_arg, job, s->now);
+
+    job->next_free = s->free_head;
+    s->free_head = j;
+}
+
+/* Put job j on CPU c and schedule the end of its slice */
+static inline void sim_run_job(struct sim *s, int c, uint32_t j)
+{
+    struct sim_job *job = &s->jobs[j];
+    uint64_t slice = sim_next_burst(job);
+
+    if (s->cfg.policy == POLICY_RR && s->cfg.quantum < slice)
+        slice = s->cfg.quantum;
+    if (job->first_run == SIM_NEVER)
+        job->first_run = s->now;
+
+    s->cpu[c].running = j;
+    s->cpu[c].slice_start = s->now;
+    s->cpu[c].gen++;
+    if (s->on_change)
+        s->on_change(s->hook_arg, CHANGE_RUN, c, job, s->now);
+    sim_evq_push(&s->events, s->now + slice, EV_CPU, (uint32_t)c, s->cpu[c].gen);
+}
+
+/* Start serving job j on the device */
+static inline void sim_start_io(struct sim *s, uint32_t j)
+{
+    s->io_job = j;
+    s->io_start = s->now;
+    sim_evq_push(&s->events, s->now + s->jobs[j].rec.io_time, EV_IO, 0, 0);
+}
+
+/* Job j has used up its CPU burst and asks for I/O */
+static inline void sim_block(struct sim *s, uint32_t j)
+{
+    s->jobs[j].cpu_since_io = 0;
+    s->jobs[j].blocked_at = s->now;
+    if (s->on_change)
+        s->on_change(s->hook_arg, CHANGE_BLOCK, -1, &s->jobs[j], s->now);
+    if (s->io_job == SIM_NONE)
+        sim_start_io(s, j);
+    else
+        sim_ready_push(&s->blocked, s->jobs, j);
+}
+
+/*
+ * The scheduling decision. Called once all events at the current instant
+ * have been handled, so that e.g. SJF sees every job that arrived at t=0
+ * before choosing.
+ */
+static inline void sim_dispatch(struct sim *s)
+{
+    /* First hand out work to idle CPUs */
+    for (int c = 0; c < s->cfg.ncpus && s->ready.len > 0; c++)
+        if (s->cpu[c].running == SIM_NONE)
+            sim_run_job(s, c, sim_ready_pop(&s->ready, s->jobs));
+
+    /*
+     * Only STCF takes a CPU away from a job mid-slice: while the shortest
+     * waiting job needs less than the LONGEST running one, swap them.
+     */
+    if (s->cfg.policy != POLICY_STCF)
+        return;
+    while (s->ready.len > 0)
+    {
+        int victim = -1;
+        for (int c = 0; c < s->cfg.ncpus; c++)
+        {
+            sim_charge(s, c);
+            if (victim < 0 || sim_job_shorter(&s->jobs[s->cpu[victim].running],
+                                              &s->jobs[s->cpu[c].running]))
+                victim = c;
+        }
+        if (!sim_job_shorter(&s->jobs[sim_ready_peek(&s->ready)],
+                             &s->jobs[s->cpu[victim].running]))
+            return;
+        sim_make_ready(s, s->cpu[victim].running);
+        s->cpu[victim].running = SIM_NONE; /* Its pending EV_CPU is now stale */
+        sim_run_job(s, victim, sim_ready_pop(&s->ready, s->jobs));
+    }
+}
+
+/*
+ * Process one event. Returns 1 if there may be more work, 0 when the
+ * simulation is finished (or stopped with s->error set).
+ */
+static inline int sim_step(struct sim *s)
+{
+    struct sim_event ev;
+
+    if (s->error != NULL || !sim_evq_pop(&s->events, &ev))
+        return 0;
+    s->now = ev.time;
+
+    if (ev.type == EV_ARRIVAL)
+    {
+        uint32_t j = sim_alloc_job(s);
+        s->jobs[j].rec = s->pending;
+        s->jobs[j].remaining = s->pending.burst;
+        s->jobs[j].first_run = SIM_NEVER;
+        s->jobs[j].cpu_since_io = 0;
+        s->jobs[j].blocked = 0;
+        sim_make_ready(s, j);
+        sim_fetch(s);
+    }
+    else if (ev.type == EV_IO)
+    {
+        /* I/O done: the job is ready again, and the next request starts */
+        uint32_t j = s->io_job;
+        s->stats.io_busy += s->now - s->io_start;
+        s->stats.io_requests++;
+        s->jobs[j].blocked += s->now - s->jobs[j].blocked_at;
+        sim_make_ready(s, j);
+        s->io_job = SIM_NONE;
+        if (s->blocked.len > 0)
+            sim_start_io(s, sim_ready_pop(&s->blocked, s->jobs));
+    }
+    else if (ev.gen == s->cpu[ev.cpu].gen && s->cpu[ev.cpu].running != SIM_NONE)
+    {
+        uint32_t j = s->cpu[ev.cpu].running;
+        sim_charge(s, (int)ev.cpu);
+        s->cpu[ev.cpu].running = SIM_NONE;
+        if (s->jobs[j].remaining == 0)
+            sim_complete(s, j);
+        else if (s->jobs[j].rec.io_every > 0 && s->jobs[j].cpu_since_io >= s->jobs[j].rec.io_every)
+            sim_block(s, j);
+        else
+            sim_make_ready(s, j); /* RR: back of the line */
+    }
+
+    /* Decide only after the last event at this instant */
+    if (sim_evq_next_time(&s->events) > s->now)
+        sim_dispatch(s);
+    return 1;
+}
+
+/* Run the whole workload. Returns 0 on success, -1 if s->error was set. */
+static inline int sim_run(struct sim *s)
+{
+    while (sim_step(s))
+        ;
+    return s->error ? -1 : 0;
+}
+
+#endif /* SCHED_SIM_H */
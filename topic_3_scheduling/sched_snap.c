@@ -0,0 +1,487 @@
+/*
+ * PROGRAM: sched_snap.c - Export a simulated schedule for the demo pages
+ *
+ * fifo-simple.html and fifo-convoy-effect.html describe every step of
+ * the schedule with a full snapshot: the whole queue and EVERY block
+ * drawn so far. That is fine for 5 jobs; for 100000 jobs step n repeats
+ * the n - 1 blocks before it and the page would weigh gigabytes.
+ *
+ * This tool runs the simulator (sched_sim.h) and writes each step as a
+ * DELTA - only what changed - one JSON object per line:
+ *
+ *     {"format":"sched-snapshots","version":1,"policy":"fifo",...}
+ *     {"i":0,"t":0,"ops":[["n",0,80],["n",1,15],["r",0,0]],"key":{...}}
+ *     {"i":1,"t":80,"ops":[["b",0,0,0,80],["x",0],["r",0,1]]}
+ *     ...
+ *
+ * A step is one instant of simulated time, after the scheduler has made
+ * its decision. The operations, applied in order:
+ *
+ *     ["n", id, burst]              job id arrives and joins the ready queue
+ *     ["q", id]                     job id rejoins the back of the ready queue
+ *     ["r", cpu, id]                job id leaves the ready queue to run on cpu
+ *     ["b", cpu, id, start, end]    append a block to the Gantt chart
+ *     ["w", id]                     job id starts waiting for the I/O device
+ *     ["x", id]                     job id has completed
+ *
+ * A job leaving a CPU ("q", "w", "x") also stops running there. Blocks
+ * are only ever appended, so "the Gantt chart at step i" is simply the
+ * first N blocks of one array, where N grows as steps are applied.
+ *
+ * KEYFRAMES:
+ * Every -K steps (and on the first line of every chunk) the step also
+ * carries "key": the complete state after its operations:
+ *
+ *     "key": {"queue":[ids], "running":[id or null per cpu], "blocked":[ids],
+ *             "jobs":[[id, arrival, burst], ...],    every job in the system
+ *             "blocks":N, "done":N}                  totals so far
+ *
+ * To rebuild step i, start from the nearest keyframe at or before i and
+ * apply at most K - 1 steps of operations. snapshot_stream.js does this
+ * for a web page.
+ *
+ * CHUNKS:
+ * With -C n the output is split into files of n steps each
+ * (out.0000.jsonl, out.0001.jsonl, ...). Each starts with the header
+ * line and a keyframe, so a page can fetch just the part it shows.
+ *
+ * USAGE:
+ *     sched_snap [-p policy] [-q quantum] [-c cpus] [-K keyframe_every]
+ *                [-C chunk_steps] -o out (trace.bin | -w workload [-s seed])
+ *
+ * EXAMPLE:
+ *     ./trace_convert jobs convoy_jobs.js convoy.bin
+ *     ./sched_snap -p fifo -o convoy.jsonl convoy.bin
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o sched_snap sched_snap.c
+ */
+
+#include <stdarg.h> /* va_list for op() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> /* getopt() */
+
+#include "job_trace.h"
+#include "sched_sim.h"
+#include "workload_gen.h"
+
+/* ======================================================================
+ * MIRROR OF THE QUEUES
+ *
+ * The ready queue of SJF/STCF is a heap, whose array order means nothing
+ * to a reader. So we keep our own lists in the order jobs joined them,
+ * which is exactly the order the operations above rebuild. Lists are
+ * linked through the simulator's job slot numbers.
+ * ====================================================================== */
+
+enum where
+{
+    NOWHERE,
+    IN_READY,
+    IN_BLOCKED,
+};
+
+struct mirror
+{
+    uint32_t *prev, *next;
+    unsigned char *where;
+    uint32_t cap;
+    uint32_t head[3], tail[3], len[3]; /* Indexed by enum where */
+};
+
+static void mirror_grow(struct mirror *m, uint32_t n)
+{
+    if (n <= m->cap)
+        return;
+    m->prev = realloc(m->prev, n * sizeof(*m->prev));
+    m->next = realloc(m->next, n * sizeof(*m->next));
+    m->where = realloc(m->where, n);
+    memset(m->where + m->cap, NOWHERE, n - m->cap);
+    m->cap = n;
+}
+
+static void mirror_remove(struct mirror *m, uint32_t j)
+{
+    int w = m->where[j];
+    if (w == NOWHERE)
+        return;
+    if (m->prev[j] != SIM_NONE)
+        m->next[m->prev[j]] = m->next[j];
+    else
+        m->head[w] = m->next[j];
+    if (m->next[j] != SIM_NONE)
+        m->prev[m->next[j]] = m->prev[j];
+    else
+        m->tail[w] = m->prev[j];
+    m->len[w]--;
+    m->where[j] = NOWHERE;
+}
+
+static void mirror_append(struct mirror *m, uint32_t j, enum where w)
+{
+    mirror_remove(m, j);
+    m->prev[j] = m->tail[w];
+    m->next[j] = SIM_NONE;
+    if (m->tail[w] != SIM_NONE)
+        m->next[m->tail[w]] = j;
+    else
+        m->head[w] = j;
+    m->tail[w] = j;
+    m->len[w]++;
+    m->where[j] = (unsigned char)w;
+}
+
+/* ======================================================================
+ * THE EXPORTER
+ * ====================================================================== */
+
+struct open_block
+{
+    int open;
+    uint32_t job; /* Job id */
+    uint64_t start, end;
+};
+
+static struct
+{
+    struct sim *sim;
+    const char *path;
+    int chunk_steps;      /* 0 = one file */
+    int keyframe_every;
+    FILE *out;
+    int chunk;
+
+    uint64_t steps;       /* Steps written */
+    char *ops;            /* Operations of the current step, as JSON */
+    size_t ops_len, ops_cap;
+
+    struct open_block cpu[SIM_MAX_CPUS];
+    struct mirror m;
+    uint64_t blocks, done;
+
+    uint64_t bytes;       /* What we wrote */
+    uint64_t full_bytes;  /* What full snapshots would have taken */
+    uint64_t blocks_bytes; /* Size of all blocks so far, written out in full */
+} ex;
+
+static void op(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/* Append one operation to the current step */
+static void op(const char *fmt, ...)
+{
+    va_list ap;
+    for (;;)
+    {
+        size_t room = ex.ops_cap - ex.ops_len;
+        va_start(ap, fmt);
+        int n = vsnprintf(ex.ops + ex.ops_len, room, fmt, ap);
+        va_end(ap);
+        if ((size_t)n + 2 < room)
+        {
+            ex.ops_len += (size_t)n;
+            ex.ops[ex.ops_len++] = ',';
+            return;
+        }
+        ex.ops_cap = ex.ops_cap ? 2 * ex.ops_cap : 4096;
+        ex.ops = realloc(ex.ops, ex.ops_cap);
+    }
+}
+
+static uint32_t slot_of(const struct sim_job *job)
+{
+    return (uint32_t)(job - ex.sim->jobs);
+}
+
+/* Emit the block of the job on CPU c, if there is one */
+static void close_block(int c)
+{
+    struct open_block *b = &ex.cpu[c];
+    if (!b->open)
+        return;
+    op("[\"b\",%d,%u,%llu,%llu]", c, b->job, (unsigned long long)b->start,
+       (unsigned long long)b->end);
+    ex.blocks_bytes += (uint64_t)snprintf(NULL, 0, "[%d,%u,%llu,%llu],", c, b->job,
+                                          (unsigned long long)b->start,
+                                          (unsigned long long)b->end);
+    ex.blocks++;
+    b->open = 0;
+}
+
+/* Job 'id' has left whatever CPU it was on */
+static void close_block_of(uint32_t id)
+{
+    for (int c = 0; c < ex.sim->cfg.ncpus; c++)
+        if (ex.cpu[c].open && ex.cpu[c].job == id)
+            close_block(c);
+}
+
+static void on_change(void *arg, enum sim_change what, int cpu, const struct sim_job *job,
+                      uint64_t since)
+{
+    (void)arg;
+    uint32_t j = slot_of(job), id = job->rec.id;
+    mirror_grow(&ex.m, ex.sim->njobs);
+
+    switch (what)
+    {
+    case CHANGE_SLICE:
+    {
+        /* STCF charges running jobs without stopping them: glue the pieces */
+        struct open_block *b = &ex.cpu[cpu];
+        if (b->open && (b->job != id || b->end != since))
+            close_block(cpu);
+        if (!b->open)
+            *b = (struct open_block){1, id, since, since};
+        b->end = ex.sim->now;
+        break;
+    }
+    case CHANGE_READY:
+        close_block_of(id);
+        /* A job that has never run or blocked is a new arrival */
+        if (job->first_run == SIM_NEVER && job->blocked == 0 && ex.m.where[j] == NOWHERE)
+            op("[\"n\",%u,%llu]", id, (unsigned long long)job->rec.burst);
+        else
+            op("[\"q\",%u]", id);
+        mirror_append(&ex.m, j, IN_READY);
+        break;
+    case CHANGE_RUN:
+        op("[\"r\",%d,%u]", cpu, id);
+        mirror_remove(&ex.m, j);
+        break;
+    case CHANGE_BLOCK:
+        close_block_of(id);
+        op("[\"w\",%u]", id);
+        mirror_append(&ex.m, j, IN_BLOCKED);
+        break;
+    }
+}
+
+static void on_complete(void *arg, const struct sim_job *job, uint64_t finish)
+{
+    (void)arg;
+    (void)finish;
+    close_block_of(job->rec.id);
+    op("[\"x\",%u]", job->rec.id);
+    ex.done++;
+}
+
+static int open_chunk(void)
+{
+    char name[4096];
+
+    if (ex.out && fclose(ex.out) != 0)
+        return -1;
+    if (ex.chunk_steps > 0)
+        snprintf(name, sizeof(name), "%s.%04d.jsonl", ex.path, ex.chunk);
+    else
+        snprintf(name, sizeof(name), "%s", ex.path);
+    ex.out = fopen(name, "w");
+    if (ex.out == NULL)
+    {
+        perror(name);
+        return -1;
+    }
+
+    const struct sim_config *cfg = &ex.sim->cfg;
+    ex.bytes += (uint64_t)fprintf(ex.out,
+                                  "{\"format\":\"sched-snapshots\",\"version\":1,\"policy\":\"%s\","
+                                  "\"quantum\":%llu,\"cpus\":%d,\"keyframe_every\":%d,"
+                                  "\"chunk\":%d,\"first_step\":%llu}\n",
+                                  sim_policy_names[cfg->policy], (unsigned long long)cfg->quantum,
+                                  cfg->ncpus, ex.keyframe_every, ex.chunk,
+                                  (unsigned long long)ex.steps);
+    ex.chunk++;
+    return 0;
+}
+
+static void print_list(enum where w)
+{
+    ex.bytes += (uint64_t)fprintf(ex.out, "[");
+    for (uint32_t j = ex.m.head[w]; j != SIM_NONE; j = ex.m.next[j])
+        ex.bytes += (uint64_t)fprintf(ex.out, "%s%u", j == ex.m.head[w] ? "" : ",",
+                                      ex.sim->jobs[j].rec.id);
+    ex.bytes += (uint64_t)fprintf(ex.out, "]");
+}
+
+static void write_keyframe(void)
+{
+    const struct sim *s = ex.sim;
+    int first = 1;
+
+    ex.bytes += (uint64_t)fprintf(ex.out, ",\"key\":{\"queue\":");
+    print_list(IN_READY);
+    ex.bytes += (uint64_t)fprintf(ex.out, ",\"running\":[");
+    for (int c = 0; c < s->cfg.ncpus; c++)
+    {
+        if (s->cpu[c].running == SIM_NONE)
+            ex.bytes += (uint64_t)fprintf(ex.out, "%snull", c ? "," : "");
+        else
+            ex.bytes += (uint64_t)fprintf(ex.out, "%s%u", c ? "," : "",
+                                          s->jobs[s->cpu[c].running].rec.id);
+    }
+    ex.bytes += (uint64_t)fprintf(ex.out, "],\"blocked\":");
+    print_list(IN_BLOCKED);
+
+    /* Every job in the system: queued, running or blocked */
+    ex.bytes += (uint64_t)fprintf(ex.out, ",\"jobs\":[");
+    for (uint32_t j = 0; j < ex.m.cap && j < s->njobs; j++)
+    {
+        int running = 0;
+        for (int c = 0; c < s->cfg.ncpus; c++)
+            running |= s->cpu[c].running == j;
+        if (ex.m.where[j] == NOWHERE && !running)
+            continue;
+        ex.bytes += (uint64_t)fprintf(ex.out, "%s[%u,%llu,%llu]", first ? "" : ",",
+                                      s->jobs[j].rec.id,
+                                      (unsigned long long)s->jobs[j].rec.arrival,
+                                      (unsigned long long)s->jobs[j].rec.burst);
+        first = 0;
+    }
+    ex.bytes += (uint64_t)fprintf(ex.out, "],\"blocks\":%llu,\"done\":%llu}",
+                                  (unsigned long long)ex.blocks, (unsigned long long)ex.done);
+}
+
+/* The instant is over: write its step */
+static int flush_step(void)
+{
+    if (ex.ops_len == 0)
+        return 0; /* Nothing visible happened */
+
+    if (ex.chunk_steps > 0 && ex.steps % (uint64_t)ex.chunk_steps == 0 && ex.steps > 0)
+        if (open_chunk() < 0)
+            return -1;
+    int key = ex.steps % (uint64_t)ex.keyframe_every == 0 ||
+              (ex.chunk_steps > 0 && ex.steps % (uint64_t)ex.chunk_steps == 0);
+
+    ex.ops[ex.ops_len - 1] = '\0'; /* Drop the trailing comma */
+    ex.bytes += (uint64_t)fprintf(ex.out, "{\"i\":%llu,\"t\":%llu,\"ops\":[%s]",
+                                  (unsigned long long)ex.steps,
+                                  (unsigned long long)ex.sim->now, ex.ops);
+    if (key)
+        write_keyframe();
+    ex.bytes += (uint64_t)fprintf(ex.out, "}\n");
+
+    /* A full snapshot would repeat the queue and every block so far */
+    ex.full_bytes += 40 + 8 * (uint64_t)(ex.m.len[IN_READY] + ex.m.len[IN_BLOCKED]) +
+                     ex.blocks_bytes;
+
+    ex.steps++;
+    ex.ops_len = 0;
+    return ferror(ex.out) ? -1 : 0;
+}
+
+/* ======================================================================
+ * COMMAND LINE
+ * ====================================================================== */
+
+static int trace_source_next(void *ctx, struct job_record *out)
+{
+    return job_trace_next(ctx, out);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-p fifo|sjf|stcf|rr] [-q quantum] [-c cpus] [-K keyframe_every]\n"
+            "          [-C chunk_steps] -o out (trace.bin | -w workload [-s seed])\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct sim_config cfg = {POLICY_FIFO, 10, 1, EVQ_HEAP};
+    struct workload_params wp;
+    const char *workload = NULL;
+    uint64_t seed = 1;
+    int opt;
+
+    workload_defaults(&wp);
+    ex.keyframe_every = 1000;
+
+    while ((opt = getopt(argc, argv, "p:q:c:K:C:o:w:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+        {
+            int p = sim_policy_from_name(optarg);
+            if (p < 0)
+                usage(argv[0]);
+            cfg.policy = (enum sim_policy)p;
+            break;
+        }
+        case 'q': cfg.quantum = strtoull(optarg, NULL, 10); break;
+        case 'c': cfg.ncpus = atoi(optarg); break;
+        case 'K': ex.keyframe_every = atoi(optarg); break;
+        case 'C': ex.chunk_steps = atoi(optarg); break;
+        case 'o': ex.path = optarg; break;
+        case 'w':
+            workload = optarg;
+            if (workload_parse(optarg, &wp) < 0)
+                usage(argv[0]);
+            break;
+        case 's': seed = strtoull(optarg, NULL, 10); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - (workload ? 0 : 1) || ex.path == NULL || cfg.quantum == 0 ||
+        cfg.ncpus < 1 || cfg.ncpus > SIM_MAX_CPUS || ex.keyframe_every < 1 || ex.chunk_steps < 0)
+        usage(argv[0]);
+
+    struct job_trace trace;
+    struct workload_gen gen;
+    struct job_source src;
+    if (workload)
+    {
+        workload_init(&gen, &wp, seed, 0);
+        src = (struct job_source){workload_next, &gen};
+    }
+    else
+    {
+        if (job_trace_open(&trace, argv[optind]) < 0)
+            exit(1);
+        src = (struct job_source){trace_source_next, &trace};
+    }
+
+    struct sim s;
+    sim_init(&s, &cfg, src);
+    s.on_change = on_change;
+    s.on_complete = on_complete;
+    ex.sim = &s;
+    for (int w = 0; w < 3; w++)
+        ex.m.head[w] = ex.m.tail[w] = SIM_NONE;
+    if (open_chunk() < 0)
+        exit(1);
+
+    /* A step ends once every event at the current instant is handled */
+    while (sim_step(&s))
+        if (sim_evq_next_time(&s.events) > s.now && flush_step() < 0)
+        {
+            fprintf(stderr, "%s: write failed\n", ex.path);
+            exit(1);
+        }
+    if (s.error)
+    {
+        fprintf(stderr, "%s\n", s.error);
+        exit(1);
+    }
+    if (fclose(ex.out) != 0)
+    {
+        fprintf(stderr, "%s: write failed\n", ex.path);
+        exit(1);
+    }
+
+    printf("%llu jobs, %llu steps, %llu blocks in %d file(s)\n", (unsigned long long)s.stats.jobs,
+           (unsigned long long)ex.steps, (unsigned long long)ex.blocks, ex.chunk);
+    printf("%llu bytes written; full snapshots would take about %llu (%.0fx more)\n",
+           (unsigned long long)ex.bytes, (unsigned long long)ex.full_bytes,
+           ex.bytes ? (double)ex.full_bytes / (double)ex.bytes : 0.0);
+
+    sim_free(&s);
+    if (!workload)
+        job_trace_close(&trace);
+    exit(0);
+}
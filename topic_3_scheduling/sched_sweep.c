@@ -0,0 +1,594 @@
+/*
+ * PROGRAM: sched_sweep.c - Run a whole grid of scheduling experiments in parallel
+ *
+ * fifo-convoy-effect.html compares two policies on one set of five jobs.
+ * That is a single point. To see how policies REALLY behave we need to
+ * vary everything at once:
+ *
+ *     policy  x  RR quantum  x  number of CPUs  x  workload seed
+ *
+ * which easily adds up to thousands of independent simulations. Each one
+ * is single-threaded, so we run many of them at the same time - one
+ * worker thread per core.
+ *
+ * USAGE:
+ *     sched_sweep [-p fifo,sjf,stcf,rr] [-q 1,5,10,20] [-c 1,2,4] [-s 1-10]
+ *                 [-n jobs] [-b mean_burst] [-l load] [-w workload]
+ *                 [-j threads] [-o out.col]
+ *     sched_sweep -d out.col          print a results file as CSV
+ *
+ *     -p  policies to try
+ *     -q  RR quanta to try (other policies ignore the quantum)
+ *     -c  CPU counts to try
+ *     -s  workload seeds, as a list and/or ranges: 1-100,200
+ *     -n  jobs per simulation (default 10000)
+ *     -b  mean CPU burst (default 10)
+ *     -l  offered load per CPU, 0 < load < 1 (default 0.9)
+ *     -w  workload shape, e.g. arrival=bursty,burst=pareto,alpha=1.2
+ *         (see workload_gen.h; the arrival gap is always derived from -l)
+ *     -j  worker threads (default: number of online CPUs)
+ *     -o  results file (default sweep.col)
+ *
+ * WORK STEALING:
+ * Simulations differ wildly in cost (4 CPUs with a quantum of 1 takes far
+ * longer than FIFO on 1 CPU), so splitting the grid into equal slices up
+ * front would leave some threads idle while others grind. Instead each
+ * worker owns a RANGE of task numbers [lo, hi). It takes tasks from the
+ * bottom of its own range; when that runs dry it picks another worker and
+ * STEALS THE TOP HALF of that worker's remaining range. Busy workers are
+ * only disturbed when someone is idle, and all threads finish together.
+ *
+ * PERCENTILES ACROSS SEEDS:
+ * Averaging per-seed p99s does not give the p99 of all jobs. Instead every
+ * finished simulation merges its turnaround histogram (see hdr_hist.h)
+ * into one shared histogram per configuration, and the summary reports
+ * percentiles of that pooled distribution.
+ *
+ * COLUMNAR OUTPUT:
+ * Results are written column by column - all policies, then all quanta,
+ * then all average turnarounds, ... - so an analysis script can load just
+ * the columns it needs with a single read. Layout (little-endian):
+ *
+ *     "SWEEPCOL"  u32 version  u32 ncols  u64 nrows
+ *     ncols x { char name[24]; u32 type (0 = u64, 1 = f64); u32 pad; u64 offset }
+ *     column data: nrows x 8 bytes per column, starting at 'offset'
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -pthread -o sched_sweep sched_sweep.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>  /* getopt(), sysconf() */
+#include <pthread.h> /* pthread_create(), mutexes */
+#include <time.h>    /* clock_gettime() for the wall-clock summary */
+
+#include "sched_sim.h"
+#include "workload_gen.h"
+
+/* ======================================================================
+ * THE GRID
+ * ====================================================================== */
+
+struct sweep_task
+{
+    enum sim_policy policy;
+    uint64_t quantum; /* 0 for policies that do not use one */
+    int ncpus;
+    uint64_t seed;
+};
+
+struct sweep_result
+{
+    uint64_t jobs;
+    double avg_turnaround;
+    double avg_response;
+    double avg_wait;
+    uint64_t makespan;
+    double cpu_util;
+    uint64_t p50_turnaround;
+    uint64_t p99_turnaround;
+    uint64_t p99_response;
+};
+
+/* Turnaround of every job of every seed, one histogram per configuration */
+struct pooled
+{
+    pthread_mutex_t lock;
+    struct hdr_hist turnaround;
+};
+
+/* Shared, read-only settings for every simulation */
+static struct
+{
+    struct workload_params shape;
+    double load;
+} setup;
+
+static struct sweep_task *tasks;
+static struct sweep_result *results; /* results[i] belongs to tasks[i] */
+static size_t ntasks;
+static struct pooled *pools;         /* pools[i / nseeds] for tasks[i] */
+static size_t nseeds;
+
+static void run_task(size_t i)
+{
+    const struct sweep_task *t = &tasks[i];
+    struct sim_config cfg = {t->policy, t->quantum ? t->quantum : 1, t->ncpus, EVQ_HEAP};
+
+    /* Keep the per-CPU load fixed as CPUs are added: more CPUs, more jobs/s */
+    struct workload_params wp = setup.shape;
+    wp.mean_interarrival = workload_mean_burst(&wp) / (setup.load * t->ncpus);
+
+    struct workload_gen gen;
+    workload_init(&gen, &wp, t->seed, 0);
+
+    struct sim s;
+    sim_init(&s, &cfg, (struct job_source){workload_next, &gen});
+    sim_run(&s);
+
+    const struct sim_stats *st = &s.stats;
+    double n = st->jobs ? (double)st->jobs : 1.0;
+    results[i] = (struct sweep_result){
+        .jobs = st->jobs,
+        .avg_turnaround = st->sum_turnaround / n,
+        .avg_response = st->sum_response / n,
+        .avg_wait = st->sum_wait / n,
+        .makespan = st->makespan,
+        .cpu_util = st->makespan ? st->cpu_busy / ((double)st->makespan * t->ncpus) : 0.0,
+        .p50_turnaround = hdr_percentile(&st->turnaround, 50.0),
+        .p99_turnaround = hdr_percentile(&st->turnaround, 99.0),
+        .p99_response = hdr_percentile(&st->response, 99.0),
+    };
+
+    struct pooled *pool = &pools[i / nseeds];
+    pthread_mutex_lock(&pool->lock);
+    hdr_merge(&pool->turnaround, &st->turnaround);
+    pthread_mutex_unlock(&pool->lock);
+    sim_free(&s);
+}
+
+/* ======================================================================
+ * WORK-STEALING POOL
+ * ====================================================================== */
+
+struct worker
+{
+    pthread_mutex_t lock; /* Protects lo and hi */
+    size_t lo, hi;        /* Tasks [lo, hi) not yet started */
+    pthread_t thread;
+    int index;
+} __attribute__((aligned(64))); /* One cache line each - no false sharing */
+
+static struct worker *workers;
+static int nworkers;
+
+/* Take the next task from our own range. Returns 0 if the range is empty. */
+static int take_own(struct worker *w, size_t *out)
+{
+    int got = 0;
+    pthread_mutex_lock(&w->lock);
+    if (w->lo < w->hi)
+    {
+        *out = w->lo++;
+        got = 1;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return got;
+}
+
+/* Steal the top half of some other worker's range. Returns 0 if all are empty. */
+static int steal(struct worker *self)
+{
+    for (int k = 1; k < nworkers; k++)
+    {
+        struct worker *victim = &workers[(self->index + k) % nworkers];
+        size_t lo = 0, hi = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->lo < victim->hi)
+        {
+            size_t mid = victim->lo + (victim->hi - victim->lo) / 2;
+            lo = mid;
+            hi = victim->hi;
+            victim->hi = mid;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (lo < hi)
+        {
+            pthread_mutex_lock(&self->lock);
+            self->lo = lo;
+            self->hi = hi;
+            pthread_mutex_unlock(&self->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    size_t i;
+
+    /*
+     * Ranges only ever shrink - no new tasks appear - so once a full
+     * pass over every other worker finds nothing to steal, we are done.
+     */
+    for (;;)
+    {
+        while (take_own(w, &i))
+            run_task(i);
+        if (!steal(w))
+            break;
+    }
+    return NULL;
+}
+
+/* ======================================================================
+ * COLUMNAR OUTPUT
+ * ====================================================================== */
+
+#define SWEEP_MAGIC   "SWEEPCOL"
+#define SWEEP_VERSION 1
+#define SWEEP_NCOLS   13
+
+struct sweep_file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t ncols;
+    uint64_t nrows;
+};
+
+struct sweep_column
+{
+    char name[24];
+    uint32_t type; /* 0 = uint64_t, 1 = double */
+    uint32_t pad;
+    uint64_t offset;
+};
+
+static const struct
+{
+    const char *name;
+    uint32_t type;
+} columns[SWEEP_NCOLS] = {
+    {"policy", 0}, {"quantum", 0}, {"cpus", 0}, {"seed", 0}, {"jobs", 0},
+    {"avg_turnaround", 1}, {"avg_response", 1}, {"avg_wait", 1},
+    {"makespan", 0}, {"cpu_util", 1},
+    {"p50_turnaround", 0}, {"p99_turnaround", 0}, {"p99_response", 0},
+};
+
+/* Value of column c in row i, as 8 raw bytes */
+static void cell(size_t i, int c, void *out)
+{
+    const struct sweep_task *t = &tasks[i];
+    const struct sweep_result *r = &results[i];
+    uint64_t u = 0;
+    double d = 0;
+
+    switch (c)
+    {
+    case 0: u = t->policy; break;
+    case 1: u = t->quantum; break;
+    case 2: u = (uint64_t)t->ncpus; break;
+    case 3: u = t->seed; break;
+    case 4: u = r->jobs; break;
+    case 5: d = r->avg_turnaround; break;
+    case 6: d = r->avg_response; break;
+    case 7: d = r->avg_wait; break;
+    case 8: u = r->makespan; break;
+    case 9: d = r->cpu_util; break;
+    case 10: u = r->p50_turnaround; break;
+    case 11: u = r->p99_turnaround; break;
+    case 12: u = r->p99_response; break;
+    }
+    if (columns[c].type == 0)
+        memcpy(out, &u, 8);
+    else
+        memcpy(out, &d, 8);
+}
+
+static int write_columns(const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    struct sweep_file_header h = {SWEEP_MAGIC, SWEEP_VERSION, SWEEP_NCOLS, ntasks};
+    fwrite(&h, sizeof(h), 1, fp);
+
+    uint64_t offset = sizeof(h) + SWEEP_NCOLS * sizeof(struct sweep_column);
+    for (int c = 0; c < SWEEP_NCOLS; c++)
+    {
+        struct sweep_column col;
+        memset(&col, 0, sizeof(col));
+        strncpy(col.name, columns[c].name, sizeof(col.name) - 1);
+        col.type = columns[c].type;
+        col.offset = offset;
+        fwrite(&col, sizeof(col), 1, fp);
+        offset += 8 * (uint64_t)ntasks;
+    }
+
+    for (int c = 0; c < SWEEP_NCOLS; c++)
+        for (size_t i = 0; i < ntasks; i++)
+        {
+            unsigned char v[8];
+            cell(i, c, v);
+            fwrite(v, 8, 1, fp);
+        }
+
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+/* -d mode: print a results file as CSV, reading it back column by column */
+static int dump_columns(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    struct sweep_file_header h;
+    struct sweep_column cols[SWEEP_NCOLS];
+
+    if (fp == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, SWEEP_MAGIC, 8) != 0 ||
+        h.version != SWEEP_VERSION || h.ncols != SWEEP_NCOLS ||
+        fread(cols, sizeof(cols[0]), SWEEP_NCOLS, fp) != SWEEP_NCOLS)
+    {
+        fprintf(stderr, "%s: not a sweep results file\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    uint64_t *data = malloc(SWEEP_NCOLS * h.nrows * 8 + 1);
+    for (int c = 0; c < SWEEP_NCOLS; c++)
+    {
+        fseek(fp, (long)cols[c].offset, SEEK_SET);
+        if (fread(data + c * h.nrows, 8, h.nrows, fp) != h.nrows)
+        {
+            fprintf(stderr, "%s: truncated column %s\n", path, cols[c].name);
+            free(data);
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+
+    for (int c = 0; c < SWEEP_NCOLS; c++)
+        printf("%s%s", cols[c].name, c + 1 < SWEEP_NCOLS ? "," : "\n");
+    for (uint64_t i = 0; i < h.nrows; i++)
+        for (int c = 0; c < SWEEP_NCOLS; c++)
+        {
+            uint64_t u = data[c * h.nrows + i];
+            double d;
+            memcpy(&d, &u, 8);
+            if (c == 0)
+                printf("%s", u < 4 ? sim_policy_names[u] : "?");
+            else if (cols[c].type == 0)
+                printf("%llu", (unsigned long long)u);
+            else
+                printf("%.4f", d);
+            printf("%s", c + 1 < SWEEP_NCOLS ? "," : "\n");
+        }
+    free(data);
+    return 0;
+}
+
+/* ======================================================================
+ * COMMAND LINE
+ * ====================================================================== */
+
+/*
+ * Parse "1,5,10" or "1-100,200" into a freshly allocated array.
+ * Returns the number of values, or -1 on a syntax error.
+ */
+static long parse_list(const char *arg, uint64_t **out)
+{
+    uint64_t *v = NULL;
+    size_t n = 0, cap = 0;
+    const char *p = arg;
+
+    while (*p)
+    {
+        char *end;
+        uint64_t lo = strtoull(p, &end, 10), hi = lo;
+        if (end == p)
+            goto bad;
+        p = end;
+        if (*p == '-')
+        {
+            hi = strtoull(p + 1, &end, 10);
+            if (end == p + 1 || hi < lo)
+                goto bad;
+            p = end;
+        }
+        for (uint64_t x = lo; x <= hi; x++)
+        {
+            if (n == cap)
+            {
+                cap = cap ? 2 * cap : 16;
+                v = realloc(v, cap * sizeof(*v));
+            }
+            v[n++] = x;
+        }
+        if (*p == ',')
+            p++;
+        else if (*p)
+            goto bad;
+    }
+    *out = v;
+    return (long)n;
+
+bad:
+    free(v);
+    return -1;
+}
+
+static long parse_policies(const char *arg, uint64_t **out)
+{
+    char *copy = strdup(arg), *save = NULL;
+    uint64_t *v = malloc(sizeof(*v) * (strlen(arg) + 1));
+    long n = 0;
+
+    for (char *tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+    {
+        int p = sim_policy_from_name(tok);
+        if (p < 0)
+        {
+            free(copy);
+            free(v);
+            return -1;
+        }
+        v[n++] = (uint64_t)p;
+    }
+    free(copy);
+    *out = v;
+    return n;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-p fifo,sjf,stcf,rr] [-q 1,5,10,20] [-c 1,2,4] [-s 1-10]\n"
+            "          [-n jobs] [-b mean_burst] [-l load] [-w workload] [-j threads] [-o out.col]\n"
+            "       %s -d out.col\n",
+            prog, prog);
+    exit(1);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t *policies, *quanta, *cpus, *seeds;
+    long npol = parse_policies("fifo,sjf,stcf,rr", &policies);
+    long nq = parse_list("1,5,10,20", &quanta);
+    long ncpu = parse_list("1,2,4", &cpus);
+    long nseed = parse_list("1-10", &seeds);
+    const char *out_path = "sweep.col";
+    int opt;
+
+    nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    workload_defaults(&setup.shape);
+    setup.shape.njobs = 10000;
+    setup.load = 0.9;
+
+    while ((opt = getopt(argc, argv, "p:q:c:s:n:b:l:w:j:o:d:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': free(policies); npol = parse_policies(optarg, &policies); break;
+        case 'q': free(quanta); nq = parse_list(optarg, &quanta); break;
+        case 'c': free(cpus); ncpu = parse_list(optarg, &cpus); break;
+        case 's': free(seeds); nseed = parse_list(optarg, &seeds); break;
+        case 'n': setup.shape.njobs = strtoull(optarg, NULL, 10); break;
+        case 'b': setup.shape.mean_burst = atof(optarg); break;
+        case 'l': setup.load = atof(optarg); break;
+        case 'w':
+            if (workload_parse(optarg, &setup.shape) < 0)
+                usage(argv[0]);
+            break;
+        case 'j': nworkers = atoi(optarg); break;
+        case 'o': out_path = optarg; break;
+        case 'd': exit(dump_columns(optarg) < 0 ? 1 : 0);
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || npol <= 0 || nq <= 0 || ncpu <= 0 || nseed <= 0 ||
+        nworkers < 1 || setup.shape.mean_burst <= 0 || !(setup.load > 0 && setup.load < 1))
+        usage(argv[0]);
+    for (long c = 0; c < ncpu; c++)
+        if (cpus[c] < 1 || cpus[c] > SIM_MAX_CPUS)
+            usage(argv[0]);
+    for (long q = 0; q < nq; q++)
+        if (quanta[q] == 0)
+            usage(argv[0]);
+
+    /* Expand the grid. Only RR gets one row per quantum. */
+    tasks = malloc(sizeof(*tasks) * (size_t)(npol * nq * ncpu * nseed));
+    for (long p = 0; p < npol; p++)
+        for (long q = 0; q < (policies[p] == POLICY_RR ? nq : 1); q++)
+            for (long c = 0; c < ncpu; c++)
+                for (long s = 0; s < nseed; s++)
+                    tasks[ntasks++] = (struct sweep_task){
+                        (enum sim_policy)policies[p],
+                        policies[p] == POLICY_RR ? quanta[q] : 0,
+                        (int)cpus[c],
+                        seeds[s],
+                    };
+    results = calloc(ntasks, sizeof(*results));
+    nseeds = (size_t)nseed;
+    pools = malloc(sizeof(*pools) * (ntasks / nseeds));
+    for (size_t p = 0; p < ntasks / nseeds; p++)
+    {
+        pthread_mutex_init(&pools[p].lock, NULL);
+        hdr_init(&pools[p].turnaround);
+    }
+
+    /* Deal the task numbers out in equal contiguous ranges to start with */
+    if ((size_t)nworkers > ntasks)
+        nworkers = (int)ntasks;
+    workers = calloc((size_t)nworkers, sizeof(*workers));
+    for (int w = 0; w < nworkers; w++)
+    {
+        pthread_mutex_init(&workers[w].lock, NULL);
+        workers[w].index = w;
+        workers[w].lo = ntasks * (size_t)w / (size_t)nworkers;
+        workers[w].hi = ntasks * (size_t)(w + 1) / (size_t)nworkers;
+    }
+
+    double start = now_seconds();
+    for (int w = 0; w < nworkers; w++)
+        pthread_create(&workers[w].thread, NULL, worker_main, &workers[w]);
+    for (int w = 0; w < nworkers; w++)
+        pthread_join(workers[w].thread, NULL);
+    double elapsed = now_seconds() - start;
+
+    if (write_columns(out_path) < 0)
+    {
+        fprintf(stderr, "%s: write failed\n", out_path);
+        exit(1);
+    }
+
+    printf("%zu simulations x %llu jobs on %d threads in %.2f s (%.0f simulations/s)\n",
+           ntasks, (unsigned long long)setup.shape.njobs, nworkers, elapsed, ntasks / elapsed);
+
+    /* Print one line per configuration, pooled over seeds */
+    printf("%-6s %8s %5s %15s %14s %10s %10s\n", "policy", "quantum", "cpus",
+           "avg turnaround", "avg response", "p50 turn", "p99 turn");
+    for (size_t i = 0; i < ntasks; i += nseeds)
+    {
+        const struct hdr_hist *h = &pools[i / nseeds].turnaround;
+        double resp = 0;
+        for (size_t s = 0; s < nseeds; s++)
+            resp += results[i + s].avg_response;
+        printf("%-6s %8llu %5d %15.2f %14.2f %10llu %10llu\n", sim_policy_names[tasks[i].policy],
+               (unsigned long long)tasks[i].quantum, tasks[i].ncpus, hdr_mean(h), resp / nseed,
+               (unsigned long long)hdr_percentile(h, 50.0),
+               (unsigned long long)hdr_percentile(h, 99.0));
+    }
+    printf("results: %s\n", out_path);
+
+    free(policies);
+    free(quanta);
+    free(cpus);
+    free(seeds);
+    free(tasks);
+    free(results);
+    free(pools);
+    free(workers);
+    exit(0);
+}
@@ -0,0 +1,639 @@
+/*
+ * PROGRAM: sched_whatif.c - "What if this one job were different?" in milliseconds
+ *
+ * fifo-convoy-effect.html asks: what if job A (burst 80) were shorter, or
+ * arrived later? With sched_sim that means editing the trace and running
+ * everything again - seconds for a million jobs, for a change that only
+ * matters around one job.
+ *
+ * This tool runs the trace ONCE, saving CHECKPOINTS of the whole simulator
+ * state along the way. Each edit then:
+ *
+ *   1. restores the last checkpoint taken before the edited job arrived,
+ *   2. replays forward with the edited job,
+ *   3. stops as soon as the system is EMPTY (no job running, waiting or
+ *      doing I/O) at a point where the original run was empty too, with
+ *      the same next job about to arrive. From there on both runs are
+ *      identical, so the rest of the answer is copied from the original
+ *      run instead of being simulated again.
+ *
+ *     original:  |--ck0--|--ck1--|--ck2--|--ck3--|--ck4--|-- ... --| end
+ *     edit job in ck1..ck2:     restore ck1
+ *                                |=== replay ===|  rejoin at ck3 (both idle)
+ *     answer = replay up to ck3 + (original end - original at ck3)
+ *
+ * Checkpoints are preferably taken when the system is empty, so a rejoin
+ * point is usually just one checkpoint away. Under overload (load > 1)
+ * the system may never empty, and the replay simply runs to the end -
+ * still correct, just not faster.
+ *
+ * MOVING A JOB:
+ * Changing a job's arrival from t=100 to t=900000 takes it out of the
+ * trace in one place and puts it back in another. In between, the edited
+ * trace is the original minus one job, so once the replay is idle there
+ * it can JUMP to the original run's last checkpoint before the job's new
+ * arrival, and only replay again from there.
+ *
+ * USAGE:
+ *     sched_whatif [-p policy] [-q quantum] [-c cpus] [-k events] [-x] trace.bin
+ *
+ *     -k  events between checkpoints (default 100000)
+ *     -x  also re-run every edit from scratch and check the answers match
+ *
+ * Then type edits on stdin, one per line. Each is a what-if against the
+ * ORIGINAL trace (edits do not pile up):
+ *
+ *     burst 17 500       job 17 needs 500 units of CPU
+ *     arrival 17 9000    job 17 arrives at t = 9000
+ *
+ * EXAMPLE:
+ *     ./trace_convert jobs convoy_jobs.js convoy.bin
+ *     echo "burst 0 20" | ./sched_whatif -p fifo convoy.bin
+ *     -> A shrinks from 80 to 20 and the convoy disappears
+ *     echo "arrival 0 1000" | ./sched_whatif -x -k 1 convoy.bin
+ *     -> A moves past the last arrival; -x checks it against a full re-run
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o sched_whatif sched_whatif.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> /* getopt() */
+#include <time.h>   /* clock_gettime() */
+
+#include "job_trace.h"
+#include "sched_sim.h"
+
+/* ======================================================================
+ * THE TRACE AFTER ONE EDIT
+ *
+ * The edited job is taken out of its old position and put back where its
+ * new arrival time belongs. Nothing is copied - every record is read from
+ * the mmap'd trace on demand.
+ * ====================================================================== */
+
+struct edit_source
+{
+    const struct job_trace *trace;
+    uint64_t edit_index;       /* Old position of the edited job (UINT64_MAX: no edit) */
+    uint64_t insert_at;        /* Its position in the edited order */
+    struct job_record edited;
+    uint64_t pos;              /* Records handed out so far */
+};
+
+static int edit_next(void *ctx, struct job_record *out)
+{
+    struct edit_source *e = ctx;
+    uint64_t p = e->pos;
+
+    if (p == e->trace->count)
+        return 0;
+    e->pos++;
+    if (p == e->insert_at)
+    {
+        *out = e->edited;
+        return 1;
+    }
+    if (p > e->insert_at)
+        p--; /* The edited job took a slot before us */
+    if (p >= e->edit_index)
+        p++; /* Skip the edited job's old slot */
+    job_trace_get(e->trace, p, out);
+    return 1;
+}
+
+/* Number of records with arrival <= t (the trace is sorted by arrival) */
+static uint64_t count_arrived_by(const struct job_trace *t, uint64_t time)
+{
+    uint64_t lo = 0, hi = t->count;
+    struct job_record r;
+
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        job_trace_get(t, mid, &r);
+        if (r.arrival <= time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void edit_init(struct edit_source *e, const struct job_trace *t, uint64_t index,
+                      const struct job_record *edited)
+{
+    struct job_record old;
+
+    memset(e, 0, sizeof(*e));
+    e->trace = t;
+    e->edit_index = e->insert_at = UINT64_MAX;
+    if (index == UINT64_MAX)
+        return;
+
+    job_trace_get(t, index, &old);
+    e->edit_index = index;
+    e->edited = *edited;
+    if (edited->arrival == old.arrival)
+        e->insert_at = index; /* Same place, different burst */
+    else if (edited->arrival < old.arrival)
+        e->insert_at = count_arrived_by(t, edited->arrival);
+    else
+        e->insert_at = count_arrived_by(t, edited->arrival) - 1; /* Minus its old self */
+}
+
+/* ======================================================================
+ * CHECKPOINTS
+ * ====================================================================== */
+
+/* Smallest and largest turnaround, response and wait over a set of jobs */
+struct extremes
+{
+    uint64_t min[3], max[3];
+};
+
+static void extremes_clear(struct extremes *x)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        x->min[i] = UINT64_MAX;
+        x->max[i] = 0;
+    }
+}
+
+static void extremes_add(struct extremes *x, int i, uint64_t v)
+{
+    if (v < x->min[i])
+        x->min[i] = v;
+    if (v > x->max[i])
+        x->max[i] = v;
+}
+
+struct checkpoint
+{
+    struct sim sim;           /* Everything, with private copies of the arrays */
+    uint64_t consumed;        /* Records the source had handed out */
+    int idle;                 /* No job in the system, only the next arrival */
+    struct extremes interval; /* Jobs completed between here and the next checkpoint */
+};
+
+static void *dup_array(const void *p, size_t bytes)
+{
+    if (p == NULL || bytes == 0)
+        return NULL;
+    void *q = malloc(bytes);
+    memcpy(q, p, bytes);
+    return q;
+}
+
+/* Deep copy of the simulator. Only the binary-heap event queue is supported. */
+static void sim_copy(struct sim *dst, const struct sim *src)
+{
+    *dst = *src;
+    dst->jobs = dup_array(src->jobs, src->njobs * sizeof(*src->jobs));
+    dst->ready.slot = dup_array(src->ready.slot, src->ready.cap * sizeof(uint32_t));
+    dst->blocked.slot = dup_array(src->blocked.slot, src->blocked.cap * sizeof(uint32_t));
+    dst->events.heap = dup_array(src->events.heap, src->events.cap * sizeof(struct sim_event));
+}
+
+static int sim_idle(const struct sim *s)
+{
+    if (s->ready.len > 0 || s->blocked.len > 0 || s->io_job != SIM_NONE)
+        return 0;
+    for (int c = 0; c < s->cfg.ncpus; c++)
+        if (s->cpu[c].running != SIM_NONE)
+            return 0;
+    return 1;
+}
+
+static struct sim_config cfg = {POLICY_FIFO, 10, 1, EVQ_HEAP};
+static struct job_trace trace;
+static struct checkpoint *ckpts;
+static size_t nckpts, ckpt_cap;
+static struct sim_stats original;   /* Final stats of the unedited run */
+static uint64_t original_events;
+static struct extremes interval;    /* Jobs completed since the last checkpoint */
+
+static void track_completion(void *arg, const struct sim_job *job, uint64_t finish)
+{
+    (void)arg;
+    uint64_t turnaround = finish - job->rec.arrival;
+    extremes_add(&interval, 0, turnaround);
+    extremes_add(&interval, 1, job->first_run - job->rec.arrival);
+    extremes_add(&interval, 2, turnaround - job->rec.burst - job->blocked);
+}
+
+static void take_checkpoint(const struct sim *s, uint64_t consumed)
+{
+    if (nckpts == ckpt_cap)
+    {
+        ckpt_cap = ckpt_cap ? 2 * ckpt_cap : 64;
+        ckpts = realloc(ckpts, ckpt_cap * sizeof(*ckpts));
+    }
+    if (nckpts > 0)
+        ckpts[nckpts - 1].interval = interval;
+    extremes_clear(&interval);
+
+    struct checkpoint *ck = &ckpts[nckpts++];
+    sim_copy(&ck->sim, s);
+    ck->sim.on_complete = NULL;
+    ck->consumed = consumed;
+    ck->idle = sim_idle(s);
+}
+
+/*
+ * The original run. A checkpoint is due every 'every' events; we wait a
+ * little for the system to become idle (a possible rejoin point), but
+ * take it anyway after twice the interval.
+ */
+static int run_original(uint64_t every)
+{
+    struct edit_source src;
+    struct sim s;
+    uint64_t since = 0;
+
+    edit_init(&src, &trace, UINT64_MAX, NULL);
+    sim_init(&s, &cfg, (struct job_source){edit_next, &src});
+    s.on_complete = track_completion;
+    extremes_clear(&interval);
+    take_checkpoint(&s, src.pos);
+
+    while (sim_step(&s))
+    {
+        original_events++;
+        if (++since >= every && (since >= 2 * every || sim_idle(&s)))
+        {
+            take_checkpoint(&s, src.pos);
+            since = 0;
+        }
+    }
+    if (s.error)
+    {
+        fprintf(stderr, "%s\n", s.error);
+        return -1;
+    }
+    ckpts[nckpts - 1].interval = interval;
+
+    original = s.stats;
+    sim_free(&s);
+    return 0;
+}
+
+/* ======================================================================
+ * REPLAY
+ * ====================================================================== */
+
+/* First checkpoint that had consumed at least c records (nckpts if none) */
+static size_t ckpt_search(uint64_t c)
+{
+    size_t lo = 0, hi = nckpts;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ckpts[mid].consumed < c)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * An idle checkpoint that had consumed exactly c records and is waiting
+ * for the last of them to arrive, or nckpts. consumed == trace.count
+ * alone cannot tell "the last job is still to come" from "the trace is
+ * used up": a checkpoint of the second kind never reads again, so it is
+ * no place to rejoin or jump to.
+ */
+static size_t ckpt_idle_at(uint64_t c)
+{
+    for (size_t k = ckpt_search(c); k < nckpts && ckpts[k].consumed == c; k++)
+        if (ckpts[k].idle && ckpts[k].sim.have_pending)
+            return k;
+    return nckpts;
+}
+
+static void hist_advance(struct hdr_hist *dst, const struct hdr_hist *to,
+                         const struct hdr_hist *from, uint64_t min, uint64_t max)
+{
+    for (unsigned b = 0; b < HDR_BUCKETS; b++)
+        dst->counts[b] += to->counts[b] - from->counts[b];
+    dst->count += to->count - from->count;
+    dst->sum += to->sum - from->sum;
+    if (to->count > from->count)
+    {
+        if (min < dst->min)
+            dst->min = min;
+        if (max > dst->max)
+            dst->max = max;
+    }
+}
+
+/*
+ * st += what the original run did between checkpoint a and checkpoint b
+ * (b == nckpts: the end of the run). Sums and histogram counters simply
+ * subtract; the smallest and largest values come from the intervals.
+ */
+static void stats_advance(struct sim_stats *st, size_t a, size_t b)
+{
+    const struct sim_stats *from = &ckpts[a].sim.stats;
+    const struct sim_stats *to = b < nckpts ? &ckpts[b].sim.stats : &original;
+    struct extremes x;
+
+    extremes_clear(&x);
+    for (size_t k = a; k < b; k++)
+        for (int i = 0; i < 3; i++)
+        {
+            /* No job finished in this interval: it still holds the cleared values */
+            if (ckpts[k].interval.max[i] < ckpts[k].interval.min[i])
+                continue;
+            extremes_add(&x, i, ckpts[k].interval.min[i]);
+            extremes_add(&x, i, ckpts[k].interval.max[i]);
+        }
+
+    if (to->jobs > from->jobs)
+        st->makespan = to->makespan;
+    st->jobs += to->jobs - from->jobs;
+    st->sum_turnaround += to->sum_turnaround - from->sum_turnaround;
+    st->sum_response += to->sum_response - from->sum_response;
+    st->sum_wait += to->sum_wait - from->sum_wait;
+    st->sum_blocked += to->sum_blocked - from->sum_blocked;
+    st->cpu_busy += to->cpu_busy - from->cpu_busy;
+    st->io_busy += to->io_busy - from->io_busy;
+    st->io_requests += to->io_requests - from->io_requests;
+    hist_advance(&st->turnaround, &to->turnaround, &from->turnaround, x.min[0], x.max[0]);
+    hist_advance(&st->response, &to->response, &from->response, x.min[1], x.max[1]);
+    hist_advance(&st->wait, &to->wait, &from->wait, x.min[2], x.max[2]);
+}
+
+struct replay_info
+{
+    uint64_t from, to;  /* Simulated time replayed */
+    uint64_t events;    /* Events simulated */
+    uint64_t skipped;   /* Simulated time jumped over while the job was away */
+    int rejoined;       /* 0 if we had to run to the end */
+};
+
+static int whatif(struct edit_source *src, struct sim_stats *out, struct replay_info *info)
+{
+    uint64_t ei = src->edit_index, ia = src->insert_at;
+    uint64_t first = ei < ia ? ei : ia; /* First record that differs from the original */
+    uint64_t last = ei < ia ? ia : ei;  /* Last one */
+    struct sim s;
+
+    /*
+     * Between the old and the new position, edited record q is original
+     * record q + shift. 'jump_limit' is the most records the original may
+     * have read at the checkpoint we jump to: the record that differs next
+     * (the job's new or old slot) must still be unread.
+     */
+    int64_t shift = ia > ei ? 1 : -1;
+    uint64_t shift_lo = ia > ei ? ei : ia + 1, shift_hi = ia > ei ? ia - 1 : ei;
+    uint64_t jump_limit = ia > ei ? ia + 1 : ei;
+    int jumped = ia == ei;
+
+    /* Latest checkpoint that had not read the first differing record yet */
+    size_t k = nckpts;
+    while (k > 0 && ckpts[k - 1].consumed > first)
+        k--;
+    if (k == 0)
+        sim_init(&s, &cfg, (struct job_source){edit_next, src});
+    else
+    {
+        sim_copy(&s, &ckpts[k - 1].sim);
+        s.src = (struct job_source){edit_next, src};
+        src->pos = ckpts[k - 1].consumed;
+    }
+    memset(info, 0, sizeof(*info));
+    info->from = s.now;
+
+    while (sim_step(&s))
+    {
+        info->events++;
+        if (!s.have_pending)
+            continue; /* Every job has arrived: only the end is left to run */
+        uint64_t pending = src->pos - 1; /* Position of the job read but not yet arrived */
+
+        /* Inside the moved-over stretch: try to jump to the far end */
+        if (!jumped && pending >= shift_lo && pending <= shift_hi && sim_idle(&s))
+        {
+            size_t j = ckpt_idle_at(src->pos + (uint64_t)shift);
+            size_t m = ckpt_search(jump_limit + 1);
+            /* The moved job is still to be read: the original must still be reading too */
+            while (m > 0 && !ckpts[m - 1].sim.have_pending)
+                m--;
+            if (j < nckpts && m-- > 0 && m > j)
+            {
+                struct sim_stats st = s.stats;
+                stats_advance(&st, j, m);
+                info->skipped += ckpts[m].sim.now - s.now;
+                sim_free(&s);
+                sim_copy(&s, &ckpts[m].sim);
+                s.stats = st;
+                s.src = (struct job_source){edit_next, src};
+                src->pos = ckpts[m].consumed - (uint64_t)shift;
+                jumped = 1;
+            }
+            continue;
+        }
+
+        /* Past the edit: rejoin once both runs wait for the same job */
+        if (pending > last && sim_idle(&s))
+        {
+            size_t j = ckpt_idle_at(src->pos);
+            if (j < nckpts)
+            {
+                stats_advance(&s.stats, j, nckpts);
+                info->rejoined = 1;
+                break;
+            }
+        }
+    }
+    info->to = s.now;
+    if (s.error)
+    {
+        fprintf(stderr, "%s\n", s.error);
+        sim_free(&s);
+        return -1;
+    }
+    *out = s.stats;
+    sim_free(&s);
+    return 0;
+}
+
+/* ======================================================================
+ * COMMAND LINE
+ * ====================================================================== */
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_stats(const char *label, const struct sim_stats *st, const struct sim_stats *was)
+{
+    double n = st->jobs ? (double)st->jobs : 1.0;
+    double wn = was->jobs ? (double)was->jobs : 1.0;
+    printf("  %-24s %12.2f  (was %.2f)\n", label, st->sum_turnaround / n, was->sum_turnaround / wn);
+    printf("  %-24s %12.2f  (was %.2f)\n", "average response:", st->sum_response / n,
+           was->sum_response / wn);
+    printf("  %-24s %12llu  (was %llu)\n", "p99 turnaround:",
+           (unsigned long long)hdr_percentile(&st->turnaround, 99.0),
+           (unsigned long long)hdr_percentile(&was->turnaround, 99.0));
+    printf("  %-24s %12llu  (was %llu)\n", "makespan:", (unsigned long long)st->makespan,
+           (unsigned long long)was->makespan);
+}
+
+static int same_hist(const struct hdr_hist *a, const struct hdr_hist *b)
+{
+    return a->count == b->count && a->sum == b->sum && a->min == b->min && a->max == b->max &&
+           memcmp(a->counts, b->counts, sizeof(a->counts)) == 0;
+}
+
+/* Everything stats_advance() splices together */
+static int same_stats(const struct sim_stats *a, const struct sim_stats *b)
+{
+    return a->jobs == b->jobs && a->sum_turnaround == b->sum_turnaround &&
+           a->sum_response == b->sum_response && a->sum_wait == b->sum_wait &&
+           a->sum_blocked == b->sum_blocked && a->cpu_busy == b->cpu_busy &&
+           a->io_busy == b->io_busy && a->io_requests == b->io_requests &&
+           a->makespan == b->makespan && same_hist(&a->turnaround, &b->turnaround) &&
+           same_hist(&a->response, &b->response) && same_hist(&a->wait, &b->wait);
+}
+
+/* Find the record with this job id: usually id == position */
+static uint64_t find_job(uint32_t id)
+{
+    struct job_record r;
+    if (id < trace.count)
+    {
+        job_trace_get(&trace, id, &r);
+        if (r.id == id)
+            return id;
+    }
+    for (uint64_t i = 0; i < trace.count; i++)
+    {
+        job_trace_get(&trace, i, &r);
+        if (r.id == id)
+            return i;
+    }
+    return UINT64_MAX;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-p fifo|sjf|stcf|rr] [-q quantum] [-c cpus] [-k events] [-x] trace.bin\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t every = 100000;
+    int verify = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:q:c:k:x")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+        {
+            int p = sim_policy_from_name(optarg);
+            if (p < 0)
+                usage(argv[0]);
+            cfg.policy = (enum sim_policy)p;
+            break;
+        }
+        case 'q': cfg.quantum = strtoull(optarg, NULL, 10); break;
+        case 'c': cfg.ncpus = atoi(optarg); break;
+        case 'k': every = strtoull(optarg, NULL, 10); break;
+        case 'x': verify = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || cfg.quantum == 0 || every == 0 || cfg.ncpus < 1 ||
+        cfg.ncpus > SIM_MAX_CPUS)
+        usage(argv[0]);
+    if (job_trace_open(&trace, argv[optind]) < 0)
+        exit(1);
+    madvise((void *)trace.base, trace.size, MADV_NORMAL); /* We jump around */
+
+    double t0 = now_seconds();
+    if (run_original(every) < 0)
+        exit(1);
+    printf("original run: %llu jobs, %llu events, %zu checkpoints in %.3f s\n",
+           (unsigned long long)original.jobs, (unsigned long long)original_events, nckpts,
+           now_seconds() - t0);
+    fflush(stdout);
+
+    char line[256], what[32];
+    unsigned id;
+    unsigned long long value;
+    while (fgets(line, sizeof(line), stdin))
+    {
+        if (sscanf(line, "%31s %u %llu", what, &id, &value) != 3 ||
+            (strcmp(what, "burst") != 0 && strcmp(what, "arrival") != 0))
+        {
+            if (line[0] != '\n' && line[0] != '#')
+                fprintf(stderr, "expected: burst ID VALUE | arrival ID VALUE\n");
+            continue;
+        }
+        uint64_t index = find_job(id);
+        if (index == UINT64_MAX)
+        {
+            fprintf(stderr, "no job with id %u\n", id);
+            continue;
+        }
+
+        struct job_record r;
+        job_trace_get(&trace, index, &r);
+        printf("job %u: %s %llu -> %llu\n", id, what,
+               (unsigned long long)(what[0] == 'b' ? r.burst : r.arrival), value);
+        if (what[0] == 'b')
+            r.burst = value ? value : 1;
+        else
+            r.arrival = value;
+
+        struct edit_source src;
+        struct sim_stats st;
+        struct replay_info info;
+        edit_init(&src, &trace, index, &r);
+
+        double start = now_seconds();
+        if (whatif(&src, &st, &info) < 0)
+            continue;
+        double elapsed = now_seconds() - start;
+
+        printf("  replayed %llu events from t=%llu to t=%llu", (unsigned long long)info.events,
+               (unsigned long long)info.from, (unsigned long long)info.to);
+        if (info.skipped)
+            printf(" (jumped over %llu)", (unsigned long long)info.skipped);
+        printf(", %s in %.3f ms\n", info.rejoined ? "rejoined the original run" : "ran to the end",
+               elapsed * 1e3);
+        print_stats("average turnaround:", &st, &original);
+
+        if (verify)
+        {
+            struct sim full;
+            edit_init(&src, &trace, index, &r);
+            start = now_seconds();
+            sim_init(&full, &cfg, (struct job_source){edit_next, &src});
+            sim_run(&full);
+            printf("  full re-run: %.3f ms, %s\n", (now_seconds() - start) * 1e3,
+                   same_stats(&full.stats, &st) ? "same answer" : "MISMATCH");
+            sim_free(&full);
+        }
+        fflush(stdout);
+    }
+
+    for (size_t k = 0; k < nckpts; k++)
+        sim_free(&ckpts[k].sim);
+    free(ckpts);
+    job_trace_close(&trace);
+    exit(0);
+}
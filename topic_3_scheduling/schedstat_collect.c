@@ -0,0 +1,407 @@
+/*
+ * PROGRAM: schedstat_collect.c - Where did each child's turnaround go?
+ *
+ * USAGE:
+ *     schedstat_collect [-i interval_ms] [-c cpu] [-j slots] [-o timeline.csv] [-n]
+ *                       [commands_file]
+ *
+ * fifo-convoy-effect.html splits a job's life into time it RUNS and time
+ * it WAITS for the CPU. A real process has a third state: it SLEEPS,
+ * blocked on a disk, a pipe, a timer. The kernel keeps the first two for
+ * every task in /proc/<pid>/schedstat:
+ *
+ *     run_ns    time on a CPU
+ *     wait_ns   time RUNNABLE but sitting in a run queue
+ *     slices    how many times it was put on a CPU
+ *
+ * and the third is whatever is left:
+ *
+ *     turnaround = running + runnable-waiting + sleeping
+ *
+ * This program starts each command (one per line) with the fork() + exec()
+ * + wait() pattern of fork_wait_exec.c, through job_spawn.h, and prints
+ * that split per child - the real-world version of the demo's waiting
+ * times.
+ *
+ * HOW IT WORKS:
+ * One SAMPLER THREAD wakes up every 'interval_ms' and reads the schedstat
+ * of every live task in one sweep. A task's files are opened once, when
+ * it is first seen, and re-read with pread() at offset 0, so a sweep is a
+ * couple of system calls per task - no open()/close(), no path lookups.
+ *
+ * A command is usually more than one task: "sh -c cmd" forks cmd and
+ * waits, and pipelines fork one task per stage. So each job is a TREE:
+ * the sweep also re-reads every task's /proc/<pid>/task/<pid>/children
+ * and adopts tasks it has not seen. When a task exits, its last sample is
+ * kept; the time it ran since that sample (at most one interval) is lost,
+ * as is a task that lives less than one interval. The job's own child is
+ * the exception: its totals are exact (see below).
+ *
+ * The main thread waits for children. The last sample must be taken
+ * BEFORE the child is reaped, since reaping removes /proc/<pid>. So it
+ * first waits with waitid(WNOWAIT), which reports the exit but leaves a
+ * zombie; the zombie's statistics are final, the main thread reads them
+ * once more, and only then reaps it with wait4(). The totals are exact;
+ * the periodic samples give the timeline (-o) of how each child got there.
+ *
+ * Use -c to pin everything to one CPU: with several CPU-bound commands on
+ * one CPU, the runnable-waiting column is the convoy. -j limits how many
+ * commands run at once (default: all of them).
+ *
+ * The split is per job: running and runnable-waiting are summed over the
+ * tree, and sleeping is what is left of the turnaround. That is exact for
+ * a tree that does one thing at a time, like a shell running its commands
+ * one after another; when tasks of one job run in parallel, their time
+ * can add up to more than the turnaround and sleeping reads 0.
+ *
+ * EXAMPLE:
+ *     printf '%s\n' 'awk "BEGIN{for(i=0;i<3e7;i++);}"' 'sleep 0.5' \
+ *         'awk "BEGIN{for(i=0;i<1e7;i++);}"' | ./schedstat_collect -c 0
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -pthread -o schedstat_collect schedstat_collect.c
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h> /* The sampler thread */
+#include <sched.h>   /* sched_setaffinity() */
+
+#include "job_spawn.h"
+
+/* One process of a job's tree */
+struct task
+{
+    pid_t pid;
+    int stat_fd;                 /* /proc/<pid>/schedstat; -1 once it is gone */
+    int children_fd;             /* /proc/<pid>/task/<pid>/children */
+    unsigned long long run, wait, slices; /* Latest sample */
+};
+
+struct job
+{
+    const char *cmd;
+    pid_t pid;                   /* 0 = not started */
+    int done;
+    int status;
+    double start, end;           /* Seconds after t0 */
+    struct task *tasks;          /* tasks[0] is the child itself */
+    int ntasks, max_tasks;
+    unsigned long long run, wait, slices; /* Sums over the tasks */
+    unsigned long long samples;
+};
+
+struct collector
+{
+    struct job *jobs;
+    int njobs, started, running, done;
+    int slots;
+    int quiet;
+    double t0;
+    double interval;             /* Seconds */
+    FILE *timeline;              /* -o, or NULL */
+
+    pthread_mutex_t lock;        /* Protects everything above and below */
+    int stop;
+    unsigned long long sweeps;
+    double sweep_time;           /* Seconds spent inside sweeps */
+};
+
+static int task_add(struct job *j, pid_t pid)
+{
+    if (j->ntasks == j->max_tasks)
+    {
+        int max = j->max_tasks ? 2 * j->max_tasks : 8;
+        struct task *bigger = realloc(j->tasks, sizeof(*bigger) * (size_t)max);
+        if (bigger == NULL)
+            return -1;
+        j->tasks = bigger;
+        j->max_tasks = max;
+    }
+    struct task *t = &j->tasks[j->ntasks];
+    memset(t, 0, sizeof(*t));
+    t->pid = pid;
+    /* The files name the task, not the program: they survive its exec() */
+    if ((t->stat_fd = job_schedstat_open(pid)) < 0)
+        return -1;
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/children", (int)pid, (int)pid);
+    t->children_fd = open(path, O_RDONLY | O_CLOEXEC);
+    j->ntasks++;
+    return 0;
+}
+
+static void task_close(struct task *t)
+{
+    close(t->stat_fd);
+    if (t->children_fd >= 0)
+        close(t->children_fd);
+    t->stat_fd = t->children_fd = -1;
+}
+
+/* Adopt the children of task k that we have not seen yet */
+static void task_adopt_children(struct job *j, int k)
+{
+    char buf[4096];
+    if (j->tasks[k].children_fd < 0)
+        return;
+    ssize_t len = pread(j->tasks[k].children_fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return;
+    buf[len] = '\0';
+
+    char *p = buf, *end;
+    long pid;
+    while ((pid = strtol(p, &end, 10)) > 0)
+    {
+        p = end;
+        int known = 0;
+        /* Only live entries count: a dead task's pid may have been reused */
+        for (int i = 0; i < j->ntasks && !known; i++)
+            known = j->tasks[i].stat_fd >= 0 && j->tasks[i].pid == (pid_t)pid;
+        if (!known)
+            task_add(j, (pid_t)pid);
+    }
+}
+
+/* Caller holds the lock */
+static void sample(struct collector *c, struct job *j, double t)
+{
+    /* New tasks are appended, so this also samples the ones just adopted */
+    for (int k = 0; k < j->ntasks; k++)
+    {
+        struct task *task = &j->tasks[k];
+        if (task->stat_fd < 0)
+            continue;
+        unsigned long long run, wait, slices;
+        if (job_schedstat_fd(task->stat_fd, &run, &wait, &slices) < 0)
+        {
+            task_close(task); /* Gone: keep its last sample */
+            continue;
+        }
+        task->run = run;
+        task->wait = wait;
+        task->slices = slices;
+        task_adopt_children(j, k);
+    }
+
+    j->run = j->wait = j->slices = 0;
+    for (int k = 0; k < j->ntasks; k++)
+    {
+        j->run += j->tasks[k].run;
+        j->wait += j->tasks[k].wait;
+        j->slices += j->tasks[k].slices;
+    }
+    j->samples++;
+    if (c->timeline)
+    {
+        double life = t - j->start;
+        double sleep = life - (double)(j->run + j->wait) / 1e9;
+        fprintf(c->timeline, "%.6f,%d,%d,%.3f,%.3f,%.3f,%llu\n", t, (int)(j - c->jobs),
+                j->ntasks, (double)j->run / 1e6, (double)j->wait / 1e6,
+                sleep > 0 ? sleep * 1e3 : 0.0, j->slices);
+    }
+}
+
+static void *sampler_main(void *arg)
+{
+    struct collector *c = arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    long step = (long)(c->interval * 1e9);
+
+    for (;;)
+    {
+        next.tv_nsec += step;
+        while (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        /* Absolute deadlines: a slow sweep does not push the next one back */
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+            ;
+
+        pthread_mutex_lock(&c->lock);
+        if (c->stop)
+        {
+            pthread_mutex_unlock(&c->lock);
+            return NULL;
+        }
+        double begin = job_now();
+        double t = begin - c->t0;
+        for (int k = 0; k < c->started; k++)
+            if (!c->jobs[k].done)
+                sample(c, &c->jobs[k], t);
+        c->sweeps++;
+        c->sweep_time += job_now() - begin;
+        pthread_mutex_unlock(&c->lock);
+    }
+}
+
+/* Caller holds the lock */
+static void start_jobs(struct collector *c)
+{
+    while (c->started < c->njobs && (c->slots == 0 || c->running < c->slots))
+    {
+        struct job *j = &c->jobs[c->started];
+        j->start = job_now() - c->t0;
+        if ((j->pid = job_spawn(j->cmd, c->quiet)) < 0)
+            exit(1);
+        if (task_add(j, j->pid) < 0)
+            perror("schedstat");
+        c->started++;
+        c->running++;
+    }
+}
+
+/* Wait for one child to exit, take its final sample, then reap it */
+static void collect_one(struct collector *c)
+{
+    siginfo_t si;
+    memset(&si, 0, sizeof(si));
+    if (waitid(P_ALL, 0, &si, WEXITED | WNOWAIT) < 0)
+    {
+        if (errno == EINTR)
+            return;
+        perror("waitid");
+        exit(1);
+    }
+    pid_t pid = si.si_pid;
+    double end = job_now() - c->t0;
+
+    pthread_mutex_lock(&c->lock);
+    for (int k = 0; k < c->started; k++)
+    {
+        struct job *j = &c->jobs[k];
+        if (j->pid != pid || j->done)
+            continue;
+        sample(c, j, end);
+        for (int i = 0; i < j->ntasks; i++)
+            if (j->tasks[i].stat_fd >= 0)
+                task_close(&j->tasks[i]);
+        j->end = end;
+        j->done = 1;
+        c->running--;
+        c->done++;
+        if (waitpid(pid, &j->status, 0) < 0)
+            perror("waitpid");
+        break;
+    }
+    start_jobs(c);
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-i interval_ms] [-c cpu] [-j slots] [-o timeline.csv] [-n]"
+                    " [commands_file]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct collector c = {0};
+    double interval_ms = 10;
+    int cpu = -1;
+    const char *timeline = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:c:j:o:n")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i': interval_ms = atof(optarg); break;
+        case 'c': cpu = atoi(optarg); break;
+        case 'j': c.slots = atoi(optarg); break;
+        case 'o': timeline = optarg; break;
+        case 'n': c.quiet = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (argc - optind > 1 || interval_ms <= 0 || c.slots < 0)
+        usage(argv[0]);
+    c.interval = interval_ms / 1000.0;
+
+    FILE *fp = stdin;
+    if (optind < argc && (fp = fopen(argv[optind], "r")) == NULL)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    char **cmds;
+    c.njobs = job_list_read(fp, &cmds);
+    if (c.njobs <= 0)
+    {
+        fprintf(stderr, "no commands to run\n");
+        return 1;
+    }
+    c.jobs = calloc((size_t)c.njobs, sizeof(*c.jobs));
+    for (int k = 0; k < c.njobs; k++)
+        c.jobs[k].cmd = cmds[k];
+
+    if (timeline != NULL)
+    {
+        if ((c.timeline = fopen(timeline, "w")) == NULL)
+        {
+            perror(timeline);
+            return 1;
+        }
+        fprintf(c.timeline, "t,job,tasks,run_ms,wait_ms,sleep_ms,slices\n");
+    }
+
+    if (cpu >= 0)
+    {
+        /* Before the sampler and the children exist, so they inherit it */
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0)
+        {
+            perror("sched_setaffinity");
+            return 1;
+        }
+    }
+
+    pthread_mutex_init(&c.lock, NULL);
+    c.t0 = job_now();
+    pthread_mutex_lock(&c.lock);
+    start_jobs(&c);
+    pthread_mutex_unlock(&c.lock);
+
+    pthread_t sampler;
+    pthread_create(&sampler, NULL, sampler_main, &c);
+    while (c.done < c.njobs)
+        collect_one(&c);
+
+    pthread_mutex_lock(&c.lock);
+    c.stop = 1;
+    pthread_mutex_unlock(&c.lock);
+    pthread_join(sampler, NULL);
+    if (c.timeline)
+        fclose(c.timeline);
+
+    printf("%4s %11s %10s %10s %10s %8s %6s %8s  %s\n", "job", "turnaround", "running",
+           "runnable", "sleeping", "slices", "tasks", "samples", "command");
+    double sum[4] = {0};
+    for (int k = 0; k < c.njobs; k++)
+    {
+        struct job *j = &c.jobs[k];
+        double turnaround = j->end - j->start;
+        double run = (double)j->run / 1e9, wait = (double)j->wait / 1e9;
+        double sleep = turnaround - run - wait;
+        if (sleep < 0) /* Tasks of the job ran in parallel */
+            sleep = 0;
+        printf("%4d %10.3fs %9.3fs %9.3fs %9.3fs %8llu %6d %8llu  %s\n", k, turnaround, run,
+               wait, sleep, j->slices, j->ntasks, j->samples, j->cmd);
+        sum[0] += turnaround;
+        sum[1] += run;
+        sum[2] += wait;
+        sum[3] += sleep;
+    }
+    printf("%4s %10.3fs %9.3fs %9.3fs %9.3fs\n", "avg", sum[0] / c.njobs, sum[1] / c.njobs,
+           sum[2] / c.njobs, sum[3] / c.njobs);
+    printf("\n%llu sweeps, %.1f us per sweep\n", c.sweeps,
+           c.sweeps ? c.sweep_time / (double)c.sweeps * 1e6 : 0.0);
+    return 0;
+}
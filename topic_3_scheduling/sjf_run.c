@@ -0,0 +1,381 @@
+/*
+ * PROGRAM: sjf_run.c - Shortest Job First for real commands, with predicted bursts
+ *
+ * USAGE:
+ *     sjf_run [-j slots] [-H history_file] [-a alpha] [-d default_s] [-p] [-n]
+ *             [commands_file]
+ *
+ * fifo-convoy-effect.html shows SJF cutting the average turnaround of the
+ * convoy from 107 to 48 - but SJF needs to know every job's burst in
+ * advance, and real commands do not come with one. The classic answer is
+ * to PREDICT the next burst from the past ones with an exponentially
+ * weighted moving average:
+ *
+ *     predicted(n+1) = alpha * actual(n) + (1 - alpha) * predicted(n)
+ *
+ * With alpha = 0.5 (the default) the last run counts for half, the one
+ * before for a quarter, and so on: recent history dominates, but one odd
+ * run does not throw the estimate off completely.
+ *
+ * This program reads shell commands, one per line (stdin if no file is
+ * given), sorts them by predicted run time and runs them with at most
+ * 'slots' at a time (default 1), shortest first and NON-PREEMPTIVE - the
+ * SJF of the demo. After each command exits, its measured wall-clock time
+ * is folded into the prediction. A command never seen before is predicted
+ * to take 'default_s' seconds (default 0: run it early, so we learn).
+ *
+ * THE HISTORY FILE:
+ * Predictions must survive from one night to the next, so they live in a
+ * small file (default ~/.sjf_history) that we mmap() with MAP_SHARED:
+ * updating a prediction is a plain store into memory, and the kernel
+ * writes the page back to the file. The file is a fixed-size hash table
+ * keyed by a 64-bit hash of the command text:
+ *
+ *     +--------------------------+
+ *     | header (32 bytes)        |   magic "SJFHIST", version, capacity
+ *     +--------------------------+
+ *     | slot 0 (24 bytes)        |   hash, predicted seconds, runs
+ *     | ...                      |
+ *     +--------------------------+
+ *
+ * Lookups probe linearly from hash % capacity. When the table is full the
+ * entry at the home slot is overwritten - a forgotten command is simply
+ * predicted from scratch. flock() keeps two runners sharing a history
+ * file from updating the same slot at once.
+ *
+ * At the end we print the measured average turnaround next to what FIFO
+ * (file order) and a perfect SJF would have given with the SAME run times.
+ * Use -p to only print the plan and predictions, without running anything.
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o sjf_run sjf_run.c
+ */
+
+#include <stdint.h>
+#include <sys/file.h> /* flock() */
+#include <sys/mman.h> /* mmap(), msync() */
+#include <sys/stat.h> /* fstat() */
+
+#include "job_spawn.h"
+
+#define HISTORY_MAGIC    "SJFHIST"
+#define HISTORY_VERSION  1
+#define HISTORY_CAPACITY 4096 /* Slots in a new file: about 96 KB */
+
+struct history_header
+{
+    char magic[8];     /* "SJFHIST\0" */
+    uint32_t version;
+    uint32_t capacity; /* Number of slots that follow */
+    uint64_t reserved[2];
+};
+
+struct history_slot
+{
+    uint64_t hash;    /* 0 = empty */
+    double predicted; /* Seconds */
+    uint32_t runs;    /* How many runs went into the prediction */
+    uint32_t pad;
+};
+
+_Static_assert(sizeof(struct history_header) == 32, "header must be 32 bytes");
+_Static_assert(sizeof(struct history_slot) == 24, "slot must be 24 bytes");
+
+struct history
+{
+    int fd;
+    struct history_header *header;
+    struct history_slot *slots;
+    size_t size;
+};
+
+/* FNV-1a: a simple, decent 64-bit string hash */
+static uint64_t hash_command(const char *s)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (; *s; s++)
+    {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ull;
+    }
+    return h ? h : 1; /* 0 marks an empty slot */
+}
+
+/* Open (creating if needed) and map the history file */
+static int history_open(struct history *h, const char *path)
+{
+    struct stat st;
+
+    h->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (h->fd < 0 || fstat(h->fd, &st) < 0)
+    {
+        perror(path);
+        return -1;
+    }
+
+    if (st.st_size == 0)
+    {
+        /* New file: size it for the table; ftruncate() fills it with zeros */
+        st.st_size = (off_t)(sizeof(struct history_header) +
+                             HISTORY_CAPACITY * sizeof(struct history_slot));
+        if (ftruncate(h->fd, st.st_size) < 0)
+        {
+            perror("ftruncate");
+            return -1;
+        }
+    }
+    h->size = (size_t)st.st_size;
+
+    void *p = mmap(NULL, h->size, PROT_READ | PROT_WRITE, MAP_SHARED, h->fd, 0);
+    if (p == MAP_FAILED)
+    {
+        perror("mmap");
+        return -1;
+    }
+    h->header = p;
+    h->slots = (struct history_slot *)(h->header + 1);
+
+    if (h->header->magic[0] == '\0')
+    {
+        memcpy(h->header->magic, HISTORY_MAGIC, 8);
+        h->header->version = HISTORY_VERSION;
+        h->header->capacity = HISTORY_CAPACITY;
+    }
+    if (memcmp(h->header->magic, HISTORY_MAGIC, 8) != 0 ||
+        h->header->version != HISTORY_VERSION ||
+        h->header->capacity == 0 ||
+        h->header->capacity > (h->size - sizeof(struct history_header)) / sizeof(struct history_slot))
+    {
+        fprintf(stderr, "%s: not an sjf_run history file\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Find the slot for a command: the one holding its hash, else the first
+ * empty one on its probe path, else (table full) its home slot.
+ */
+static struct history_slot *history_find(struct history *h, uint64_t hash)
+{
+    uint32_t cap = h->header->capacity;
+    for (uint32_t i = 0; i < cap; i++)
+    {
+        struct history_slot *s = &h->slots[(hash + i) % cap];
+        if (s->hash == hash || s->hash == 0)
+            return s;
+    }
+    return &h->slots[hash % cap];
+}
+
+static double history_predict(struct history *h, uint64_t hash, double fallback, uint32_t *runs)
+{
+    struct history_slot *s = history_find(h, hash);
+    *runs = s->hash == hash ? s->runs : 0;
+    return s->hash == hash ? s->predicted : fallback;
+}
+
+/* Fold one measured run into the command's prediction */
+static void history_update(struct history *h, uint64_t hash, double actual, double alpha)
+{
+    flock(h->fd, LOCK_EX);
+    struct history_slot *s = history_find(h, hash);
+    if (s->hash != hash)
+    {
+        /* First run (or we evicted someone): the measurement IS the estimate */
+        s->hash = hash;
+        s->predicted = actual;
+        s->runs = 1;
+    }
+    else
+    {
+        s->predicted = alpha * actual + (1 - alpha) * s->predicted;
+        s->runs++;
+    }
+    flock(h->fd, LOCK_UN);
+}
+
+struct job
+{
+    const char *cmd;
+    uint64_t hash;
+    double predicted;
+    uint32_t runs;   /* History behind the prediction */
+    pid_t pid;
+    double start, end; /* Seconds after t0 */
+    double cpu;
+    int status;
+};
+
+static int by_prediction(const void *a, const void *b)
+{
+    const struct job *x = *(const struct job *const *)a;
+    const struct job *y = *(const struct job *const *)b;
+    if (x->predicted != y->predicted)
+        return x->predicted < y->predicted ? -1 : 1;
+    return x < y ? -1 : x > y; /* Ties keep file order */
+}
+
+/*
+ * Average turnaround if jobs with these durations ran in this order on
+ * 'slots' workers, all submitted at 0: each job takes the first free slot.
+ */
+static double replay(struct job **order, int n, int slots)
+{
+    double *free_at = calloc((size_t)slots, sizeof(double));
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int s = 0;
+        for (int k = 1; k < slots; k++)
+        {
+            if (free_at[k] < free_at[s])
+                s = k;
+        }
+        free_at[s] += order[i]->end - order[i]->start;
+        sum += free_at[s];
+    }
+    free(free_at);
+    return sum / n;
+}
+
+static int by_duration(const void *a, const void *b)
+{
+    const struct job *x = *(const struct job *const *)a;
+    const struct job *y = *(const struct job *const *)b;
+    double dx = x->end - x->start, dy = y->end - y->start;
+    return dx < dy ? -1 : dx > dy;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-j slots] [-H history_file] [-a alpha] [-d default_s] [-p] [-n]"
+                    " [commands_file]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int slots = 1, quiet = 0, plan_only = 0;
+    double alpha = 0.5, fallback = 0;
+    char default_path[4096];
+    const char *path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:H:a:d:pn")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j': slots = atoi(optarg); break;
+        case 'H': path = optarg; break;
+        case 'a': alpha = atof(optarg); break;
+        case 'd': fallback = atof(optarg); break;
+        case 'p': plan_only = 1; break;
+        case 'n': quiet = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (argc - optind > 1 || slots < 1 || alpha <= 0 || alpha > 1)
+        usage(argv[0]);
+    if (path == NULL)
+    {
+        const char *home = getenv("HOME");
+        snprintf(default_path, sizeof(default_path), "%s/.sjf_history", home ? home : ".");
+        path = default_path;
+    }
+
+    FILE *fp = stdin;
+    if (optind < argc && (fp = fopen(argv[optind], "r")) == NULL)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    char **cmds;
+    int n = job_list_read(fp, &cmds);
+    if (n <= 0)
+    {
+        fprintf(stderr, "no commands to run\n");
+        return 1;
+    }
+
+    struct history h;
+    if (history_open(&h, path) < 0)
+        return 1;
+
+    struct job *jobs = calloc((size_t)n, sizeof(*jobs));
+    struct job **order = calloc((size_t)n, sizeof(*order));
+    for (int i = 0; i < n; i++)
+    {
+        jobs[i].cmd = cmds[i];
+        jobs[i].hash = hash_command(cmds[i]);
+        jobs[i].predicted = history_predict(&h, jobs[i].hash, fallback, &jobs[i].runs);
+        order[i] = &jobs[i];
+    }
+    qsort(order, (size_t)n, sizeof(*order), by_prediction);
+
+    if (plan_only)
+    {
+        printf("%4s %11s %6s  %s\n", "#", "predicted", "runs", "command");
+        for (int i = 0; i < n; i++)
+            printf("%4d %10.3fs %6u  %s\n", i + 1, order[i]->predicted, order[i]->runs,
+                   order[i]->cmd);
+        return 0;
+    }
+
+    /* Non-preemptive SJF: whenever a slot frees up, start the next job */
+    double t0 = job_now();
+    int next = 0, running = 0;
+    fflush(stdout);
+    while (next < n || running > 0)
+    {
+        while (next < n && running < slots)
+        {
+            struct job *j = order[next++];
+            j->start = job_now() - t0;
+            if ((j->pid = job_spawn(j->cmd, quiet)) < 0)
+                return 1;
+            running++;
+        }
+
+        int status = 0;
+        double cpu = 0;
+        pid_t pid = job_wait(0, &status, &cpu);
+        if (pid < 0)
+            break;
+        double now = job_now() - t0;
+        for (int i = 0; i < n; i++)
+        {
+            if (jobs[i].pid != pid)
+                continue;
+            jobs[i].end = now;
+            jobs[i].cpu = cpu;
+            jobs[i].status = status;
+            history_update(&h, jobs[i].hash, now - jobs[i].start, alpha);
+            running--;
+            break;
+        }
+    }
+    msync(h.header, h.size, MS_ASYNC);
+
+    printf("%4s %11s %11s %11s %11s %7s  %s\n", "#", "predicted", "actual", "wait",
+           "turnaround", "status", "command");
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        struct job *j = order[i];
+        printf("%4d %10.3fs %10.3fs %10.3fs %10.3fs %7d  %s\n", i + 1, j->predicted,
+               j->end - j->start, j->start, j->end,
+               WIFEXITED(j->status) ? WEXITSTATUS(j->status) : -WTERMSIG(j->status), j->cmd);
+        sum += j->end;
+    }
+
+    /* The same run times, replayed in file (FIFO) order and in true-SJF order */
+    for (int i = 0; i < n; i++)
+        order[i] = &jobs[i];
+    double fifo = replay(order, n, slots);
+    qsort(order, (size_t)n, sizeof(*order), by_duration);
+    double best = replay(order, n, slots);
+    printf("\naverage turnaround %.3fs; with these run times FIFO order gives %.3fs,"
+           " perfect SJF %.3fs\n", sum / n, fifo, best);
+    return 0;
+}
@@ -0,0 +1,137 @@
+// snapshot_stream.js - Rebuild any step of a schedule exported by sched_snap.c
+//
+// The demo pages hard-code one full snapshot per step. For a simulated
+// workload we instead load the JSON-lines delta stream from sched_snap
+// and rebuild the step being shown on demand:
+//
+//   <script src="topic_3_scheduling/snapshot_stream.js"></script>
+//
+//   const stream = new SnapshotStream();
+//   stream.addText(await (await fetch('convoy.jsonl')).text());
+//   const snap = stream.at(3);
+//   // snap = { time, queue: [ids], running: [id or null per CPU],
+//   //          blocked: [ids], blocksUpTo, done }
+//   // stream.blocks[0 .. snap.blocksUpTo - 1] = { cpu, job, start, end }
+//   // stream.jobs.get(id) = { arrival, burst }
+//
+// Chunked output (sched_snap -C) is loaded by calling addText() once per
+// file, in order - starting from any chunk: every chunk begins with a
+// keyframe, so a page can load just the part it shows. Steps
+// stream.first .. stream.length - 1 are then available, and
+// stream.blocks holds the blocks drawn from stream.first on. at(i) starts
+// from the nearest keyframe at or before step i, so it never applies more
+// than keyframe_every steps of deltas.
+
+class SnapshotStream {
+  constructor() {
+    this.header = null;
+    this.first = 0;       // Step number of steps[0]
+    this.steps = [];      // { time, ops, blocksEnd } per step
+    this.keyframes = [];  // [step index, key state] in step order
+    this.blocks = [];     // Every Gantt block, in the order they were drawn
+    this.jobs = new Map();
+  }
+
+  // One past the last step loaded
+  get length() {
+    return this.first + this.steps.length;
+  }
+
+  addText(text) {
+    for (const line of text.split('\n')) {
+      if (line.trim() !== '') this.addLine(JSON.parse(line));
+    }
+  }
+
+  addLine(obj) {
+    if (obj.format === 'sched-snapshots') {
+      this.header = obj;
+      // The first chunk loaded decides where the stream starts
+      if (this.steps.length === 0) this.first = obj.first_step || 0;
+      return;
+    }
+    if (obj.i !== this.length) {
+      throw new Error('snapshot stream: expected step ' + this.length + ', got ' + obj.i);
+    }
+    for (const op of obj.ops) {
+      if (op[0] === 'n') {
+        this.jobs.set(op[1], { arrival: obj.t, burst: op[2] });
+      } else if (op[0] === 'b') {
+        this.blocks.push({ cpu: op[1], job: op[2], start: op[3], end: op[4] });
+      }
+    }
+    if (obj.key) {
+      // A chunk loaded on its own still knows the jobs already in the system
+      for (const [id, arrival, burst] of obj.key.jobs) {
+        if (!this.jobs.has(id)) this.jobs.set(id, { arrival, burst });
+      }
+      this.keyframes.push([obj.i, obj.key]);
+    }
+    this.steps.push({ time: obj.t, ops: obj.ops, blocksEnd: this.blocks.length });
+  }
+
+  // State after step i
+  at(i) {
+    if (i < this.first || i >= this.length || this.keyframes.length === 0) {
+      throw new RangeError('snapshot stream: step ' + i + ' is not loaded');
+    }
+    // Binary search for the last keyframe at or before i
+    let lo = 0, hi = this.keyframes.length - 1;
+    while (lo < hi) {
+      const mid = (lo + hi + 1) >> 1;
+      if (this.keyframes[mid][0] <= i) lo = mid; else hi = mid - 1;
+    }
+    const [k, key] = this.keyframes[lo];
+    const state = {
+      queue: key.queue.slice(),
+      running: key.running.slice(),
+      blocked: key.blocked.slice(),
+      done: key.done,
+    };
+
+    for (let s = k + 1; s <= i; s++) {
+      for (const op of this.steps[s - this.first].ops) applyOp(state, op);
+    }
+    state.time = this.steps[i - this.first].time;
+    state.blocksUpTo = this.steps[i - this.first].blocksEnd;
+    return state;
+  }
+}
+
+function removeFrom(list, id) {
+  const at = list.indexOf(id);
+  if (at >= 0) list.splice(at, 1);
+}
+
+function leaveCpu(state, id) {
+  const c = state.running.indexOf(id);
+  if (c >= 0) state.running[c] = null;
+}
+
+function applyOp(state, op) {
+  switch (op[0]) {
+    case 'n':
+      state.queue.push(op[1]);
+      break;
+    case 'q':
+      leaveCpu(state, op[1]);
+      removeFrom(state.blocked, op[1]);
+      state.queue.push(op[1]);
+      break;
+    case 'r':
+      removeFrom(state.queue, op[2]);
+      state.running[op[1]] = op[2];
+      break;
+    case 'w':
+      leaveCpu(state, op[1]);
+      state.blocked.push(op[1]);
+      break;
+    case 'x':
+      leaveCpu(state, op[1]);
+      state.done++;
+      break;
+    // 'b' only appends to stream.blocks, which addLine() already did
+  }
+}
+
+if (typeof module !== 'undefined') module.exports = { SnapshotStream };
@@ -0,0 +1,653 @@
+/*
+ * PROGRAM: stride_run.c - Proportional-share scheduling of real commands
+ *
+ * USAGE:
+ *     stride_run [-j slots] [-q quantum_ms] [-T seconds] [-l] [-s seed] [-n]
+ *                [commands_file]
+ *     stride_run -B max_jobs [-l]
+ *
+ * Each input line is a job with a number of TICKETS, optionally tagged
+ * with a group (a team, a service, ...):
+ *
+ *     300 ./render-frames
+ *     team-a:100 make -j1 all
+ *     team-b:100 ./crunch --nightly
+ *
+ * A job should get a share of the CPU proportional to its tickets. Only
+ * 'slots' jobs (default 1) may run at any moment; the others are held
+ * with SIGSTOP. Every quantum (default 20 ms) we pick who runs next:
+ *
+ * STRIDE SCHEDULING (default) - deterministic:
+ *     stride = STRIDE1 / tickets    (many tickets = small steps)
+ *     pass   = how far the job has "walked"
+ * Always run the job with the SMALLEST pass, then advance its pass by its
+ * stride for every quantum of CPU it used. Over any interval every job
+ * stays within one stride of its exact share. The jobs waiting to run sit
+ * in a binary MIN-HEAP keyed by pass, so choosing costs O(log n) even with
+ * thousands of jobs.
+ *
+ * LOTTERY SCHEDULING (-l) - randomized:
+ *     draw a ticket at random; its holder runs.
+ * Shares are right on average. The tickets of the waiting jobs are kept in
+ * a FENWICK TREE (binary indexed tree) of running sums, so drawing the
+ * winner is also O(log n) instead of walking a list.
+ *
+ * WHAT IS MEASURED:
+ * The CPU each job actually got (from /proc/<pid>/schedstat and, at the
+ * end, wait4()) next to its TARGET: its tickets' share of all CPU handed
+ * out while it was alive. As jobs finish, the survivors' shares grow - we
+ * keep a running "CPU per ticket" sum G, so a job's target is simply
+ * tickets * (G at exit - G at start), updated in O(1) per quantum.
+ * With -T the experiment stops after that many seconds (jobs are killed),
+ * which suits endless background crunchers.
+ *
+ * -B max_jobs skips all of that and times the choice alone, for 10, 100,
+ * ... up to max_jobs waiting jobs.
+ *
+ * A job that sleeps keeps its slot for the rest of its quantum but is only
+ * charged for the CPU it used, so it does not lose its place.
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o stride_run stride_run.c
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "job_spawn.h"
+
+#define STRIDE1   (1 << 20) /* Pass units one ticket advances per quantum */
+#define GROUP_LEN 32
+
+enum job_state
+{
+    JOB_WAITING, /* In the heap / lottery: stopped, or not started yet */
+    JOB_RUNNING,
+    JOB_DONE
+};
+
+struct job
+{
+    const char *cmd;
+    char group[GROUP_LEN];
+    unsigned tickets;
+    double stride;
+    double pass;
+    enum job_state state;
+    int started;
+    pid_t pid;
+    int heap_pos;                /* Index in the heap while WAITING (stride) */
+    unsigned long long seen;     /* Last CPU sample, ns */
+    unsigned long long used;     /* CPU received, ns */
+    double g_start;              /* G when the job joined */
+    double target;               /* CPU it was entitled to, ns */
+    int status;
+};
+
+struct sched
+{
+    struct job *jobs;
+    int n;
+    int slots;
+    int *running;                /* Job per slot, -1 = free */
+    unsigned long long quantum;  /* ns */
+    int lottery;
+    int quiet;
+
+    /* Stride: waiting jobs, min-heap by pass */
+    int *heap;
+    int heap_len;
+
+    /* Lottery: Fenwick tree over waiting jobs' tickets (1-based) */
+    unsigned long long *fen;
+    unsigned long long fen_total;
+    int fen_top;                 /* Highest power of two <= n */
+    uint64_t rng;
+
+    unsigned long long live_tickets;
+    double g;                    /* CPU per ticket handed out so far, ns */
+    int done;
+};
+
+/* ======================================================================
+ * STRIDE: MIN-HEAP OF WAITING JOBS
+ * ====================================================================== */
+
+static void heap_set(struct sched *s, int i, int k)
+{
+    s->heap[i] = k;
+    s->jobs[k].heap_pos = i;
+}
+
+static void heap_up(struct sched *s, int i)
+{
+    int k = s->heap[i];
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if (s->jobs[s->heap[parent]].pass <= s->jobs[k].pass)
+            break;
+        heap_set(s, i, s->heap[parent]);
+        i = parent;
+    }
+    heap_set(s, i, k);
+}
+
+static void heap_down(struct sched *s, int i)
+{
+    int k = s->heap[i];
+    for (;;)
+    {
+        int c = 2 * i + 1;
+        if (c >= s->heap_len)
+            break;
+        if (c + 1 < s->heap_len && s->jobs[s->heap[c + 1]].pass < s->jobs[s->heap[c]].pass)
+            c++;
+        if (s->jobs[k].pass <= s->jobs[s->heap[c]].pass)
+            break;
+        heap_set(s, i, s->heap[c]);
+        i = c;
+    }
+    heap_set(s, i, k);
+}
+
+static void heap_remove(struct sched *s, int i)
+{
+    int last = s->heap[--s->heap_len];
+    if (i == s->heap_len)
+        return;
+    heap_set(s, i, last);
+    heap_up(s, i);
+    heap_down(s, s->jobs[last].heap_pos);
+}
+
+/* ======================================================================
+ * LOTTERY: FENWICK TREE OF TICKETS
+ * ====================================================================== */
+
+static void fen_add(struct sched *s, int k, long long delta)
+{
+    s->fen_total += (unsigned long long)delta;
+    for (int i = k + 1; i <= s->n; i += i & -i)
+        s->fen[i] += (unsigned long long)delta;
+}
+
+/* The job holding ticket number r (0 <= r < fen_total) */
+static int fen_find(struct sched *s, unsigned long long r)
+{
+    int pos = 0;
+    for (int step = s->fen_top; step > 0; step >>= 1)
+    {
+        if (pos + step <= s->n && s->fen[pos + step] <= r)
+        {
+            pos += step;
+            r -= s->fen[pos];
+        }
+    }
+    return pos; /* 1-based position pos + 1 = job index pos */
+}
+
+/* xorshift64 for the lottery draws */
+static uint64_t rng_next(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/* ======================================================================
+ * THE SCHEDULER
+ * ====================================================================== */
+
+static void make_waiting(struct sched *s, int k)
+{
+    struct job *j = &s->jobs[k];
+    j->state = JOB_WAITING;
+    if (s->lottery)
+    {
+        fen_add(s, k, j->tickets);
+    }
+    else
+    {
+        s->heap[s->heap_len] = k;
+        j->heap_pos = s->heap_len++;
+        heap_up(s, j->heap_pos);
+    }
+}
+
+/* Take the next job to run out of the waiting set, or -1 if none */
+static int pick(struct sched *s)
+{
+    int k;
+    if (s->lottery)
+    {
+        if (s->fen_total == 0)
+            return -1;
+        k = fen_find(s, rng_next(&s->rng) % s->fen_total);
+        fen_add(s, k, -(long long)s->jobs[k].tickets);
+    }
+    else
+    {
+        if (s->heap_len == 0)
+            return -1;
+        k = s->heap[0];
+        heap_remove(s, 0);
+    }
+    return k;
+}
+
+static void run_job(struct sched *s, int k, int slot)
+{
+    struct job *j = &s->jobs[k];
+    if (!j->started)
+    {
+        j->started = 1;
+        if ((j->pid = job_spawn(j->cmd, s->quiet)) < 0)
+            exit(1);
+    }
+    else
+    {
+        job_signal(j->pid, SIGCONT);
+    }
+    j->state = JOB_RUNNING;
+    s->running[slot] = k;
+}
+
+/* Charge the running jobs for the CPU they used since the last look */
+static void account(struct sched *s)
+{
+    unsigned long long delivered = 0;
+    for (int slot = 0; slot < s->slots; slot++)
+    {
+        int k = s->running[slot];
+        if (k < 0)
+            continue;
+        struct job *j = &s->jobs[k];
+        unsigned long long now = job_tree_cpu(j->pid);
+        unsigned long long delta = now > j->seen ? now - j->seen : 0;
+        j->seen = now;
+        j->used += delta;
+        j->pass += j->stride * (double)delta / (double)s->quantum;
+        delivered += delta;
+    }
+    if (s->live_tickets > 0)
+        s->g += (double)delivered / (double)s->live_tickets;
+}
+
+/*
+ * A quantum is over: every running job goes back to the waiting set,
+ * then the 'slots' best are chosen. Only jobs that change state are
+ * signalled, so a job that wins again simply keeps running.
+ */
+static void reschedule(struct sched *s)
+{
+    int was[s->slots];
+    for (int slot = 0; slot < s->slots; slot++)
+    {
+        was[slot] = s->running[slot];
+        if (was[slot] >= 0)
+            make_waiting(s, was[slot]);
+        s->running[slot] = -1;
+    }
+
+    int chosen[s->slots];
+    int nchosen = 0;
+    while (nchosen < s->slots && (chosen[nchosen] = pick(s)) >= 0)
+        nchosen++;
+
+    /* Stop the jobs that lost their slot */
+    for (int slot = 0; slot < s->slots; slot++)
+    {
+        int k = was[slot], keep = 0;
+        for (int c = 0; c < nchosen && k >= 0; c++)
+            keep |= chosen[c] == k;
+        if (k >= 0 && !keep)
+            job_signal(s->jobs[k].pid, SIGSTOP);
+    }
+
+    /* Winners that were already running keep their slot, with no signal */
+    for (int c = 0; c < nchosen; c++)
+    {
+        for (int slot = 0; slot < s->slots; slot++)
+        {
+            if (was[slot] == chosen[c])
+            {
+                s->running[slot] = chosen[c];
+                s->jobs[chosen[c]].state = JOB_RUNNING;
+                chosen[c] = -1;
+                break;
+            }
+        }
+    }
+
+    /* The others are started or continued in the free slots */
+    int slot = 0;
+    for (int c = 0; c < nchosen; c++)
+    {
+        if (chosen[c] < 0)
+            continue;
+        while (s->running[slot] >= 0)
+            slot++;
+        run_job(s, chosen[c], slot);
+    }
+}
+
+/* Fill slots freed by exits right away, without waiting for the tick */
+static void fill_slots(struct sched *s)
+{
+    for (int slot = 0; slot < s->slots; slot++)
+    {
+        if (s->running[slot] >= 0)
+            continue;
+        int k = pick(s);
+        if (k < 0)
+            return;
+        run_job(s, k, slot);
+    }
+}
+
+static void finish(struct sched *s, struct job *j, int status, double cpu)
+{
+    unsigned long long exact = (unsigned long long)(cpu * 1e9);
+    if (exact > j->used)
+        j->used = exact;
+    j->status = status;
+    j->target = j->tickets * (s->g - j->g_start);
+    s->live_tickets -= j->tickets;
+    s->done++;
+}
+
+static void reap(struct sched *s, int sfd)
+{
+    struct signalfd_siginfo si;
+    while (read(sfd, &si, sizeof(si)) == sizeof(si))
+        ;
+
+    pid_t pid;
+    int status;
+    double cpu = 0;
+    while ((pid = job_reap(&status, &cpu)) > 0)
+    {
+        for (int k = 0; k < s->n; k++)
+        {
+            struct job *j = &s->jobs[k];
+            if (j->pid != pid || j->state == JOB_DONE)
+                continue;
+            if (j->state == JOB_RUNNING)
+            {
+                /* Charge what it used since the last tick, then free the slot */
+                account(s);
+                for (int slot = 0; slot < s->slots; slot++)
+                {
+                    if (s->running[slot] == k)
+                        s->running[slot] = -1;
+                }
+            }
+            else if (s->lottery)
+            {
+                fen_add(s, k, -(long long)j->tickets); /* Killed while stopped */
+            }
+            else
+            {
+                heap_remove(s, j->heap_pos);
+            }
+            j->state = JOB_DONE;
+            finish(s, j, status, cpu);
+            break;
+        }
+    }
+    fill_slots(s);
+}
+
+/* -T expired: kill everything still alive and settle the accounts */
+static void stop_all(struct sched *s)
+{
+    account(s);
+    for (int k = 0; k < s->n; k++)
+    {
+        struct job *j = &s->jobs[k];
+        if (j->state == JOB_DONE)
+            continue;
+        if (j->started)
+        {
+            job_signal(j->pid, SIGKILL);
+            job_signal(j->pid, SIGCONT);
+        }
+        j->target = j->tickets * (s->g - j->g_start);
+    }
+    while (job_wait(0, &(int){0}, &(double){0}) > 0)
+        ;
+}
+
+/* "[group:]tickets command" */
+static int parse_job(struct job *j, char *line)
+{
+    char *end;
+    char *colon = strchr(line, ':');
+    char *space = strpbrk(line, " \t");
+    if (colon && space && colon < space)
+    {
+        size_t len = (size_t)(colon - line);
+        if (len >= GROUP_LEN)
+            len = GROUP_LEN - 1;
+        memcpy(j->group, line, len);
+        line = colon + 1;
+    }
+    unsigned long tickets = strtoul(line, &end, 10);
+    if (end == line || tickets == 0 || tickets > STRIDE1)
+        return -1;
+    j->tickets = (unsigned)tickets;
+    j->stride = (double)STRIDE1 / (double)tickets;
+    j->cmd = end + strspn(end, " \t");
+    return *j->cmd ? 0 : -1;
+}
+
+/*
+ * -B: how the choice scales, without any processes. n jobs with random
+ * tickets; each "quantum" picks one, charges it a full quantum and puts
+ * it back - exactly the work reschedule() does per slot.
+ */
+static void bench(int lottery, int max_jobs)
+{
+    const int ops = 2000000;
+    printf("ns per pick + charge + reinsert, %s\n", lottery ? "lottery" : "stride");
+    for (int n = 10; n <= max_jobs; n *= 10)
+    {
+        struct sched s = {0};
+        s.n = n;
+        s.lottery = lottery;
+        s.rng = 88172645463325252ull;
+        s.jobs = calloc((size_t)n, sizeof(*s.jobs));
+        s.heap = calloc((size_t)n, sizeof(*s.heap));
+        s.fen = calloc((size_t)n + 1, sizeof(*s.fen));
+        for (s.fen_top = 1; s.fen_top * 2 <= n; s.fen_top *= 2)
+            ;
+        for (int k = 0; k < n; k++)
+        {
+            s.jobs[k].tickets = 1 + (unsigned)(rng_next(&s.rng) % 1000);
+            s.jobs[k].stride = (double)STRIDE1 / s.jobs[k].tickets;
+            make_waiting(&s, k);
+        }
+
+        double start = job_now();
+        for (int i = 0; i < ops; i++)
+        {
+            int k = pick(&s);
+            s.jobs[k].pass += s.jobs[k].stride;
+            make_waiting(&s, k);
+        }
+        printf("%10d jobs %8.1f\n", n, (job_now() - start) / ops * 1e9);
+        free(s.jobs);
+        free(s.heap);
+        free(s.fen);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-j slots] [-q quantum_ms] [-T seconds] [-l] [-s seed] [-n]"
+                    " [commands_file]\n"
+                    "       %s -B max_jobs [-l]\n", prog, prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct sched s = {0};
+    double quantum_ms = 20, limit_s = 0;
+    int bench_jobs = 0;
+    int opt;
+
+    s.slots = 1;
+    s.rng = 88172645463325252ull;
+    while ((opt = getopt(argc, argv, "j:q:T:ls:nB:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j': s.slots = atoi(optarg); break;
+        case 'q': quantum_ms = atof(optarg); break;
+        case 'T': limit_s = atof(optarg); break;
+        case 'l': s.lottery = 1; break;
+        case 's': s.rng = strtoull(optarg, NULL, 0) | 1; break;
+        case 'n': s.quiet = 1; break;
+        case 'B': bench_jobs = atoi(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (argc - optind > 1 || s.slots < 1 || quantum_ms <= 0 || limit_s < 0)
+        usage(argv[0]);
+    s.quantum = (unsigned long long)(quantum_ms * 1e6);
+    if (bench_jobs > 0)
+    {
+        bench(s.lottery, bench_jobs);
+        return 0;
+    }
+
+    FILE *fp = stdin;
+    if (optind < argc && (fp = fopen(argv[optind], "r")) == NULL)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    char **lines;
+    s.n = job_list_read(fp, &lines);
+    if (s.n <= 0)
+    {
+        fprintf(stderr, "no jobs to run\n");
+        return 1;
+    }
+
+    s.jobs = calloc((size_t)s.n, sizeof(*s.jobs));
+    s.heap = calloc((size_t)s.n, sizeof(*s.heap));
+    s.fen = calloc((size_t)s.n + 1, sizeof(*s.fen));
+    s.running = malloc(sizeof(*s.running) * (size_t)s.slots);
+    for (int slot = 0; slot < s.slots; slot++)
+        s.running[slot] = -1;
+    for (s.fen_top = 1; s.fen_top * 2 <= s.n; s.fen_top *= 2)
+        ;
+    for (int k = 0; k < s.n; k++)
+    {
+        if (parse_job(&s.jobs[k], lines[k]) < 0)
+        {
+            fprintf(stderr, "line %d: expected '[group:]tickets command': %s\n", k + 1, lines[k]);
+            return 1;
+        }
+        s.live_tickets += s.jobs[k].tickets;
+        make_waiting(&s, k);
+    }
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    int sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (sfd < 0 || tfd < 0)
+    {
+        perror("signalfd/timerfd");
+        return 1;
+    }
+    struct itimerspec tick = {0};
+    tick.it_interval.tv_sec = (time_t)(s.quantum / 1000000000ull);
+    tick.it_interval.tv_nsec = (long)(s.quantum % 1000000000ull);
+    tick.it_value = tick.it_interval;
+    timerfd_settime(tfd, 0, &tick, NULL);
+
+    fflush(stdout);
+    double t0 = job_now();
+    unsigned long long quanta = 0;
+    fill_slots(&s);
+    while (s.done < s.n)
+    {
+        struct pollfd fds[2] = {{tfd, POLLIN, 0}, {sfd, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            return 1;
+        }
+        if (fds[1].revents & POLLIN)
+            reap(&s, sfd);
+        if (fds[0].revents & POLLIN)
+        {
+            uint64_t expirations;
+            if (read(tfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                perror("read timerfd");
+            account(&s);
+            reschedule(&s);
+            quanta++;
+        }
+        if (limit_s > 0 && job_now() - t0 >= limit_s)
+        {
+            stop_all(&s);
+            break;
+        }
+    }
+    double elapsed = job_now() - t0;
+
+    printf("%s, %d slot(s), quantum %g ms: %.2f s, %llu quanta\n\n",
+           s.lottery ? "lottery" : "stride", s.slots, quantum_ms, elapsed, quanta);
+    printf("%4s %-12s %8s %10s %10s %8s  %s\n", "job", "group", "tickets", "cpu (s)",
+           "target", "ratio", "command");
+    for (int k = 0; k < s.n; k++)
+    {
+        struct job *j = &s.jobs[k];
+        printf("%4d %-12s %8u %10.3f %10.3f %8.2f  %s\n", k, j->group[0] ? j->group : "-",
+               j->tickets, (double)j->used / 1e9, j->target / 1e9,
+               j->target > 0 ? (double)j->used / j->target : 0.0, j->cmd);
+    }
+
+    /* Per group totals */
+    int printed_header = 0;
+    for (int k = 0; k < s.n; k++)
+    {
+        if (!s.jobs[k].group[0])
+            continue;
+        int first = 1;
+        for (int i = 0; i < k && first; i++)
+            first = strcmp(s.jobs[i].group, s.jobs[k].group) != 0;
+        if (!first)
+            continue;
+        double used = 0, target = 0;
+        for (int i = k; i < s.n; i++)
+        {
+            if (strcmp(s.jobs[i].group, s.jobs[k].group) == 0)
+            {
+                used += (double)s.jobs[i].used;
+                target += s.jobs[i].target;
+            }
+        }
+        if (!printed_header)
+            printf("\n%-12s %10s %10s %8s\n", "group", "cpu (s)", "target", "ratio");
+        printed_header = 1;
+        printf("%-12s %10.3f %10.3f %8.2f\n", s.jobs[k].group, used / 1e9, target / 1e9,
+               target > 0 ? used / target : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ * timing_wheel.h - A hierarchical timing wheel: an O(1) event queue
+ *
+ * sched_sim.h keeps its future events in a binary heap. Every push and pop
+ * costs O(log n) comparisons, and each one touches a different part of the
+ * array - cheap for 10 pending events, slow for 10 million.
+ *
+ * A TIMING WHEEL works like a clock face. Level 0 has 256 slots, one per
+ * time unit: an event due 37 units from now goes straight into slot
+ * (now + 37) % 256. No comparisons at all. Events further away go into a
+ * coarser wheel, exactly like the hands of a clock:
+ *
+ *     level 0: 256 slots of 1 unit        (the "seconds" hand)
+ *     level 1: 256 slots of 256 units     (the "minutes" hand)
+ *     level 2: 256 slots of 65536 units   (the "hours" hand)
+ *     ...      8 levels cover every 64-bit time
+ *
+ * Concretely, an event goes to the level of the highest 8-bit DIGIT in
+ * which its time differs from 'now', into the slot named by that digit.
+ * When the clock reaches a coarse slot, its events CASCADE: each one is
+ * re-filed on a finer level, where it now fits. An event cascades at most
+ * once per level, so push and pop are O(1) however many events wait.
+ *
+ * ORDER:
+ * Events come out in time order. Events at the same time come out by
+ * class (lower first) and then in the order they were pushed - the same
+ * order as sched_sim.h's heap, so both give identical simulations. Slots
+ * are FIFO lists and a coarse slot always cascades before anything can be
+ * pushed directly into the range it covers, so push order survives the
+ * cascades.
+ *
+ * RULE: never push an event earlier than the last one popped.
+ *
+ * Entries live in one array and are linked by index, recycled through a
+ * free list, so a steady-state simulation does not call malloc at all.
+ */
+
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <stdint.h>
+#include <stdlib.h> /* realloc(), free() */
+#include <string.h> /* memset() */
+
+#define TW_BITS    8
+#define TW_SLOTS   (1u << TW_BITS) /* 256 slots per level */
+#define TW_LEVELS  8               /* 8 levels x 8 bits = 64-bit times */
+#define TW_CLASSES 3               /* Tie-break classes at the same time */
+#define TW_NIL     UINT32_MAX      /* End of a list */
+
+struct tw_entry
+{
+    uint64_t time;
+    uint64_t data;  /* Whatever the caller wants back */
+    uint32_t cls;   /* 0..TW_CLASSES-1; lower comes first at equal times */
+    uint32_t next;  /* Next entry in the same slot (or free list) */
+};
+
+struct tw_list
+{
+    uint32_t head, tail;
+};
+
+struct timing_wheel
+{
+    uint64_t now;  /* Time of the last pop; earlier pushes are not allowed */
+    size_t count;  /* Entries currently queued */
+
+    struct tw_entry *pool;
+    uint32_t pool_len, pool_cap, free_head;
+
+    /* One bit per slot: is anything filed there? */
+    uint64_t occupied[TW_LEVELS][TW_SLOTS / 64];
+    uint32_t level_count[TW_LEVELS]; /* Entries filed on each level */
+    uint32_t level_mask;             /* Bit l set if level_count[l] > 0 */
+
+    /* Level 0 slots hold a single time, so we keep one list per class */
+    struct tw_list exact[TW_SLOTS][TW_CLASSES];
+
+    /* Coarser slots: one list, plus the earliest time in it (level 0 unused) */
+    struct tw_list coarse[TW_LEVELS][TW_SLOTS];
+    uint64_t coarse_min[TW_LEVELS][TW_SLOTS];
+};
+
+static inline void tw_init(struct timing_wheel *w)
+{
+    memset(w, 0, sizeof(*w));
+    w->free_head = TW_NIL;
+    for (unsigned s = 0; s < TW_SLOTS; s++)
+    {
+        for (unsigned c = 0; c < TW_CLASSES; c++)
+            w->exact[s][c].head = w->exact[s][c].tail = TW_NIL;
+        for (unsigned l = 0; l < TW_LEVELS; l++)
+            w->coarse[l][s].head = w->coarse[l][s].tail = TW_NIL;
+    }
+}
+
+static inline void tw_free(struct timing_wheel *w)
+{
+    free(w->pool);
+    w->pool = NULL;
+}
+
+static inline unsigned tw_digit(uint64_t t, unsigned level)
+{
+    return (unsigned)(t >> (level * TW_BITS)) & (TW_SLOTS - 1);
+}
+
+static inline void tw_append(struct tw_entry *pool, struct tw_list *l, uint32_t e)
+{
+    pool[e].next = TW_NIL;
+    if (l->tail == TW_NIL)
+        l->head = e;
+    else
+        pool[l->tail].next = e;
+    l->tail = e;
+}
+
+/* File entry e on the level and slot where it belongs relative to w->now */
+static inline void tw_file(struct timing_wheel *w, uint32_t e)
+{
+    uint64_t t = w->pool[e].time;
+    uint64_t diff = t ^ w->now;
+    unsigned level = diff ? (63u - (unsigned)__builtin_clzll(diff)) / TW_BITS : 0;
+    unsigned slot = tw_digit(t, level);
+
+    if (level == 0)
+        tw_append(w->pool, &w->exact[slot][w->pool[e].cls], e);
+    else
+    {
+        if (w->coarse[level][slot].head == TW_NIL || t < w->coarse_min[level][slot])
+            w->coarse_min[level][slot] = t;
+        tw_append(w->pool, &w->coarse[level][slot], e);
+    }
+    w->occupied[level][slot / 64] |= 1ull << (slot % 64);
+    w->level_count[level]++;
+    w->level_mask |= 1u << level;
+}
+
+static inline void tw_push(struct timing_wheel *w, uint64_t time, uint32_t cls, uint64_t data)
+{
+    uint32_t e = w->free_head;
+    if (e != TW_NIL)
+        w->free_head = w->pool[e].next;
+    else
+    {
+        if (w->pool_len == w->pool_cap)
+        {
+            w->pool_cap = w->pool_cap ? 2 * w->pool_cap : 64;
+            w->pool = realloc(w->pool, w->pool_cap * sizeof(*w->pool));
+        }
+        e = w->pool_len++;
+    }
+
+    w->pool[e].time = time;
+    w->pool[e].data = data;
+    w->pool[e].cls = cls;
+    tw_file(w, e);
+    w->count++;
+}
+
+/* First occupied slot >= from on this level, or -1 */
+static inline int tw_find(const struct timing_wheel *w, unsigned level, unsigned from)
+{
+    for (unsigned word = from / 64; word < TW_SLOTS / 64; word++)
+    {
+        uint64_t bits = w->occupied[level][word];
+        if (word == from / 64)
+            bits &= ~0ull << (from % 64);
+        if (bits)
+            return (int)(word * 64 + (unsigned)__builtin_ctzll(bits));
+    }
+    return -1;
+}
+
+/*
+ * Find the earliest entry without moving the clock. Everything on level 0
+ * is earlier than everything on level 1, and so on; within a level, slots
+ * further round the wheel are later. Returns the level (and *slot), or -1
+ * if the wheel is empty.
+ */
+static inline int tw_first(const struct timing_wheel *w, unsigned *slot)
+{
+    if (w->level_mask == 0)
+        return -1;
+    unsigned level = (unsigned)__builtin_ctz(w->level_mask);
+    *slot = (unsigned)tw_find(w, level, tw_digit(w->now, level));
+    return (int)level;
+}
+
+static inline void tw_unfile(struct timing_wheel *w, unsigned level, unsigned slot, uint32_t n)
+{
+    w->occupied[level][slot / 64] &= ~(1ull << (slot % 64));
+    w->level_count[level] -= n;
+    if (w->level_count[level] == 0)
+        w->level_mask &= ~(1u << level);
+}
+
+/* Time of the earliest entry, or UINT64_MAX if the wheel is empty */
+static inline uint64_t tw_next_time(const struct timing_wheel *w)
+{
+    unsigned slot;
+    int level = tw_first(w, &slot);
+
+    if (level < 0)
+        return UINT64_MAX;
+    if (level == 0)
+        return (w->now & ~(uint64_t)(TW_SLOTS - 1)) | slot;
+    return w->coarse_min[level][slot];
+}
+
+/* Remove the earliest entry. Returns 0 if the wheel is empty. */
+static inline int tw_pop(struct timing_wheel *w, uint64_t *time, uint32_t *cls, uint64_t *data)
+{
+    unsigned slot;
+    int level;
+
+    while ((level = tw_first(w, &slot)) > 0)
+    {
+        /* Nothing on finer levels: jump the clock and cascade this slot */
+        struct tw_list l = w->coarse[level][slot];
+        uint32_t n = 0;
+        for (uint32_t e = l.head; e != TW_NIL; e = w->pool[e].next)
+            n++;
+        w->coarse[level][slot].head = w->coarse[level][slot].tail = TW_NIL;
+        tw_unfile(w, (unsigned)level, slot, n);
+        w->now = w->coarse_min[level][slot];
+        for (uint32_t e = l.head, next; e != TW_NIL; e = next)
+        {
+            next = w->pool[e].next;
+            tw_file(w, e);
+        }
+    }
+    if (level < 0)
+        return 0;
+
+    struct tw_list *lists = w->exact[slot];
+    unsigned c = 0;
+    while (lists[c].head == TW_NIL)
+        c++;
+
+    uint32_t e = lists[c].head;
+    lists[c].head = w->pool[e].next;
+    int emptied = 0;
+    if (lists[c].head == TW_NIL)
+    {
+        lists[c].tail = TW_NIL;
+        emptied = 1;
+        for (unsigned k = c + 1; k < TW_CLASSES; k++)
+            emptied &= lists[k].head == TW_NIL;
+    }
+    if (emptied)
+        tw_unfile(w, 0, slot, 1);
+    else
+        w->level_count[0]--;
+
+    w->now = w->pool[e].time;
+    *time = w->pool[e].time;
+    *cls = w->pool[e].cls;
+    *data = w->pool[e].data;
+    w->pool[e].next = w->free_head;
+    w->free_head = e;
+    w->count--;
+    return 1;
+}
+
+#endif /* TIMING_WHEEL_H */
@@ -0,0 +1,411 @@
+/*
+ * PROGRAM: trace_convert.c - Build binary job traces (see job_trace.h)
+ *
+ * USAGE:
+ *     trace_convert csv  jobs.csv  out.bin    CSV  -> binary trace
+ *     trace_convert jobs jobs.js   out.bin    JOBS array from a demo page -> binary
+ *     trace_convert dump trace.bin            binary trace -> CSV on stdout
+ *
+ * CSV INPUT:
+ * One job per line. If the first line names the columns, any subset and
+ * order of these is accepted:
+ *
+ *     id,arrival,burst,priority,io_every,io_time
+ *
+ * Without a header line, columns are arrival,burst,priority,io_every,io_time
+ * and ids are assigned 0, 1, 2, ... Blank lines and lines starting with '#'
+ * are skipped. The CSV is streamed line by line, so it can be huge, but it
+ * must already be sorted by arrival.
+ *
+ * JOBS INPUT:
+ * Paste the JOBS array straight out of fifo-convoy-effect.html:
+ *
+ *     const JOBS = [
+ *       { name: 'A', burst: 80, color: '#D95534' },
+ *       { name: 'B', burst: 15, color: '#2E7DB3' },
+ *       ...
+ *     ];
+ *
+ * This is a JavaScript literal, not strict JSON (unquoted keys, single
+ * quotes), so we use a small forgiving parser. The keys arrival, burst,
+ * priority, io_every and io_time are read; everything else is ignored.
+ * A missing arrival means t = 0, as in the demos. Job i gets id i, so
+ * 'A' is 0, 'B' is 1, and so on.
+ *
+ * BUILD:
+ *     gcc -O2 -Wall -o trace_convert trace_convert.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "job_trace.h"
+
+/* ======================================================================
+ * CSV -> binary
+ * ====================================================================== */
+
+enum csv_column { COL_ID, COL_ARRIVAL, COL_BURST, COL_PRIORITY, COL_IO_EVERY, COL_IO_TIME, NCOLS };
+
+static const char *const column_names[NCOLS] = {
+    "id", "arrival", "burst", "priority", "io_every", "io_time"};
+
+#define MAX_FIELDS 16
+
+/* Split 'line' in place at commas. Returns the number of fields. */
+static int split_csv(char *line, char *fields[MAX_FIELDS])
+{
+    int n = 0;
+    char *p = line;
+
+    for (;;)
+    {
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (n < MAX_FIELDS)
+            fields[n++] = p;
+        char *comma = strchr(p, ',');
+        if (comma == NULL)
+            break;
+        *comma = '\0';
+        p = comma + 1;
+    }
+
+    /* Trim trailing whitespace and the newline from the last field */
+    char *end = fields[n - 1] + strlen(fields[n - 1]);
+    while (end > fields[n - 1] && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return n;
+}
+
+static int convert_csv(const char *in_path, const char *out_path)
+{
+    FILE *in = fopen(in_path, "r");
+    if (in == NULL)
+    {
+        perror(in_path);
+        return -1;
+    }
+
+    struct job_trace_writer w;
+    if (job_trace_create(&w, out_path) < 0)
+    {
+        fclose(in);
+        return -1;
+    }
+
+    /* Which CSV field holds each column; -1 = column absent */
+    int where[NCOLS] = {-1, 0, 1, 2, 3, 4};
+    int seen_first = 0;
+    char *line = NULL;
+    size_t cap = 0;
+    long lineno = 0;
+    int rc = 0;
+
+    while (getline(&line, &cap, in) != -1)
+    {
+        char *fields[MAX_FIELDS];
+        lineno++;
+
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+            continue;
+        int n = split_csv(line, fields);
+
+        /* A first line that starts with a letter is a header naming the columns */
+        if (!seen_first && isalpha((unsigned char)fields[0][0]))
+        {
+            for (int c = 0; c < NCOLS; c++)
+                where[c] = -1;
+            for (int f = 0; f < n; f++)
+                for (int c = 0; c < NCOLS; c++)
+                    if (strcmp(fields[f], column_names[c]) == 0)
+                        where[c] = f;
+            if (where[COL_BURST] < 0)
+            {
+                fprintf(stderr, "%s: header has no 'burst' column\n", in_path);
+                rc = -1;
+                break;
+            }
+            seen_first = 1;
+            continue;
+        }
+        seen_first = 1;
+
+        unsigned long long v[NCOLS] = {0};
+        for (int c = 0; c < NCOLS; c++)
+        {
+            if (where[c] < 0 || where[c] >= n)
+                continue;
+            char *end;
+            v[c] = strtoull(fields[where[c]], &end, 10);
+            if (end == fields[where[c]] || *end != '\0')
+            {
+                fprintf(stderr, "%s:%ld: bad %s value '%s'\n",
+                        in_path, lineno, column_names[c], fields[where[c]]);
+                rc = -1;
+                break;
+            }
+        }
+        if (rc < 0)
+            break;
+
+        struct job_record r = {
+            .arrival = v[COL_ARRIVAL],
+            .burst = v[COL_BURST],
+            .id = where[COL_ID] >= 0 ? (uint32_t)v[COL_ID] : (uint32_t)w.count,
+            .priority = (uint32_t)v[COL_PRIORITY],
+            .io_every = (uint32_t)v[COL_IO_EVERY],
+            .io_time = (uint32_t)v[COL_IO_TIME],
+        };
+        if (job_trace_append(&w, &r) < 0)
+        {
+            rc = -1;
+            break;
+        }
+    }
+
+    free(line);
+    fclose(in);
+    if (job_trace_finish(&w) < 0)
+        rc = -1;
+    if (rc == 0)
+        printf("%s: wrote %llu jobs\n", out_path, (unsigned long long)w.count);
+    return rc;
+}
+
+/* ======================================================================
+ * JOBS (JavaScript literal) -> binary
+ * ====================================================================== */
+
+static const char *skip_space(const char *p)
+{
+    while (isspace((unsigned char)*p))
+        p++;
+    return p;
+}
+
+/* Skip over a quoted string starting at p (which points at the quote) */
+static const char *skip_string(const char *p)
+{
+    char quote = *p++;
+    while (*p && *p != quote)
+        p += (*p == '\\' && p[1]) ? 2 : 1;
+    return *p ? p + 1 : p;
+}
+
+/* Read a key - either bare (burst) or quoted ("burst") - into key[] */
+static const char *read_key(const char *p, char *key, size_t size)
+{
+    size_t n = 0;
+    if (*p == '"' || *p == '\'')
+    {
+        const char *end = skip_string(p);
+        for (p++; p < end - 1 && n + 1 < size; p++)
+            key[n++] = *p;
+        p = end;
+    }
+    else
+    {
+        while ((isalnum((unsigned char)*p) || *p == '_') && n + 1 < size)
+            key[n++] = *p++;
+    }
+    key[n] = '\0';
+    return p;
+}
+
+/* Compare by arrival, then by position in the array (keeps the sort stable) */
+static int by_arrival(const void *a, const void *b)
+{
+    const struct job_record *x = a, *y = b;
+    if (x->arrival != y->arrival)
+        return x->arrival < y->arrival ? -1 : 1;
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static int convert_jobs(const char *in_path, const char *out_path)
+{
+    FILE *in = fopen(in_path, "r");
+    if (in == NULL)
+    {
+        perror(in_path);
+        return -1;
+    }
+
+    /* A JOBS array is small - read the whole thing into memory */
+    char *text = NULL;
+    size_t len = 0, cap = 0;
+    int c;
+    while ((c = fgetc(in)) != EOF)
+    {
+        if (len + 1 >= cap)
+        {
+            cap = cap ? 2 * cap : 4096;
+            text = realloc(text, cap);
+        }
+        text[len++] = (char)c;
+    }
+    fclose(in);
+    if (text == NULL)
+    {
+        fprintf(stderr, "%s: empty file\n", in_path);
+        return -1;
+    }
+    text[len] = '\0';
+
+    /* Skip past "const JOBS =" (or anything else) to the opening bracket */
+    const char *p = strchr(text, '[');
+    if (p == NULL)
+    {
+        fprintf(stderr, "%s: no '[' found - expected a JOBS array\n", in_path);
+        free(text);
+        return -1;
+    }
+    p++;
+
+    struct job_record *jobs = NULL;
+    size_t njobs = 0, jobs_cap = 0;
+
+    for (;;)
+    {
+        p = skip_space(p);
+        if (*p == ',')
+        {
+            p++;
+            continue;
+        }
+        if (*p != '{')
+            break; /* ']' or end of input */
+        p++;
+
+        struct job_record r;
+        memset(&r, 0, sizeof(r));
+        r.id = (uint32_t)njobs;
+
+        /* Parse  key: value  pairs until the closing brace */
+        for (;;)
+        {
+            char key[32];
+            p = skip_space(p);
+            if (*p == ',')
+            {
+                p++;
+                continue;
+            }
+            if (*p == '}' || *p == '\0')
+                break;
+
+            p = skip_space(read_key(p, key, sizeof(key)));
+            if (*p != ':')
+            {
+                fprintf(stderr, "%s: expected ':' after key '%s'\n", in_path, key);
+                free(text);
+                free(jobs);
+                return -1;
+            }
+            p = skip_space(p + 1);
+
+            if (*p == '"' || *p == '\'')
+            {
+                p = skip_string(p); /* String values (name, color) are not needed */
+                continue;
+            }
+
+            char *end;
+            unsigned long long v = strtoull(p, &end, 10);
+            if (end == p)
+            {
+                fprintf(stderr, "%s: unsupported value for key '%s'\n", in_path, key);
+                free(text);
+                free(jobs);
+                return -1;
+            }
+            p = end;
+
+            if (strcmp(key, "arrival") == 0)
+                r.arrival = v;
+            else if (strcmp(key, "burst") == 0)
+                r.burst = v;
+            else if (strcmp(key, "priority") == 0)
+                r.priority = (uint32_t)v;
+            else if (strcmp(key, "io_every") == 0)
+                r.io_every = (uint32_t)v;
+            else if (strcmp(key, "io_time") == 0)
+                r.io_time = (uint32_t)v;
+        }
+        if (*p == '}')
+            p++;
+
+        if (njobs == jobs_cap)
+        {
+            jobs_cap = jobs_cap ? 2 * jobs_cap : 16;
+            jobs = realloc(jobs, jobs_cap * sizeof(*jobs));
+        }
+        jobs[njobs++] = r;
+    }
+    free(text);
+
+    /* The demos list jobs in queue order; the trace must be in arrival order */
+    qsort(jobs, njobs, sizeof(*jobs), by_arrival);
+
+    struct job_trace_writer w;
+    int rc = job_trace_create(&w, out_path);
+    for (size_t i = 0; rc == 0 && i < njobs; i++)
+        rc = job_trace_append(&w, &jobs[i]);
+    if (rc == 0)
+        rc = job_trace_finish(&w);
+    free(jobs);
+
+    if (rc == 0)
+        printf("%s: wrote %zu jobs\n", out_path, njobs);
+    return rc;
+}
+
+/* ======================================================================
+ * binary -> CSV (handy for checking a conversion)
+ * ====================================================================== */
+
+static int dump(const char *path)
+{
+    struct job_trace t;
+    struct job_record r;
+
+    if (job_trace_open(&t, path) < 0)
+        return -1;
+
+    printf("id,arrival,burst,priority,io_every,io_time\n");
+    while (job_trace_next(&t, &r))
+        printf("%u,%llu,%llu,%u,%u,%u\n", r.id,
+               (unsigned long long)r.arrival, (unsigned long long)r.burst,
+               r.priority, r.io_every, r.io_time);
+
+    job_trace_close(&t);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s csv  in.csv out.bin\n"
+            "       %s jobs in.js  out.bin\n"
+            "       %s dump in.bin\n",
+            prog, prog, prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int rc;
+
+    if (argc == 4 && strcmp(argv[1], "csv") == 0)
+        rc = convert_csv(argv[2], argv[3]);
+    else if (argc == 4 && strcmp(argv[1], "jobs") == 0)
+        rc = convert_jobs(argv[2], argv[3]);
+    else if (argc == 3 && strcmp(argv[1], "dump") == 0)
+        rc = dump(argv[2]);
+    else
+        usage(argv[0]);
+
+    exit(rc < 0 ? 1 : 0);
+}
@@ -0,0 +1,164 @@
+/*
+ * PROGRAM: workload_gen.c - Generate synthetic workloads (see workload_gen.h)
+ *
+ * USAGE:
+ *     workload_gen [-w workload] [-s seed] [-S shard] -o out.bin
+ *         Write the workload as a binary trace for sched_sim.
+ *
+ *     workload_gen [-w workload] [-s seed] -B threads
+ *         Benchmark: every thread generates its own shard of n jobs as
+ *         fast as it can, and we report jobs per second plus the measured
+ *         average gap and burst (a quick check of the distributions).
+ *
+ * EXAMPLES:
+ *     workload_gen -w n=1000000,burst=convoy,plong=0.01,long=500 -o convoy.bin
+ *     workload_gen -w n=100000000,arrival=bursty,burst=pareto,alpha=1.2 -B 8
+ *
+ * The simulator does not need a file at all - "sched_sim -w ..." pulls
+ * jobs straight from the generator.
+ *
+ * BUILD:
+ *     gcc -O3 -march=native -Wall -pthread -o workload_gen workload_gen.c
+ *
+ * -march=native lets the compiler use the widest SIMD registers of this
+ * machine for the per-block passes in workload_fill(); on an AVX2 laptop
+ * core it roughly triples the rate compared with plain -O2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>  /* getopt() */
+#include <pthread.h> /* one thread per shard in -B mode */
+#include <time.h>    /* clock_gettime() */
+
+#include "job_trace.h"
+#include "workload_gen.h"
+
+static struct workload_params params;
+static uint64_t seed = 1;
+
+struct bench_shard
+{
+    pthread_t thread;
+    uint64_t shard;
+    uint64_t jobs;
+    uint64_t last_arrival;
+    double burst_sum;
+};
+
+static void *bench_main(void *arg)
+{
+    struct bench_shard *b = arg;
+    static __thread struct job_record batch[4096];
+    struct workload_gen gen;
+    size_t n;
+
+    workload_init(&gen, &params, seed, b->shard);
+    while ((n = workload_fill(&gen, batch, 4096)) > 0)
+    {
+        /* Touch every job so the compiler cannot skip the work */
+        for (size_t i = 0; i < n; i++)
+            b->burst_sum += (double)batch[i].burst;
+        b->jobs += n;
+        b->last_arrival = batch[n - 1].arrival;
+    }
+    return NULL;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int bench(int nthreads)
+{
+    struct bench_shard *shards = calloc((size_t)nthreads, sizeof(*shards));
+
+    double start = now_seconds();
+    for (int t = 0; t < nthreads; t++)
+    {
+        shards[t].shard = (uint64_t)t;
+        pthread_create(&shards[t].thread, NULL, bench_main, &shards[t]);
+    }
+    for (int t = 0; t < nthreads; t++)
+        pthread_join(shards[t].thread, NULL);
+    double elapsed = now_seconds() - start;
+
+    uint64_t jobs = 0;
+    double bursts = 0, gaps = 0;
+    for (int t = 0; t < nthreads; t++)
+    {
+        jobs += shards[t].jobs;
+        bursts += shards[t].burst_sum;
+        if (shards[t].jobs > 1)
+            gaps += (double)shards[t].last_arrival / (double)(shards[t].jobs - 1);
+    }
+
+    printf("%llu jobs in %.3f s on %d thread(s): %.1f M jobs/s\n",
+           (unsigned long long)jobs, elapsed, nthreads, jobs / elapsed / 1e6);
+    printf("average burst %.3f (expected %.3f), average gap %.3f (expected %.3f)\n",
+           bursts / (double)(jobs ? jobs : 1), workload_mean_burst(&params),
+           gaps / nthreads, params.mean_interarrival);
+    free(shards);
+    return 0;
+}
+
+static int write_trace(const char *path, uint64_t shard)
+{
+    struct job_trace_writer w;
+    struct workload_gen gen;
+    struct job_record r;
+
+    if (job_trace_create(&w, path) < 0)
+        return -1;
+    workload_init(&gen, &params, seed, shard);
+    while (workload_next(&gen, &r))
+        if (job_trace_append(&w, &r) < 0)
+            break;
+    if (job_trace_finish(&w) < 0)
+        return -1;
+    printf("%s: wrote %llu jobs\n", path, (unsigned long long)w.count);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-w workload] [-s seed] [-S shard] -o out.bin\n"
+            "       %s [-w workload] [-s seed] -B threads\n",
+            prog, prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *out = NULL;
+    uint64_t shard = 0;
+    int threads = 0;
+    int opt;
+
+    workload_defaults(&params);
+
+    while ((opt = getopt(argc, argv, "w:s:S:o:B:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'w':
+            if (workload_parse(optarg, &params) < 0)
+                usage(argv[0]);
+            break;
+        case 's': seed = strtoull(optarg, NULL, 10); break;
+        case 'S': shard = strtoull(optarg, NULL, 10); break;
+        case 'o': out = optarg; break;
+        case 'B': threads = atoi(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || (out == NULL) == (threads <= 0))
+        usage(argv[0]);
+
+    int rc = out ? write_trace(out, shard) : bench(threads);
+    exit(rc < 0 ? 1 : 0);
+}
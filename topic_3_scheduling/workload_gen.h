@@ -0,0 +1,432 @@
+/*
+ * workload_gen.h - Seeded synthetic workloads for the simulator
+ *
+ * The demos use one hand-written set of five jobs. To compare policies
+ * fairly we want MANY workloads with a chosen statistical shape, and we
+ * want each one to be reproducible: the same seed must always produce
+ * exactly the same jobs.
+ *
+ * ARRIVALS:
+ *   poisson - gaps between arrivals are exponential with mean 'gap'
+ *             (the classic textbook model: arrivals are independent)
+ *   bursty  - the source flips between an ON phase, where jobs arrive
+ *             'burstiness' times faster, and an OFF phase, where they
+ *             trickle in. Each phase lasts on average 'phase' jobs. The
+ *             long-run average gap is still 'gap'.
+ *
+ * BURSTS (CPU time per job):
+ *   exp     - exponential with mean 'mean'
+ *   pareto  - heavy-tailed with shape 'alpha' (> 1) and mean 'mean':
+ *             most jobs are short, a few are ENORMOUS
+ *   bimodal - every job is either 'mean' or 'long' units; a fraction
+ *             'plong' of them are long
+ *   convoy  - the fifo-convoy-effect.html mix: exponential short jobs
+ *             with mean 'mean', plus a fraction 'plong' of heavyweights
+ *             of exactly 'long' units that hold up everyone behind them
+ *
+ * The load on one CPU is (average burst) / gap; above 1.0 the ready queue
+ * grows without bound.
+ *
+ * COUNTER-BASED RANDOM NUMBERS (Philox4x32-10):
+ * An ordinary generator carries state from one number to the next, so the
+ * 1000th job can only be produced after the first 999. Philox instead is a
+ * pure function:
+ *
+ *     random bits = Philox(key = seed, counter = (job number, shard))
+ *
+ * Job i of shard k always gets the same four 32-bit random numbers, on any
+ * thread, in any order. Each shard is an independent stream, so parallel
+ * workers can each simulate their own shard with no coordination and the
+ * whole run is still reproducible from one seed.
+ *
+ * SPEED:
+ * Jobs are produced in batches into a small buffer, using cheap polynomial
+ * approximations of log() and exp2() (accurate to ~1e-7, far below the
+ * rounding of a burst to whole time units). A 'struct workload_gen' plugs
+ * straight into the simulator as a 'struct job_source', so no trace file
+ * is ever written. Run "workload_gen -B" to measure the rate.
+ */
+
+#ifndef WORKLOAD_GEN_H
+#define WORKLOAD_GEN_H
+
+#include <stdint.h>
+#include <stdlib.h> /* strtod(), strtoull() */
+#include <string.h> /* strncmp(), strlen() */
+
+#include "job_trace.h" /* struct job_record */
+
+enum workload_arrival
+{
+    ARRIVAL_POISSON,
+    ARRIVAL_BURSTY,
+};
+
+enum workload_burst
+{
+    BURST_EXP,
+    BURST_PARETO,
+    BURST_BIMODAL,
+    BURST_CONVOY,
+};
+
+struct workload_params
+{
+    uint64_t njobs;           /* How many jobs to produce */
+    double mean_interarrival; /* Average gap between arrivals */
+    double mean_burst;        /* Average burst (of the short jobs, for bimodal/convoy) */
+
+    enum workload_arrival arrival;
+    double burstiness; /* bursty: ON-phase arrival rate multiplier (> 1) */
+    double phase_jobs; /* bursty: average number of jobs per ON or OFF phase */
+
+    enum workload_burst burst;
+    double alpha;      /* pareto: tail shape; smaller = heavier tail */
+    double long_burst; /* bimodal/convoy: size of the long jobs */
+    double p_long;     /* bimodal/convoy: fraction of long jobs */
+};
+
+/* Fill in sensible defaults; fields not set stay as below */
+static inline void workload_defaults(struct workload_params *p)
+{
+    *p = (struct workload_params){
+        .njobs = 100000,
+        .mean_interarrival = 12.0,
+        .mean_burst = 10.0,
+        .arrival = ARRIVAL_POISSON,
+        .burstiness = 4.0,
+        .phase_jobs = 1000.0,
+        .burst = BURST_EXP,
+        .alpha = 1.5,
+        .long_burst = 200.0,
+        .p_long = 0.02,
+    };
+}
+
+/* Expected CPU time per job - what the load calculation needs */
+static inline double workload_mean_burst(const struct workload_params *p)
+{
+    if (p->burst == BURST_BIMODAL || p->burst == BURST_CONVOY)
+        return (1.0 - p->p_long) * p->mean_burst + p->p_long * p->long_burst;
+    return p->mean_burst;
+}
+
+/* ======================================================================
+ * Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as
+ * 1, 2, 3", SC 2011). Ten rounds of multiply-and-xor scramble a 128-bit
+ * counter under a 64-bit key.
+ *
+ * We always compute WORKLOAD_LANES consecutive counters at once. The lanes
+ * do not depend on each other, so the compiler turns the inner loops into
+ * SIMD instructions that scramble several jobs' counters side by side.
+ * ====================================================================== */
+
+#define WORKLOAD_LANES 16
+
+static inline void philox4x32_10_lanes(uint64_t first, uint64_t shard, const uint32_t key[2],
+                                       uint32_t r0[WORKLOAD_LANES], uint32_t r1[WORKLOAD_LANES],
+                                       uint32_t r2[WORKLOAD_LANES], uint32_t r3[WORKLOAD_LANES])
+{
+    /* Counter for lane l: (job number first + l, shard) */
+    for (int l = 0; l < WORKLOAD_LANES; l++)
+    {
+        r0[l] = (uint32_t)(first + (uint64_t)l);
+        r1[l] = (uint32_t)((first + (uint64_t)l) >> 32);
+        r2[l] = (uint32_t)shard;
+        r3[l] = (uint32_t)(shard >> 32);
+    }
+
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++)
+    {
+        for (int l = 0; l < WORKLOAD_LANES; l++)
+        {
+            uint64_t p0 = (uint64_t)0xD2511F53u * r0[l];
+            uint64_t p1 = (uint64_t)0xCD9E8D57u * r2[l];
+            uint32_t n0 = (uint32_t)(p1 >> 32) ^ r1[l] ^ k0;
+            uint32_t n2 = (uint32_t)(p0 >> 32) ^ r3[l] ^ k1;
+            r1[l] = (uint32_t)p1;
+            r3[l] = (uint32_t)p0;
+            r0[l] = n0;
+            r2[l] = n2;
+        }
+        k0 += 0x9E3779B9u; /* Golden ratio */
+        k1 += 0xBB67AE85u; /* sqrt(3) - 1 */
+    }
+}
+
+/* Uniform double in (0, 1] from 32 random bits - never 0, so log() is finite */
+static inline double workload_u01(uint32_t bits)
+{
+    return ((double)bits + 1.0) * 0x1.0p-32;
+}
+
+/*
+ * Natural log of x in (0, 1]. Split x = m * 2^e with m in [sqrt(1/2), sqrt(2)),
+ * then ln(m) = 2*atanh(s) with s = (m-1)/(m+1), |s| < 0.172, summed to s^9.
+ */
+static inline double workload_log(double x)
+{
+    union { double d; uint64_t u; } v = {x};
+    int64_t e = (int64_t)((v.u >> 52) & 0x7ff) - 1023;
+    v.u = (v.u & 0x000fffffffffffffull) | 0x3ff0000000000000ull; /* m in [1, 2) */
+
+    /* Written without an 'if' so that loops over many values vectorize */
+    int64_t big = v.d > 1.4142135623730951;
+    double m = big ? v.d * 0.5 : v.d;
+    e += big;
+
+    double s = (m - 1.0) / (m + 1.0), s2 = s * s;
+    double ln_m = 2.0 * s * (1.0 + s2 * (1.0 / 3 + s2 * (1.0 / 5 + s2 * (1.0 / 7 + s2 * (1.0 / 9)))));
+    return (double)e * 0.6931471805599453 + ln_m;
+}
+
+/* 2^x for moderate x: integer part goes into the exponent, the rest is a polynomial */
+static inline double workload_exp2(double x)
+{
+    if (x > 1000.0)
+        x = 1000.0;
+    int64_t k = (int64_t)(x + 0.5);
+    if ((double)k > x + 0.5)
+        k--; /* Round to nearest, also for negative x */
+    double f = (x - (double)k) * 0.6931471805599453; /* e^f with |f| <= ln(2)/2 */
+    double p = 1.0 + f * (1.0 + f * (1.0 / 2 + f * (1.0 / 6 + f * (1.0 / 24 + f * (1.0 / 120 + f * (1.0 / 720))))));
+    union { double d; uint64_t u; } v = {p};
+    v.u += (uint64_t)k << 52;
+    return v.d;
+}
+
+/* ======================================================================
+ * THE GENERATOR
+ * ====================================================================== */
+
+#define WORKLOAD_BATCH 256
+
+struct workload_gen
+{
+    struct workload_params p;
+    uint32_t key[2];   /* Philox key, from the seed */
+    uint64_t shard;    /* Which independent stream this is */
+    uint64_t produced; /* Jobs generated so far (the Philox counter) */
+    double clock;      /* Arrival time of the last job, kept as a real number */
+    int phase_on;      /* bursty: currently in the ON phase? */
+
+    /* Precomputed per-job constants */
+    double gap_on, gap_off; /* Mean gaps in each bursty phase */
+    double pareto_xm;       /* Smallest Pareto burst */
+    double p_switch;        /* Chance of a phase change after each job */
+
+    /* Batch buffer used by workload_next() */
+    struct job_record buf[WORKLOAD_BATCH];
+    unsigned buf_pos, buf_len;
+};
+
+static inline void workload_init(struct workload_gen *g, const struct workload_params *p,
+                                 uint64_t seed, uint64_t shard)
+{
+    g->p = *p;
+    g->key[0] = (uint32_t)seed;
+    g->key[1] = (uint32_t)(seed >> 32);
+    g->shard = shard;
+    g->produced = 0;
+    g->clock = 0.0;
+    g->phase_on = 1;
+    g->buf_pos = g->buf_len = 0;
+
+    double b = p->burstiness > 1.0 ? p->burstiness : 1.0;
+    if (p->arrival == ARRIVAL_BURSTY)
+    {
+        /* ON gaps are b times shorter; OFF gaps make up the difference */
+        g->gap_on = p->mean_interarrival / b;
+        g->gap_off = p->mean_interarrival * (2.0 - 1.0 / b);
+    }
+    else
+    {
+        g->gap_on = g->gap_off = p->mean_interarrival;
+    }
+    g->p_switch = p->phase_jobs > 1.0 ? 1.0 / p->phase_jobs : 1.0;
+
+    /* A Pareto(xm, alpha) variable has mean xm * alpha / (alpha - 1) */
+    double alpha = p->alpha > 1.0 ? p->alpha : 1.0001;
+    g->pareto_xm = p->mean_burst * (alpha - 1.0) / alpha;
+}
+
+/*
+ * Generate up to n jobs into out[]. Returns how many were produced.
+ *
+ * Work happens a block of WORKLOAD_LANES jobs at a time, in three passes:
+ * random bits for the whole block, then gaps and bursts for the whole
+ * block (both independent per job, so they vectorize), and finally a
+ * short sequential pass that adds up arrival times and tracks the
+ * bursty ON/OFF phase, which do depend on the previous job.
+ */
+static inline size_t workload_fill(struct workload_gen *g, struct job_record *out, size_t n)
+{
+    const struct workload_params *p = &g->p;
+    double neg_inv_alpha_log2e = (p->alpha > 1.0 ? -1.0 / p->alpha : -1.0 / 1.0001) *
+                                 1.4426950408889634; /* log2(e) */
+    uint32_t p_long = (uint32_t)(p->p_long * 4294967295.0);
+    uint32_t p_switch = (uint32_t)(g->p_switch * 4294967295.0);
+
+    if (n > p->njobs - g->produced)
+        n = (size_t)(p->njobs - g->produced);
+
+    for (size_t done = 0; done < n; done += WORKLOAD_LANES)
+    {
+        uint32_t r0[WORKLOAD_LANES], r1[WORKLOAD_LANES], r2[WORKLOAD_LANES], r3[WORKLOAD_LANES];
+        double gap[WORKLOAD_LANES], burst[WORKLOAD_LANES];
+        uint64_t first = g->produced + done;
+        size_t m = n - done < WORKLOAD_LANES ? n - done : WORKLOAD_LANES;
+
+        /* Pass 1: r0 drives the gap, r1/r2 the burst, r3 the phase switch */
+        philox4x32_10_lanes(first, g->shard, g->key, r0, r1, r2, r3);
+
+        /* Pass 2: unit-mean exponential gaps, and bursts */
+        for (int l = 0; l < WORKLOAD_LANES; l++)
+            gap[l] = -workload_log(workload_u01(r0[l]));
+
+        switch (p->burst)
+        {
+        case BURST_PARETO:
+            for (int l = 0; l < WORKLOAD_LANES; l++)
+                burst[l] = g->pareto_xm *
+                           workload_exp2(neg_inv_alpha_log2e * workload_log(workload_u01(r1[l])));
+            break;
+        case BURST_BIMODAL:
+            for (int l = 0; l < WORKLOAD_LANES; l++)
+                burst[l] = r2[l] < p_long ? p->long_burst : p->mean_burst;
+            break;
+        case BURST_CONVOY:
+            for (int l = 0; l < WORKLOAD_LANES; l++)
+            {
+                double shorty = -p->mean_burst * workload_log(workload_u01(r1[l]));
+                burst[l] = r2[l] < p_long ? p->long_burst : shorty;
+            }
+            break;
+        default:
+            for (int l = 0; l < WORKLOAD_LANES; l++)
+                burst[l] = -p->mean_burst * workload_log(workload_u01(r1[l]));
+            break;
+        }
+
+        /* Pass 3: arrival times depend on every earlier gap */
+        for (size_t l = 0; l < m; l++)
+        {
+            uint64_t job = first + l;
+            struct job_record *r = &out[done + l];
+
+            /* The very first job arrives at t = 0 */
+            if (job > 0)
+                g->clock += (g->phase_on ? g->gap_on : g->gap_off) * gap[l];
+
+            /* Maybe flip between ON and OFF after this job */
+            if (p->arrival == ARRIVAL_BURSTY && r3[l] < p_switch)
+                g->phase_on = !g->phase_on;
+
+            double b = burst[l] < 1e15 ? burst[l] : 1e15; /* A Pareto tail can reach absurd values */
+            r->arrival = (uint64_t)g->clock;
+            r->burst = b >= 1.5 ? (uint64_t)(b + 0.5) : 1;
+            r->id = (uint32_t)job;
+            r->priority = 0;
+            r->io_every = 0;
+            r->io_time = 0;
+        }
+    }
+    g->produced += n;
+    return n;
+}
+
+/* job_source callback: hand out one job at a time from the batch buffer */
+static inline int workload_next(void *ctx, struct job_record *out)
+{
+    struct workload_gen *g = ctx;
+
+    if (g->buf_pos == g->buf_len)
+    {
+        g->buf_len = (unsigned)workload_fill(g, g->buf, WORKLOAD_BATCH);
+        g->buf_pos = 0;
+        if (g->buf_len == 0)
+            return 0;
+    }
+    *out = g->buf[g->buf_pos++];
+    return 1;
+}
+
+/*
+ * Parse a workload description such as
+ *
+ *     n=1000000,arrival=bursty,burst=pareto,alpha=1.2,mean=10,gap=12
+ *
+ * into *p (which should already hold defaults). Keys: n, gap, mean,
+ * arrival, burstiness, phase, burst, alpha, long, plong.
+ * Returns 0 on success, -1 on an unknown key or value (numbers must not
+ * be negative, and plong must lie in [0, 1]).
+ */
+static inline int workload_parse(const char *spec, struct workload_params *p)
+{
+    static const char *const arrivals[] = {"poisson", "bursty"};
+    static const char *const bursts[] = {"exp", "pareto", "bimodal", "convoy"};
+
+    while (*spec)
+    {
+        const char *eq = strchr(spec, '=');
+        if (eq == NULL)
+            return -1;
+        size_t klen = (size_t)(eq - spec);
+        const char *val = eq + 1;
+        size_t vlen = strcspn(val, ",");
+        char *end;
+
+#define KEY(name) (klen == strlen(name) && strncmp(spec, name, klen) == 0)
+        if (KEY("arrival") || KEY("burst"))
+        {
+            const char *const *names = KEY("arrival") ? arrivals : bursts;
+            int count = KEY("arrival") ? 2 : 4, found = -1;
+            for (int i = 0; i < count; i++)
+                if (vlen == strlen(names[i]) && strncmp(val, names[i], vlen) == 0)
+                    found = i;
+            if (found < 0)
+                return -1;
+            if (KEY("arrival"))
+                p->arrival = (enum workload_arrival)found;
+            else
+                p->burst = (enum workload_burst)found;
+        }
+        else
+        {
+            double d = strtod(val, &end);
+            /* !(d >= 0) also turns away "nan" */
+            if (end != val + vlen || !(d >= 0))
+                return -1;
+            if (KEY("n"))
+                p->njobs = (uint64_t)d;
+            else if (KEY("gap"))
+                p->mean_interarrival = d;
+            else if (KEY("mean"))
+                p->mean_burst = d;
+            else if (KEY("burstiness"))
+                p->burstiness = d;
+            else if (KEY("phase"))
+                p->phase_jobs = d;
+            else if (KEY("alpha"))
+                p->alpha = d;
+            else if (KEY("long"))
+                p->long_burst = d;
+            else if (KEY("plong"))
+            {
+                if (d > 1) /* A fraction: it is scaled to 32 bits below */
+                    return -1;
+                p->p_long = d;
+            }
+            else
+                return -1;
+        }
+#undef KEY
+        spec = val + vlen;
+        if (*spec == ',')
+            spec++;
+    }
+    return 0;
+}
+
+#endif /* WORKLOAD_GEN_H */